@@ -1,9 +1,48 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <array>
+#include <list>
 #include <stack>
 #include <queue>
 #include <map>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <memory_resource>
+#include <functional>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <shared_mutex>
+#include <atomic>
+#include <algorithm>
+#include <sstream>
+#include <string_view>
+#include <iterator>
+#include <ctime>
+#include <cmath>
+#include <charconv>
+#include <cassert>
+#include <exception>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
 using namespace std;
 
 // ========== ENUMERATIONS ========== //
@@ -45,615 +84,11585 @@ enum AppointmentStatus
     CANCELLED
 };
 
-// ========== PATIENT CLASS ========== //
-// [Malak Soliman] Patient class definition and implementation
-class Patient
+// ========== ENUM METADATA ========== //
+// [Kareem] Compile-time facts about an enumeration, specialized once per enum:
+// its number of values, the enumerator names used by batch files, the labels
+// shown to staff and the menu heading. Lookups are plain array reads, so
+// nothing here allocates.
+template <typename Enum>
+struct EnumTraits;
+
+template <>
+struct EnumTraits<Department>
 {
-private:
-    int id;
-    string name;
-    int age;
-    string contact;
-    stack<string> medicalHistory;
-    queue<string> testQueue;
-    bool isAdmitted;
-    RoomType roomType;
+    static constexpr size_t count = GENERAL + 1;
+    static constexpr string_view title = "Department";
+    static constexpr string_view names[count] = {"CARDIOLOGY", "NEUROLOGY", "ORTHOPEDICS",
+                                                 "PEDIATRICS", "EMERGENCY", "GENERAL"};
+    static constexpr string_view labels[count] = {"Cardiology", "Neurology", "Orthopedics",
+                                                  "Pediatrics", "Emergency", "General"};
+    // Taken when a menu choice is out of range
+    static constexpr Department fallback = GENERAL;
+};
 
-public:
-    Patient(int pid, string n, int a, string c);
+template <>
+struct EnumTraits<RoomType>
+{
+    static constexpr size_t count = SEMI_PRIVATE + 1;
+    static constexpr string_view title = "Room Type";
+    static constexpr string_view names[count] = {"GENERAL_WARD", "ICU", "PRIVATE_ROOM", "SEMI_PRIVATE"};
+    static constexpr string_view labels[count] = {"General Ward", "ICU", "Private Room", "Semi-Private"};
+    static constexpr RoomType fallback = GENERAL_WARD;
+};
 
-    void admitPatient(RoomType type);
-    void dischargePatient();
-    void addMedicalRecord(string record);
-    void requestTest(string testName);
-    string performTest();
-    void displayHistory();
+template <>
+struct EnumTraits<EmergencyPriority>
+{
+    static constexpr size_t count = STABLE + 1;
+    static constexpr string_view title = "Emergency Priority";
+    static constexpr string_view names[count] = {"CRITICAL", "URGENT", "STABLE"};
+    static constexpr string_view labels[count] = {"Critical", "Urgent", "Stable"};
+    static constexpr EmergencyPriority fallback = STABLE;
+    // Triage order: patients with a higher weight are treated first
+    static constexpr int weight[count] = {3, 2, 1};
+};
 
-    int getId() const;
-    string getName() const;
-    bool getAdmissionStatus() const;
-    string getRoomType() const;
+template <>
+struct EnumTraits<AppointmentStatus>
+{
+    static constexpr size_t count = CANCELLED + 1;
+    static constexpr string_view title = "Appointment Status";
+    static constexpr string_view names[count] = {"SCHEDULED", "IN_PROGRESS", "COMPLETED", "CANCELLED"};
+    static constexpr string_view labels[count] = {"Scheduled", "In Progress", "Completed", "Cancelled"};
+    static constexpr AppointmentStatus fallback = SCHEDULED;
 };
 
-// [Malak Soliman] Patient constructor implementation
-Patient::Patient(int pid, string n, int a, string c)
+// Fixed-size table with one element per value of Enum
+template <typename Enum, typename T>
+using EnumArray = array<T, EnumTraits<Enum>::count>;
+
+// Number of values of each indexed enum
+constexpr size_t DEPARTMENT_COUNT = EnumTraits<Department>::count;
+constexpr size_t ROOM_TYPE_COUNT = EnumTraits<RoomType>::count;
+constexpr size_t APPOINTMENT_STATUS_COUNT = EnumTraits<AppointmentStatus>::count;
+
+// [Kareem] Whether a raw number, e.g. read from a snapshot, is a value of Enum
+template <typename Enum>
+constexpr bool isEnumValue(long long value)
 {
-    id = pid;
-    name = n;
-    age = a;
-    contact = c;
-    isAdmitted = false;
+    return value >= 0 && value < (long long)EnumTraits<Enum>::count;
 }
 
-// [Malak Soliman] Admit patient to hospital
-void Patient::admitPatient(RoomType type)
+// [Kareem] Label shown to staff for a value
+template <typename Enum>
+constexpr string_view enumLabel(Enum value)
 {
-    isAdmitted = true;
-    roomType = type;
-    addMedicalRecord("Patient admitted to " + getRoomType() + " room type.");
+    return isEnumValue<Enum>(value) ? EnumTraits<Enum>::labels[value] : "Unknown";
 }
 
-// [Malak Soliman] Discharge patient from hospital
-void Patient::dischargePatient()
+// [Kareem] Enumerator name of a value, as written in batch files
+template <typename Enum>
+constexpr string_view enumName(Enum value)
 {
-    isAdmitted = false;
-    addMedicalRecord("Patient discharged.");
+    return isEnumValue<Enum>(value) ? EnumTraits<Enum>::names[value] : "UNKNOWN";
 }
 
-// [Malak Soliman] Add medical record to patient history
-void Patient::addMedicalRecord(string record)
+// [Kareem] Value given by its enumerator name or its number
+template <typename Enum>
+bool parseEnum(string_view text, Enum &value)
+{
+    for (size_t i = 0; i < EnumTraits<Enum>::count; i++)
+    {
+        if (text == EnumTraits<Enum>::names[i])
+        {
+            value = (Enum)i;
+            return true;
+        }
+    }
+    unsigned number;
+    from_chars_result result = from_chars(text.data(), text.data() + text.size(), number);
+    if (text.empty() || result.ec != errc() || result.ptr != text.data() + text.size() || !isEnumValue<Enum>(number))
+    {
+        return false;
+    }
+    value = (Enum)number;
+    return true;
+}
+
+static_assert(enumName(ICU) == "ICU" && enumLabel(SEMI_PRIVATE) == "Semi-Private", "room type tables out of order");
+static_assert(enumName(GENERAL) == "GENERAL" && enumLabel(CARDIOLOGY) == "Cardiology",
+              "department tables out of order");
+
+// ========== BINARY ENCODING ========== //
+// [Mazen Mohamed] Little helpers shared by the snapshot and the write-ahead log.
+// Values are written in native byte order; strings are <u32 length><bytes>.
+struct BinaryReader
+{
+    const char *cursor;
+    const char *end;
+    bool ok;
+
+    bool has(size_t count);
+    uint8_t u8();
+    uint32_t u32();
+    int32_t i32();
+    uint64_t u64();
+    string str();
+    string_view view();
+    const char *skip(size_t count);
+};
+
+// [Mazen Mohamed] Check that count more bytes are available
+bool BinaryReader::has(size_t count)
 {
-    medicalHistory.push(record);
+    if (!ok || (size_t)(end - cursor) < count)
+    {
+        ok = false;
+        return false;
+    }
+    return true;
 }
 
-// [Malak Soliman] Request a medical test
-void Patient::requestTest(string testName)
+// [Mazen Mohamed] Read one byte
+uint8_t BinaryReader::u8()
 {
-    testQueue.push(testName);
-    addMedicalRecord("Test requested: " + testName);
+    if (!has(1))
+    {
+        return 0;
+    }
+    return (uint8_t)*cursor++;
 }
 
-// [Malak Soliman] Perform the next test in queue
-string Patient::performTest()
+// [Mazen Mohamed] Read an unsigned 32-bit value
+uint32_t BinaryReader::u32()
 {
-    if (testQueue.empty())
+    uint32_t value = 0;
+    if (has(sizeof(value)))
     {
-        return "No tests pending";
+        memcpy(&value, cursor, sizeof(value));
+        cursor += sizeof(value);
     }
-    string testName = testQueue.front();
-    testQueue.pop();
-    addMedicalRecord("Test performed: " + testName);
-    return testName;
+    return value;
 }
 
-// [Malak Soliman] Display patient medical history
-void Patient::displayHistory()
+// [Mazen Mohamed] Read a signed 32-bit value
+int32_t BinaryReader::i32()
 {
-    cout << "Medical History for " << name << ":" << endl;
-    stack<string> tempStack;
+    return (int32_t)u32();
+}
 
-    // Reverse the stack to show recent first
-    while (!medicalHistory.empty())
+// [Mazen Mohamed] Read an unsigned 64-bit value
+uint64_t BinaryReader::u64()
+{
+    uint64_t value = 0;
+    if (has(sizeof(value)))
     {
-        tempStack.push(medicalHistory.top());
-        medicalHistory.pop();
+        memcpy(&value, cursor, sizeof(value));
+        cursor += sizeof(value);
     }
+    return value;
+}
+
+// [Mazen Mohamed] Read a length-prefixed string
+string BinaryReader::str()
+{
+    return string(view());
+}
+
+// [Mazen Mohamed] Read a length-prefixed string without copying it; the
+// view points into the buffer being read
+string_view BinaryReader::view()
+{
+    uint32_t length = u32();
+    const char *start = skip(length);
+    return start == nullptr ? string_view() : string_view(start, length);
+}
 
-    while (!tempStack.empty())
+// [Mazen Mohamed] Step over count bytes, returning where they start
+const char *BinaryReader::skip(size_t count)
+{
+    if (!has(count))
     {
-        cout << "- " << tempStack.top() << endl;
-        medicalHistory.push(tempStack.top());
-        tempStack.pop();
+        return nullptr;
     }
+    const char *start = cursor;
+    cursor += count;
+    return start;
 }
 
-// [Malak Soliman] Get patient ID
-int Patient::getId() const
+// [Mazen Mohamed] Append one byte
+void putU8(string &out, uint8_t value)
 {
-    return id;
+    out.push_back((char)value);
 }
 
-// [Malak Soliman] Get patient name
-string Patient::getName() const
+// [Mazen Mohamed] Append an unsigned 32-bit value
+void putU32(string &out, uint32_t value)
 {
-    return name;
+    out.append((const char *)&value, sizeof(value));
 }
 
-// [Malak Soliman] Get admission status
-bool Patient::getAdmissionStatus() const
+// [Mazen Mohamed] Append a signed 32-bit value
+void putI32(string &out, int32_t value)
 {
-    return isAdmitted;
+    putU32(out, (uint32_t)value);
 }
 
-// [Malak Soliman] Get room type as string
-string Patient::getRoomType() const
+// [Mazen Mohamed] Append an unsigned 64-bit value
+void putU64(string &out, uint64_t value)
+{
+    out.append((const char *)&value, sizeof(value));
+}
+
+// [Mazen Mohamed] Append a length-prefixed string
+void putString(string &out, string_view value)
+{
+    putU32(out, (uint32_t)value.size());
+    out.append(value.data(), value.size());
+}
+
+// ========== MEMORY ARENA ========== //
+// [Mazen Mohamed] Heap allocations made so far by the calling thread, for the
+// benchmark's allocations per operation. Only builds with
+// -DHMS_COUNT_ALLOCATIONS replace the global operator new to count them here;
+// other builds keep the standard allocator and report no count. Per thread,
+// so counting never contends between the threads of the stress test.
+#ifdef HMS_COUNT_ALLOCATIONS
+static const bool HEAP_ALLOCATIONS_COUNTED = true;
+#else
+static const bool HEAP_ALLOCATIONS_COUNTED = false;
+#endif
+static thread_local unsigned long long heapAllocationCount = 0;
+
+unsigned long long heapAllocations()
+{
+    return heapAllocationCount;
+}
+
+#ifdef HMS_COUNT_ALLOCATIONS
+// [Mazen Mohamed] Counting replacements of the global allocation functions.
+// GCC inlines them into new-expressions and then mistakes free() for a
+// mismatched deallocation, so those warnings are off for this block only.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#pragma GCC diagnostic ignored "-Warray-bounds"
+#endif
+void *operator new(size_t size)
 {
-    switch (roomType)
+    heapAllocationCount++;
+    void *memory = malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
     {
-    case GENERAL_WARD:
-        return "General Ward";
-    case ICU:
-        return "ICU";
-    case PRIVATE_ROOM:
-        return "Private Room";
-    case SEMI_PRIVATE:
-        return "Semi-Private";
-    default:
-        return "Unknown";
+        throw bad_alloc();
     }
+    return memory;
 }
 
-// ========== DOCTOR CLASS ========== //
-// [Hanna] Doctor class definition and implementation
-class Doctor
+void *operator new[](size_t size)
 {
-private:
-    int id;
-    string name;
-    Department department;
-    queue<int> appointmentQueue;
+    return operator new(size);
+}
 
-public:
-    Doctor(int did, string n, Department d);
+void operator delete(void *memory) noexcept
+{
+    free(memory);
+}
 
-    void addAppointment(int patientId);
-    int seePatient();
+void operator delete[](void *memory) noexcept
+{
+    free(memory);
+}
 
-    int getId() const;
-    string getName() const;
-    string getDepartment() const;
-};
+void operator delete(void *memory, size_t) noexcept
+{
+    free(memory);
+}
 
-// [Hanna] Doctor constructor implementation
-Doctor::Doctor(int did, string n, Department d)
+void operator delete[](void *memory, size_t) noexcept
 {
-    id = did;
-    name = n;
-    department = d;
+    free(memory);
 }
 
-// [Hanna] Add appointment to doctor's queue
-void Doctor::addAppointment(int patientId)
+// Over-aligned types (e.g. the padded ring positions) keep the pointer
+// malloc returned just before the aligned block
+void *operator new(size_t size, align_val_t alignment)
 {
-    appointmentQueue.push(patientId);
+    heapAllocationCount++;
+    size_t align = max((size_t)alignment, sizeof(void *));
+    char *raw = (char *)malloc(size + align + sizeof(void *));
+    if (raw == nullptr)
+    {
+        throw bad_alloc();
+    }
+    uintptr_t start = (uintptr_t)(raw + sizeof(void *));
+    char *aligned = (char *)((start + align - 1) & ~(uintptr_t)(align - 1));
+    ((void **)aligned)[-1] = raw;
+    return aligned;
 }
 
-// [Hanna] See next patient in queue
-int Doctor::seePatient()
+void *operator new[](size_t size, align_val_t alignment)
 {
-    if (appointmentQueue.empty())
+    return operator new(size, alignment);
+}
+
+void operator delete(void *memory, align_val_t) noexcept
+{
+    if (memory != nullptr)
     {
-        return -1;
+        free(((void **)memory)[-1]);
     }
-    int patientId = appointmentQueue.front();
-    appointmentQueue.pop();
-    return patientId;
 }
 
-// [Hanna] Get doctor ID
-int Doctor::getId() const
+void operator delete[](void *memory, align_val_t alignment) noexcept
 {
-    return id;
+    operator delete(memory, alignment);
 }
 
-// [Hanna] Get doctor name
-string Doctor::getName() const
+void operator delete(void *memory, size_t, align_val_t alignment) noexcept
 {
-    return name;
+    operator delete(memory, alignment);
 }
 
-// [Hanna] Get department name as string
-string Doctor::getDepartment() const
+void operator delete[](void *memory, size_t, align_val_t alignment) noexcept
 {
-    switch (department)
-    {
-    case CARDIOLOGY:
-        return "Cardiology";
-    case NEUROLOGY:
-        return "Neurology";
-    case ORTHOPEDICS:
-        return "Orthopedics";
-    case PEDIATRICS:
-        return "Pediatrics";
-    case EMERGENCY:
-        return "Emergency";
-    case GENERAL:
-        return "General";
-    default:
-        return "Unknown";
+    operator delete(memory, alignment);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+// [Mazen Mohamed] Destroys an object made by makeInArena and returns its memory
+struct ArenaDeleter
+{
+    pmr::memory_resource *resource;
+
+    template <typename T>
+    void operator()(T *object) const
+    {
+        object->~T();
+        resource->deallocate(object, sizeof(T), alignof(T));
+    }
+};
+
+template <typename T>
+using ArenaPtr = unique_ptr<T, ArenaDeleter>;
+
+// [Mazen Mohamed] Construct a T in memory taken from resource
+template <typename T, typename... Args>
+ArenaPtr<T> makeInArena(pmr::memory_resource *resource, Args &&...args)
+{
+    void *memory = resource->allocate(sizeof(T), alignof(T));
+    try
+    {
+        return ArenaPtr<T>(new (memory) T(forward<Args>(args)...), ArenaDeleter{resource});
+    }
+    catch (...)
+    {
+        resource->deallocate(memory, sizeof(T), alignof(T));
+        throw;
     }
 }
 
-// ========== APPOINTMENT CLASS (Kareem's Task) ========== //
-// [Kareem] Appointment class to track detailed appointment information
-class Appointment
+// ========== STRING INTERNING ========== //
+// [Malak Soliman] Hospital-wide table of distinct strings such as test names
+// Each distinct string is stored once and referred to by a 32-bit ID, so
+// history events only carry the ID. Strings are never removed, so views
+// handed out stay valid for the life of the program; only text that repeats
+// across patients belongs here, never free text such as notes.
+class StringInterner
 {
 private:
-    int appointmentId;
-    int doctorId;
-    int patientId;
-    string dateTime;
-    AppointmentStatus status;
+    mutable shared_mutex lock;
+    deque<string> strings;
+    unordered_map<string_view, uint32_t> ids;
 
 public:
-    Appointment(int aid, int did, int pid, string dt);
+    uint32_t intern(string_view text);
+    string_view lookup(uint32_t stringId) const;
+    size_t size() const;
 
-    void setStatus(AppointmentStatus newStatus);
-    int getAppointmentId() const;
-    int getDoctorId() const;
-    int getPatientId() const;
-    string getDateTime() const;
-    string getStatus() const;
+    static StringInterner &shared();
 };
 
-// [Kareem] Appointment constructor implementation
-Appointment::Appointment(int aid, int did, int pid, string dt)
+// [Malak Soliman] ID of text, adding it to the table the first time it is seen
+uint32_t StringInterner::intern(string_view text)
 {
-    appointmentId = aid;
-    doctorId = did;
-    patientId = pid;
-    dateTime = dt;
-    status = SCHEDULED;
+    {
+        shared_lock<shared_mutex> guard(lock);
+        auto it = ids.find(text);
+        if (it != ids.end())
+        {
+            return it->second;
+        }
+    }
+    unique_lock<shared_mutex> guard(lock);
+    auto it = ids.find(text);
+    if (it != ids.end())
+    {
+        return it->second;
+    }
+    strings.emplace_back(text);
+    uint32_t stringId = (uint32_t)strings.size() - 1;
+    ids.emplace(string_view(strings.back()), stringId);
+    return stringId;
 }
 
-// [Kareem] Set appointment status
-void Appointment::setStatus(AppointmentStatus newStatus)
+// [Malak Soliman] Text of an interned string
+string_view StringInterner::lookup(uint32_t stringId) const
 {
-    status = newStatus;
+    shared_lock<shared_mutex> guard(lock);
+    if (stringId >= strings.size())
+    {
+        return string_view();
+    }
+    return strings[stringId];
 }
 
-// [Kareem] Get appointment ID
-int Appointment::getAppointmentId() const
+// [Malak Soliman] Number of distinct strings
+size_t StringInterner::size() const
 {
-    return appointmentId;
+    shared_lock<shared_mutex> guard(lock);
+    return strings.size();
 }
 
-// [Kareem] Get doctor ID
-int Appointment::getDoctorId() const
+// [Malak Soliman] The table used for medical history text
+StringInterner &StringInterner::shared()
 {
-    return doctorId;
+    static StringInterner table;
+    return table;
 }
 
-// [Kareem] Get patient ID
-int Appointment::getPatientId() const
+// ========== MEDICAL TIMELINE ========== //
+// [Malak Soliman] Kinds of medical history event
+enum HistoryEventKind
 {
-    return patientId;
-}
+    EVENT_NOTE,               // free text, text holds where its timeline keeps the note
+    EVENT_ADMITTED,           // detail holds the RoomType
+    EVENT_DISCHARGED,
+    EVENT_TEST_REQUESTED,     // text holds the test name
+    EVENT_TEST_PERFORMED,     // text holds the test name
+    EVENT_APPOINTMENT_BOOKED  // value holds the doctor ID
+};
 
-// [Kareem] Get date and time
-string Appointment::getDateTime() const
+// [Malak Soliman] One compact medical history event (16 bytes)
+// Text is only rendered when the history is displayed.
+struct HistoryEvent
 {
-    return dateTime;
-}
+    uint32_t timestamp; // seconds since the Unix epoch, 0 if unknown
+    uint8_t kind;       // HistoryEventKind
+    uint8_t detail;     // small enum payload, e.g. RoomType
+    uint16_t reserved;
+    int32_t value;      // integer payload, e.g. doctor ID
+    uint32_t text;      // StringInterner ID, or the note offset of EVENT_NOTE
 
-// [Kareem] Get status as string
-string Appointment::getStatus() const
+    bool hasText() const;
+};
+
+// [Malak Soliman] Whether the event carries text (see MedicalTimeline::text)
+bool HistoryEvent::hasText() const
 {
-    switch (status)
-    {
-    case SCHEDULED:
-        return "Scheduled";
-    case IN_PROGRESS:
-        return "In Progress";
-    case COMPLETED:
-        return "Completed";
-    case CANCELLED:
-        return "Cancelled";
-    default:
-        return "Unknown";
-    }
+    return kind == EVENT_NOTE || kind == EVENT_TEST_REQUESTED || kind == EVENT_TEST_PERFORMED;
 }
 
-// ========== HOSPITAL CLASS ========== //
-// [Mazen Mohamed] Hospital class definition and implementation
-class Hospital
+// [Malak Soliman] Append-only, timestamped medical history of one patient
+// Events live in chunks that start small and double up to a limit, so a
+// short history stays small. Events are never moved or rewritten, so readers
+// walk them in place, front to back or back to front. Notes are free text
+// written once per patient, so the timeline keeps them itself, allocated
+// like its events and freed with them.
+class MedicalTimeline
 {
-protected:
-    vector<Patient> patients;
-    vector<Doctor> doctors;
-    queue<int> emergencyQueue;
-    int patientCounter;
-    int doctorCounter;
+private:
+    // Events of a chunk are allocated from the chunk vector's memory resource
+    struct Chunk
+    {
+        HistoryEvent *events;
+        uint32_t capacity;
+        uint32_t count;
+    };
+
+    static const uint32_t FIRST_CHUNK_EVENTS = 4;
+    static const uint32_t MAX_CHUNK_EVENTS = 256;
+
+    pmr::vector<Chunk> chunks;
+    size_t count;
+    // Note texts, each <u32 length><bytes> at the offset its event holds
+    pmr::string notes;
+
+    void releaseChunks();
 
 public:
-    Hospital();
+    class const_iterator
+    {
+    private:
+        const MedicalTimeline *timeline;
+        size_t chunk;
+        uint32_t index;
 
-    int registerPatient(string name, int age, string contact);
-    int addDoctor(string name, Department dept);
-    void admitPatient(int patientId, RoomType type);
-    void addEmergency(int patientId);
-    int handleEmergency();
-    void bookAppointment(int doctorId, int patientId);
-    void displayPatientInfo(int patientId);
-    void displayDoctorInfo(int doctorId);
-    void displayAllPatients();
-    void displayAllDoctors();
+        friend class MedicalTimeline;
+
+    public:
+        typedef bidirectional_iterator_tag iterator_category;
+        typedef HistoryEvent value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const HistoryEvent *pointer;
+        typedef const HistoryEvent &reference;
+
+        const_iterator();
+        const_iterator(const MedicalTimeline *owner, size_t chunkIndex, uint32_t eventIndex);
+
+        const HistoryEvent &operator*() const;
+        const HistoryEvent *operator->() const;
+        const_iterator &operator++();
+        const_iterator operator++(int);
+        const_iterator &operator--();
+        const_iterator operator--(int);
+        bool operator==(const const_iterator &other) const;
+        bool operator!=(const const_iterator &other) const;
+    };
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    explicit MedicalTimeline(pmr::memory_resource *resource = pmr::get_default_resource());
+    MedicalTimeline(const MedicalTimeline &other);
+    MedicalTimeline &operator=(const MedicalTimeline &other);
+    MedicalTimeline(MedicalTimeline &&other) noexcept;
+    MedicalTimeline &operator=(MedicalTimeline &&other) noexcept;
+    ~MedicalTimeline();
+
+    pmr::memory_resource *resource() const;
+
+    void append(const HistoryEvent &event);
+    void append(HistoryEvent event, string_view text);
+    string_view text(const HistoryEvent &event) const;
+    size_t size() const;
+    bool empty() const;
+    size_t memoryUsed() const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_reverse_iterator rbegin() const;
+    const_reverse_iterator rend() const;
+    const_iterator tail(size_t n) const;
+
+    static long long now();
+    static void setClockOverride(long long timestamp);
+    static string formatTime(long long timestamp);
+    static size_t formatTime(long long timestamp, char *buffer, size_t size);
 };
 
-// [Mazen Mohamed] Hospital constructor implementation
-Hospital::Hospital()
-{
-    patientCounter = 1;
-    doctorCounter = 1;
-}
+// Timestamp used instead of the wall clock while a log is being replayed
+static thread_local long long timelineClockOverride = 0;
 
-// [Mazen Mohamed] Register a new patient
-int Hospital::registerPatient(string name, int age, string contact)
+// [Malak Soliman] Empty timeline; no memory is allocated until the first event
+MedicalTimeline::MedicalTimeline(pmr::memory_resource *resource) : chunks(resource), notes(resource)
 {
-    Patient newPatient(patientCounter, name, age, contact);
-    patients.push_back(newPatient);
-    return patientCounter++;
+    count = 0;
 }
 
-// [Mazen Mohamed] Add a new doctor
-int Hospital::addDoctor(string name, Department dept)
+// [Malak Soliman] Deep copy, packed into as few chunks as the sizing allows.
+// Like the standard containers, a copy uses the default memory resource.
+MedicalTimeline::MedicalTimeline(const MedicalTimeline &other) : notes(other.notes)
 {
-    Doctor newDoctor(doctorCounter, name, dept);
-    doctors.push_back(newDoctor);
-    return doctorCounter++;
+    count = 0;
+    for (const HistoryEvent &event : other)
+    {
+        append(event);
+    }
 }
 
-// [Mazen Mohamed] Admit a patient
-void Hospital::admitPatient(int patientId, RoomType type)
+// [Malak Soliman] Deep copy assignment; keeps this timeline's memory resource
+MedicalTimeline &MedicalTimeline::operator=(const MedicalTimeline &other)
 {
-    for (auto &patient : patients)
+    if (this != &other)
     {
-        if (patient.getId() == patientId)
+        releaseChunks();
+        for (const HistoryEvent &event : other)
         {
-            patient.admitPatient(type);
-            return;
+            append(event);
         }
+        notes = other.notes;
     }
-    cout << "Patient with ID " << patientId << " not found." << endl;
+    return *this;
 }
 
-// [Mazen Mohamed] Add emergency case
-void Hospital::addEmergency(int patientId)
+// [Malak Soliman] Take over the chunks of other, leaving it empty
+MedicalTimeline::MedicalTimeline(MedicalTimeline &&other) noexcept
+    : chunks(move(other.chunks)), count(other.count), notes(move(other.notes))
 {
-    emergencyQueue.push(patientId);
+    other.chunks.clear();
+    other.count = 0;
+    other.notes.clear();
 }
 
-// [Mazen Mohamed] Handle emergency case
-int Hospital::handleEmergency()
+// [Malak Soliman] Move assignment; copies when the memory resources differ
+MedicalTimeline &MedicalTimeline::operator=(MedicalTimeline &&other) noexcept
 {
-    if (emergencyQueue.empty())
+    if (this == &other)
     {
-        cout << "No emergencies in queue." << endl;
-        return -1;
+        return *this;
     }
-    int nextEmergency = emergencyQueue.front();
-    emergencyQueue.pop();
-    return nextEmergency;
+    if (resource() != other.resource())
+    {
+        return *this = static_cast<const MedicalTimeline &>(other);
+    }
+    releaseChunks();
+    chunks.swap(other.chunks);
+    notes.swap(other.notes);
+    count = other.count;
+    other.count = 0;
+    return *this;
 }
 
-// [Mazen Mohamed] Book appointment
-void Hospital::bookAppointment(int doctorId, int patientId)
+// [Malak Soliman] Return every chunk to the memory resource
+MedicalTimeline::~MedicalTimeline()
+{
+    releaseChunks();
+}
+
+// [Malak Soliman] Free all events, leaving an empty timeline
+void MedicalTimeline::releaseChunks()
 {
-    for (auto &doctor : doctors)
+    for (const Chunk &chunk : chunks)
     {
-        if (doctor.getId() == doctorId)
-        {
-            doctor.addAppointment(patientId);
+        resource()->deallocate(chunk.events, chunk.capacity * sizeof(HistoryEvent), alignof(HistoryEvent));
+    }
+    chunks.clear();
+    count = 0;
+    notes.clear();
+}
 
-            // Log appointment in patient's medical history
-            for (auto &patient : patients)
-            {
-                if (patient.getId() == patientId)
-                {
-                    patient.addMedicalRecord("Appointment booked with Doctor ID: " + to_string(doctorId));
-                    return;
-                }
-            }
-            cout << "Patient with ID " << patientId << " not found." << endl;
-            return;
+// [Malak Soliman] Memory resource the events are allocated from
+pmr::memory_resource *MedicalTimeline::resource() const
+{
+    return chunks.get_allocator().resource();
+}
+
+// [Malak Soliman] Add an event at the end of the timeline
+void MedicalTimeline::append(const HistoryEvent &event)
+{
+    if (chunks.empty() || chunks.back().count == chunks.back().capacity)
+    {
+        uint32_t capacity = chunks.empty() ? FIRST_CHUNK_EVENTS : min(chunks.back().capacity * 2, MAX_CHUNK_EVENTS);
+        void *memory = resource()->allocate(capacity * sizeof(HistoryEvent), alignof(HistoryEvent));
+        chunks.push_back(Chunk{(HistoryEvent *)memory, capacity, 0});
+    }
+    Chunk &chunk = chunks.back();
+    chunk.events[chunk.count++] = event;
+    count++;
+}
+
+// [Malak Soliman] Add an event together with its text: a note is stored in
+// this timeline, other text is interned
+void MedicalTimeline::append(HistoryEvent event, string_view text)
+{
+    if (event.kind == EVENT_NOTE)
+    {
+        uint32_t length = (uint32_t)text.size();
+        event.text = (uint32_t)notes.size();
+        notes.append((const char *)&length, sizeof(length));
+        notes.append(text);
+    }
+    else
+    {
+        event.text = text.empty() ? 0 : StringInterner::shared().intern(text);
+    }
+    append(event);
+}
+
+// [Malak Soliman] Text of one of this timeline's events; empty if it has none
+string_view MedicalTimeline::text(const HistoryEvent &event) const
+{
+    if (event.kind != EVENT_NOTE)
+    {
+        return event.hasText() ? StringInterner::shared().lookup(event.text) : string_view();
+    }
+    uint32_t length;
+    if ((size_t)event.text + sizeof(length) > notes.size())
+    {
+        return string_view();
+    }
+    memcpy(&length, notes.data() + event.text, sizeof(length));
+    return string_view(notes.data() + event.text + sizeof(length), length);
+}
+
+// [Malak Soliman] Number of events
+size_t MedicalTimeline::size() const
+{
+    return count;
+}
+
+// [Malak Soliman] Check whether the timeline has no events
+bool MedicalTimeline::empty() const
+{
+    return count == 0;
+}
+
+// [Malak Soliman] Bytes allocated for this timeline's events
+size_t MedicalTimeline::memoryUsed() const
+{
+    size_t bytes = chunks.capacity() * sizeof(Chunk) + notes.capacity();
+    for (const Chunk &chunk : chunks)
+    {
+        bytes += chunk.capacity * sizeof(HistoryEvent);
+    }
+    return bytes;
+}
+
+// [Malak Soliman] Oldest event
+MedicalTimeline::const_iterator MedicalTimeline::begin() const
+{
+    return const_iterator(this, 0, 0);
+}
+
+// [Malak Soliman] One past the newest event
+MedicalTimeline::const_iterator MedicalTimeline::end() const
+{
+    return const_iterator(this, chunks.size(), 0);
+}
+
+// [Malak Soliman] Newest event, walking towards the oldest
+MedicalTimeline::const_reverse_iterator MedicalTimeline::rbegin() const
+{
+    return const_reverse_iterator(end());
+}
+
+// [Malak Soliman] One before the oldest event
+MedicalTimeline::const_reverse_iterator MedicalTimeline::rend() const
+{
+    return const_reverse_iterator(begin());
+}
+
+// [Malak Soliman] First of the last n events, so [tail(n), end()) is the newest n
+// Only the chunks holding those events are visited.
+MedicalTimeline::const_iterator MedicalTimeline::tail(size_t n) const
+{
+    if (n >= count)
+    {
+        return begin();
+    }
+    size_t chunk = chunks.size();
+    size_t remaining = n;
+    while (chunk > 0 && remaining > chunks[chunk - 1].count)
+    {
+        remaining -= chunks[chunk - 1].count;
+        chunk--;
+    }
+    if (remaining == 0)
+    {
+        return end();
+    }
+    chunk--;
+    return const_iterator(this, chunk, chunks[chunk].count - (uint32_t)remaining);
+}
+
+// [Malak Soliman] Current time for new events, in seconds since the Unix epoch
+long long MedicalTimeline::now()
+{
+    if (timelineClockOverride != 0)
+    {
+        return timelineClockOverride;
+    }
+    return (long long)chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// [Malak Soliman] Stamp new events on this thread with a fixed time; 0 restores the clock
+void MedicalTimeline::setClockOverride(long long timestamp)
+{
+    timelineClockOverride = timestamp;
+}
+
+// [Malak Soliman] Render a timestamp as local "YYYY-MM-DD HH:MM"
+string MedicalTimeline::formatTime(long long timestamp)
+{
+    char buffer[32];
+    return string(buffer, formatTime(timestamp, buffer, sizeof(buffer)));
+}
+
+// [Malak Soliman] Render a timestamp into buffer; returns the length written
+size_t MedicalTimeline::formatTime(long long timestamp, char *buffer, size_t size)
+{
+    time_t seconds = (time_t)timestamp;
+    tm local;
+#ifdef _WIN32
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    return strftime(buffer, size, "%Y-%m-%d %H:%M", &local);
+}
+
+// [Malak Soliman] Iterator constructors
+MedicalTimeline::const_iterator::const_iterator()
+{
+    timeline = nullptr;
+    chunk = 0;
+    index = 0;
+}
+
+MedicalTimeline::const_iterator::const_iterator(const MedicalTimeline *owner, size_t chunkIndex, uint32_t eventIndex)
+{
+    timeline = owner;
+    chunk = chunkIndex;
+    index = eventIndex;
+}
+
+// [Malak Soliman] The current event, in place
+const HistoryEvent &MedicalTimeline::const_iterator::operator*() const
+{
+    return timeline->chunks[chunk].events[index];
+}
+
+const HistoryEvent *MedicalTimeline::const_iterator::operator->() const
+{
+    return &timeline->chunks[chunk].events[index];
+}
+
+// [Malak Soliman] Step to the next newer event
+MedicalTimeline::const_iterator &MedicalTimeline::const_iterator::operator++()
+{
+    index++;
+    if (index == timeline->chunks[chunk].count)
+    {
+        chunk++;
+        index = 0;
+    }
+    return *this;
+}
+
+MedicalTimeline::const_iterator MedicalTimeline::const_iterator::operator++(int)
+{
+    const_iterator previous = *this;
+    ++*this;
+    return previous;
+}
+
+// [Malak Soliman] Step to the next older event
+MedicalTimeline::const_iterator &MedicalTimeline::const_iterator::operator--()
+{
+    if (index == 0)
+    {
+        chunk--;
+        index = timeline->chunks[chunk].count;
+    }
+    index--;
+    return *this;
+}
+
+MedicalTimeline::const_iterator MedicalTimeline::const_iterator::operator--(int)
+{
+    const_iterator previous = *this;
+    --*this;
+    return previous;
+}
+
+// [Malak Soliman] Iterator comparison
+bool MedicalTimeline::const_iterator::operator==(const const_iterator &other) const
+{
+    return chunk == other.chunk && index == other.index;
+}
+
+bool MedicalTimeline::const_iterator::operator!=(const const_iterator &other) const
+{
+    return !(*this == other);
+}
+
+// ========== LAB SCHEDULER ========== //
+// [Mazen Mohamed] A test handed to the lab
+struct LabOrder
+{
+    long long sequence; // Order of submission; results are collected in this order
+    int patientId;
+    uint32_t test;      // StringInterner ID of the test name
+    chrono::steady_clock::time_point queuedAt;
+};
+
+// [Mazen Mohamed] Queue depth and timing of one test type
+struct LabTestStats
+{
+    string test;
+    size_t waiting;
+    size_t running;
+    long long completed;
+    double averageWaitMs; // From submission until a lane picks the test up
+    double maxWaitMs;
+    double averageRunMs;
+};
+
+// [Mazen Mohamed] Hospital-wide lab with one FIFO queue per test type
+// Worker threads, one per lab lane, start with the first submitted test. A
+// free lane takes the test that has waited longest across all types, so no
+// type starves behind a busy one. The lab never touches patients: finished
+// tests wait until the owner collects them and writes them back itself.
+class LabScheduler
+{
+private:
+    struct TestType
+    {
+        deque<LabOrder> waiting;
+        chrono::microseconds runTime{0}; // How long one analysis occupies a lane
+        size_t running = 0;
+        long long completed = 0;
+        double totalWaitMs = 0;
+        double maxWaitMs = 0;
+        double totalRunMs = 0;
+    };
+
+    mutable mutex lock;
+    condition_variable orderReady; // Lanes wait here for work
+    condition_variable drained;    // waitIdle waits here for the last test
+    unordered_map<uint32_t, TestType> types;
+    vector<LabOrder> finished;
+    vector<thread> lanes;
+    int laneCount;
+    size_t waitingCount;
+    size_t outstanding; // Tests waiting or running
+    long long nextSequence;
+    bool stopping;
+
+    void runLane();
+    void stopLanes();
+
+public:
+    explicit LabScheduler(int laneCount = 2);
+    ~LabScheduler();
+    LabScheduler(const LabScheduler &) = delete;
+    LabScheduler &operator=(const LabScheduler &) = delete;
+
+    void setLanes(int count);
+    int getLanes() const;
+    void setRunTime(string_view test, chrono::microseconds runTime);
+    void submit(int patientId, string_view test);
+    size_t collect(vector<LabOrder> &results);
+    void waitIdle();
+    void reset();
+    size_t getOutstanding() const;
+    size_t getFinished() const;
+    vector<LabTestStats> stats() const;
+};
+
+// [Mazen Mohamed] Lab with the given number of lanes; no thread runs until
+// the first test arrives
+LabScheduler::LabScheduler(int laneCount) : laneCount(max(laneCount, 1))
+{
+    waitingCount = 0;
+    outstanding = 0;
+    nextSequence = 0;
+    stopping = false;
+}
+
+// [Mazen Mohamed] Let running tests finish and stop the lanes
+LabScheduler::~LabScheduler()
+{
+    stopLanes();
+}
+
+// [Mazen Mohamed] Body of one lab lane: take the longest-waiting test of any
+// type, run it outside the lock, and file the result
+void LabScheduler::runLane()
+{
+    unique_lock<mutex> guard(lock);
+    while (true)
+    {
+        orderReady.wait(guard, [this]()
+                        { return stopping || waitingCount > 0; });
+        if (stopping)
+        {
+            return;
+        }
+
+        TestType *oldest = nullptr;
+        for (auto &entry : types)
+        {
+            TestType &type = entry.second;
+            if (!type.waiting.empty() && (oldest == nullptr || type.waiting.front().sequence < oldest->waiting.front().sequence))
+            {
+                oldest = &type;
+            }
+        }
+        LabOrder order = oldest->waiting.front();
+        oldest->waiting.pop_front();
+        oldest->running++;
+        waitingCount--;
+        chrono::microseconds runTime = oldest->runTime;
+
+        guard.unlock();
+        auto started = chrono::steady_clock::now();
+        if (runTime.count() > 0)
+        {
+            this_thread::sleep_for(runTime);
+        }
+        auto done = chrono::steady_clock::now();
+        guard.lock();
+
+        // Elements of an unordered_map keep their address, so oldest is still valid
+        double waitMs = chrono::duration<double, milli>(started - order.queuedAt).count();
+        oldest->running--;
+        oldest->completed++;
+        oldest->totalWaitMs += waitMs;
+        oldest->maxWaitMs = max(oldest->maxWaitMs, waitMs);
+        oldest->totalRunMs += chrono::duration<double, milli>(done - started).count();
+        finished.push_back(order);
+        if (--outstanding == 0)
+        {
+            drained.notify_all();
+        }
+    }
+}
+
+// [Mazen Mohamed] Stop and join every lane; tests still waiting stay queued
+void LabScheduler::stopLanes()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    orderReady.notify_all();
+    for (thread &lane : lanes)
+    {
+        lane.join();
+    }
+    lanes.clear();
+    lock_guard<mutex> guard(lock);
+    stopping = false;
+}
+
+// [Mazen Mohamed] Change the number of lanes; queued tests carry over
+void LabScheduler::setLanes(int count)
+{
+    stopLanes();
+    lock_guard<mutex> guard(lock);
+    laneCount = max(count, 1);
+    if (waitingCount > 0)
+    {
+        for (int i = 0; i < laneCount; i++)
+        {
+            lanes.emplace_back(&LabScheduler::runLane, this);
+        }
+    }
+}
+
+// [Mazen Mohamed] Number of lab lanes
+int LabScheduler::getLanes() const
+{
+    lock_guard<mutex> guard(lock);
+    return laneCount;
+}
+
+// [Mazen Mohamed] Set how long one test of a type keeps a lane busy
+void LabScheduler::setRunTime(string_view test, chrono::microseconds runTime)
+{
+    uint32_t testId = StringInterner::shared().intern(test);
+    lock_guard<mutex> guard(lock);
+    types[testId].runTime = runTime;
+}
+
+// [Mazen Mohamed] Queue a test for a patient behind others of its type
+void LabScheduler::submit(int patientId, string_view test)
+{
+    uint32_t testId = StringInterner::shared().intern(test);
+    {
+        lock_guard<mutex> guard(lock);
+        if (lanes.empty())
+        {
+            for (int i = 0; i < laneCount; i++)
+            {
+                lanes.emplace_back(&LabScheduler::runLane, this);
+            }
+        }
+        types[testId].waiting.push_back({nextSequence++, patientId, testId, chrono::steady_clock::now()});
+        waitingCount++;
+        outstanding++;
+    }
+    orderReady.notify_one();
+}
+
+// [Mazen Mohamed] Move finished tests into results in submission order,
+// whichever lane ran them; returns how many there were
+size_t LabScheduler::collect(vector<LabOrder> &results)
+{
+    {
+        lock_guard<mutex> guard(lock);
+        results.swap(finished);
+        finished.clear();
+    }
+    sort(results.begin(), results.end(), [](const LabOrder &a, const LabOrder &b)
+         { return a.sequence < b.sequence; });
+    return results.size();
+}
+
+// [Mazen Mohamed] Block until every submitted test has run
+void LabScheduler::waitIdle()
+{
+    unique_lock<mutex> guard(lock);
+    drained.wait(guard, [this]()
+                 { return outstanding == 0; });
+}
+
+// [Mazen Mohamed] Drop queued and uncollected tests, e.g. when the patients
+// they belong to are replaced; running tests finish first. Run times and
+// statistics are kept.
+void LabScheduler::reset()
+{
+    stopLanes();
+    lock_guard<mutex> guard(lock);
+    for (auto &entry : types)
+    {
+        entry.second.waiting.clear();
+    }
+    finished.clear();
+    waitingCount = 0;
+    outstanding = 0;
+}
+
+// [Mazen Mohamed] Number of tests waiting for or occupying a lane
+size_t LabScheduler::getOutstanding() const
+{
+    lock_guard<mutex> guard(lock);
+    return outstanding;
+}
+
+// [Mazen Mohamed] Number of finished tests not collected yet
+size_t LabScheduler::getFinished() const
+{
+    lock_guard<mutex> guard(lock);
+    return finished.size();
+}
+
+// [Mazen Mohamed] Per-type queue depth and timing, by test name
+vector<LabTestStats> LabScheduler::stats() const
+{
+    vector<LabTestStats> result;
+    {
+        lock_guard<mutex> guard(lock);
+        for (const auto &entry : types)
+        {
+            const TestType &type = entry.second;
+            if (type.waiting.empty() && type.running == 0 && type.completed == 0)
+            {
+                continue;
+            }
+            double completed = (double)max(type.completed, 1LL);
+            result.push_back({string(StringInterner::shared().lookup(entry.first)), type.waiting.size(), type.running,
+                              type.completed, type.totalWaitMs / completed, type.maxWaitMs, type.totalRunMs / completed});
+        }
+    }
+    sort(result.begin(), result.end(), [](const LabTestStats &a, const LabTestStats &b)
+         { return a.test < b.test; });
+    return result;
+}
+
+// ========== REPORT RENDERING ========== //
+// [Mazen Mohamed] Output formats of the listings
+enum ReportFormat
+{
+    REPORT_TEXT,
+    REPORT_CSV,
+    REPORT_JSON
+};
+
+// [Mazen Mohamed] Formats listings into a reusable buffer and writes it out in
+// large pieces instead of line by line. A report is a series of tables made
+// of rows. Each field has a key, used as CSV column and JSON member, and a
+// text prefix printed before it in text form that also carries the
+// separators, e.g. " | Name: ". Text titles and footers are left out of CSV
+// and JSON, and numbers are formatted with to_chars.
+class ReportWriter
+{
+private:
+    // Bytes buffered before they are handed to the stream
+    static const size_t FLUSH_BYTES = 1 << 20;
+    // Buffers of finished reports, kept with their capacity for the next report on this thread
+    static thread_local vector<string> spareBuffers;
+
+    ReportFormat format;
+    ostream &out;
+    string buffer;
+    // CSV column names of the current table, written in front of its first row
+    string header;
+    size_t rowStart;
+    int tableCount;
+    long long rowCount;
+    int fieldCount;
+    bool finished;
+
+    void beginField(string_view key, string_view prefix);
+    void appendQuoted(string_view value);
+    void write();
+
+public:
+    explicit ReportWriter(ReportFormat format = REPORT_TEXT, ostream &out = cout);
+    ~ReportWriter();
+    ReportWriter(const ReportWriter &) = delete;
+    ReportWriter &operator=(const ReportWriter &) = delete;
+
+    ReportFormat getFormat() const;
+    void beginTable(string_view name, string_view title);
+    void endTable(string_view footer);
+    void beginRow();
+    void field(string_view key, string_view prefix, string_view value);
+    template <typename Integer, typename = enable_if_t<is_integral_v<Integer>>>
+    void field(string_view key, string_view prefix, Integer value);
+    void endRow();
+    void finish();
+};
+
+thread_local vector<string> ReportWriter::spareBuffers;
+
+// [Mazen Mohamed] Start a report, reusing a buffer of an earlier one
+ReportWriter::ReportWriter(ReportFormat format, ostream &out)
+    : format(format), out(out), rowStart(0), tableCount(0), rowCount(0), fieldCount(0), finished(false)
+{
+    if (!spareBuffers.empty())
+    {
+        buffer = move(spareBuffers.back());
+        spareBuffers.pop_back();
+        buffer.clear();
+    }
+}
+
+// [Mazen Mohamed] Finish the report and keep the buffer for the next one
+ReportWriter::~ReportWriter()
+{
+    finish();
+    spareBuffers.push_back(move(buffer));
+}
+
+// [Mazen Mohamed] Format the report is written in
+ReportFormat ReportWriter::getFormat() const
+{
+    return format;
+}
+
+// [Mazen Mohamed] Start a table; title is the text heading line, if any
+void ReportWriter::beginTable(string_view name, string_view title)
+{
+    rowCount = 0;
+    header.clear();
+    if (format == REPORT_TEXT)
+    {
+        if (!title.empty())
+        {
+            buffer.append(title);
+            buffer += '\n';
+        }
+    }
+    else if (format == REPORT_CSV)
+    {
+        // Tables are separated by an empty line
+        if (tableCount > 0)
+        {
+            buffer += '\n';
+        }
+    }
+    else
+    {
+        buffer += tableCount == 0 ? "{\n  " : ",\n  ";
+        appendQuoted(name);
+        buffer += ": [";
+    }
+    tableCount++;
+}
+
+// [Mazen Mohamed] End a table; footer is the text closing line, if any
+void ReportWriter::endTable(string_view footer)
+{
+    if (format == REPORT_TEXT && !footer.empty())
+    {
+        buffer.append(footer);
+        buffer += '\n';
+    }
+    else if (format == REPORT_JSON)
+    {
+        buffer += rowCount == 0 ? "]" : "\n  ]";
+    }
+}
+
+// [Mazen Mohamed] Start a row of the current table
+void ReportWriter::beginRow()
+{
+    fieldCount = 0;
+    rowStart = buffer.size();
+    if (format == REPORT_JSON)
+    {
+        buffer += rowCount == 0 ? "\n    {" : ",\n    {";
+    }
+}
+
+// [Mazen Mohamed] Separator, column name or text prefix in front of a value
+void ReportWriter::beginField(string_view key, string_view prefix)
+{
+    if (format == REPORT_TEXT)
+    {
+        buffer.append(prefix);
+    }
+    else if (format == REPORT_CSV)
+    {
+        if (fieldCount > 0)
+        {
+            buffer += ',';
+        }
+        if (rowCount == 0)
+        {
+            header += fieldCount > 0 ? "," : "";
+            header.append(key);
+        }
+    }
+    else
+    {
+        if (fieldCount > 0)
+        {
+            buffer += ", ";
+        }
+        appendQuoted(key);
+        buffer += ": ";
+    }
+    fieldCount++;
+}
+
+// [Mazen Mohamed] Append a text value: quoted and escaped for JSON, quoted for
+// CSV only when it holds a separator, quote or line break
+void ReportWriter::appendQuoted(string_view value)
+{
+    if (format == REPORT_CSV)
+    {
+        if (value.find_first_of(",\"\r\n") == string_view::npos)
+        {
+            buffer.append(value);
+            return;
+        }
+        buffer += '"';
+        for (char c : value)
+        {
+            buffer += c;
+            if (c == '"')
+            {
+                buffer += '"';
+            }
+        }
+        buffer += '"';
+        return;
+    }
+    buffer += '"';
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            buffer += '\\';
+            buffer += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+            buffer += escaped;
+        }
+        else
+        {
+            buffer += c;
+        }
+    }
+    buffer += '"';
+}
+
+// [Mazen Mohamed] Add a text field
+void ReportWriter::field(string_view key, string_view prefix, string_view value)
+{
+    beginField(key, prefix);
+    if (format == REPORT_TEXT)
+    {
+        buffer.append(value);
+    }
+    else
+    {
+        appendQuoted(value);
+    }
+}
+
+// [Mazen Mohamed] Add a number field
+template <typename Integer, typename>
+void ReportWriter::field(string_view key, string_view prefix, Integer value)
+{
+    beginField(key, prefix);
+    char digits[24];
+    to_chars_result result = to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, result.ptr);
+}
+
+// [Mazen Mohamed] End the current row; a full buffer is written out here
+void ReportWriter::endRow()
+{
+    if (format == REPORT_JSON)
+    {
+        buffer += '}';
+    }
+    else
+    {
+        buffer += '\n';
+        if (format == REPORT_CSV && rowCount == 0)
+        {
+            header += '\n';
+            buffer.insert(rowStart, header);
+        }
+    }
+    rowCount++;
+    if (buffer.size() >= FLUSH_BYTES)
+    {
+        write();
+    }
+}
+
+// [Mazen Mohamed] Hand the buffered bytes to the stream
+void ReportWriter::write()
+{
+    out.write(buffer.data(), (streamsize)buffer.size());
+    buffer.clear();
+}
+
+// [Mazen Mohamed] Close the report and write out the rest
+void ReportWriter::finish()
+{
+    if (finished)
+    {
+        return;
+    }
+    finished = true;
+    if (format == REPORT_JSON)
+    {
+        buffer += tableCount == 0 ? "{}\n" : "\n}\n";
+    }
+    write();
+    out.flush();
+}
+
+// ========== PATIENT CLASS ========== //
+class PatientStore;
+
+// Pending tests, oldest first; a list allocates nothing while empty, unlike a
+// deque, and lets a test the lab finished early leave from the middle
+typedef pmr::list<pmr::string> TestQueue;
+
+// [Malak Soliman] Patient data that is variable-sized or only read for one
+// patient at a time; kept out of line from the scanned columns. Everything it
+// allocates comes from the memory resource it is constructed with.
+struct PatientRecord
+{
+    pmr::string name;
+    pmr::string contact;
+    MedicalTimeline medicalHistory;
+    TestQueue testQueue;
+    // Tests at the front of testQueue already handed to the lab
+    uint32_t testsAtLab = 0;
+
+    // History still encoded in a loaded snapshot, decoded on first use
+    // (see decodePendingHistory)
+    const char *pendingHistory = nullptr;
+    uint32_t pendingHistoryCount = 0;
+    uint32_t pendingHistoryBytes = 0;
+
+    explicit PatientRecord(pmr::memory_resource *resource);
+};
+
+// [Malak Soliman] Empty record allocating from resource
+PatientRecord::PatientRecord(pmr::memory_resource *resource)
+    : name(resource), contact(resource), medicalHistory(resource), testQueue(resource)
+{
+}
+
+// [Malak Soliman] Patient class definition and implementation
+// A Patient is a view of one slot of a PatientStore, cheap to copy and
+// valid until the store adds or removes a patient. A default-constructed
+// view refers to no patient and tests false. The view remembers whose slot
+// it was made for: once a removal moves another patient into that slot, the
+// view tests false, and using it stops at an assertion in debug builds.
+class Patient
+{
+private:
+    PatientStore *store;
+    int slot;
+    int id;
+
+    int checkedSlot() const;
+    PatientRecord &record() const;
+    void decodePendingHistory() const;
+    void addEvent(HistoryEventKind kind, int value, uint8_t detail, string_view text);
+
+    friend class PatientStore;
+    friend class SnapshotCodec;
+
+public:
+    Patient();
+    Patient(PatientStore *owner, int position);
+    explicit operator bool() const;
+
+    void admitPatient(RoomType type);
+    void dischargePatient();
+    void addMedicalRecord(string_view record);
+    void recordAppointmentBooked(int doctorId);
+    void requestTest(string_view testName);
+    string performTest();
+    int sendTestsToLab(LabScheduler &lab);
+    bool completeTest(string_view testName);
+    size_t getPendingTestCount() const;
+    size_t getTestsAtLab() const;
+    void displayHistory();
+    void displayRecentHistory(int count);
+    void writeSummary(ReportWriter &report) const;
+    static void writeSummary(ReportWriter &report, int id, string_view name, bool admitted);
+    void writeDetails(ReportWriter &report) const;
+    void writeHistory(ReportWriter &report, size_t last = SIZE_MAX) const;
+    const MedicalTimeline &getHistory() const;
+    static string describeEvent(const HistoryEvent &event, string_view text);
+    static void appendEventText(string &out, const HistoryEvent &event, string_view text);
+    static string roomTypeName(RoomType type);
+
+    int getId() const;
+    string getName() const;
+    int getAge() const;
+    string getContact() const;
+    bool getAdmissionStatus() const;
+    string getRoomType() const;
+    RoomType getRoomTypeValue() const;
+    int getBed() const;
+    void setBed(int bedNumber);
+};
+
+// [Malak Soliman] Column store of patients, one slot per patient
+// The fields read by scans over all patients (ID, age, admission, room type,
+// bed) each live in their own contiguous array, so a census touches only the
+// bytes it needs. Names, contacts, history and tests stay in PatientRecord.
+// Slots are dense: removing a patient moves the last one into its slot, and
+// mapping IDs to slots is left to the owner.
+class PatientStore
+{
+private:
+    vector<int> ids;
+    vector<int> ages;
+    vector<uint8_t> admitted;
+    vector<uint8_t> roomTypes;
+    vector<int> beds; // Bed number within the room type while admitted, -1 when none
+    vector<PatientRecord> records;
+    pmr::memory_resource *resource; // Where records allocate
+
+    friend class Patient;
+    friend class SnapshotCodec;
+
+public:
+    explicit PatientStore(pmr::memory_resource *recordResource = pmr::get_default_resource());
+
+    Patient add(int id, string_view name, int age, string_view contact);
+    Patient copyFrom(Patient source);
+    int remove(int slot);
+    Patient at(int slot);
+    size_t size() const;
+    void reserve(size_t count);
+    void clear();
+
+    const vector<int> &idColumn() const;
+    const vector<uint8_t> &admittedColumn() const;
+    const vector<uint8_t> &roomTypeColumn() const;
+    const vector<int> &bedColumn() const;
+    void countAdmitted(size_t counts[ROOM_TYPE_COUNT], size_t begin, size_t end) const;
+    void historyMemory(size_t &decodedBytes, size_t &encodedBytes) const;
+};
+
+// [Malak Soliman] View of no patient
+Patient::Patient() : store(nullptr), slot(-1), id(0)
+{
+}
+
+// [Malak Soliman] View of the patient in a slot of a store
+Patient::Patient(PatientStore *owner, int position) : store(owner), slot(position), id(owner->ids[position])
+{
+}
+
+// [Malak Soliman] Whether the view refers to a patient, and still to the same one
+Patient::operator bool() const
+{
+    return store != nullptr && slot < (int)store->ids.size() && store->ids[slot] == id;
+}
+
+// [Malak Soliman] Slot of this patient, checked against the ID in debug builds
+inline int Patient::checkedSlot() const
+{
+    assert(*this && "Patient view used after its slot changed hands");
+    return slot;
+}
+
+// [Malak Soliman] Out-of-line data of this patient
+PatientRecord &Patient::record() const
+{
+    return store->records[checkedSlot()];
+}
+
+// [Malak Soliman] Decode history left in a snapshot by SnapshotCodec::load
+// Events are stored oldest first as
+// <u32 timestamp><u8 kind><u8 detail><i32 value>[<u32 length><text>].
+void Patient::decodePendingHistory() const
+{
+    PatientRecord &data = record();
+    if (data.pendingHistory == nullptr)
+    {
+        return;
+    }
+    MedicalTimeline loaded(data.medicalHistory.resource());
+    BinaryReader in{data.pendingHistory, data.pendingHistory + data.pendingHistoryBytes, true};
+    for (uint32_t i = 0; i < data.pendingHistoryCount; i++)
+    {
+        HistoryEvent event = {};
+        event.timestamp = in.u32();
+        event.kind = in.u8();
+        event.detail = in.u8();
+        event.value = in.i32();
+        // The rest of a corrupt history is dropped; an unknown kind cannot
+        // be skipped, as its text length is not known
+        if (event.kind > EVENT_APPOINTMENT_BOOKED ||
+            (event.kind == EVENT_ADMITTED && !isEnumValue<RoomType>(event.detail)))
+        {
+            break;
+        }
+        string_view text;
+        if (event.hasText())
+        {
+            uint32_t length = in.u32();
+            const char *start = in.skip(length);
+            text = in.ok ? string_view(start, length) : string_view();
+        }
+        if (!in.ok)
+        {
+            break;
+        }
+        loaded.append(event, text);
+    }
+    // Events added before the decode are newer than the loaded ones
+    for (const HistoryEvent &event : data.medicalHistory)
+    {
+        loaded.append(event, data.medicalHistory.text(event));
+    }
+    data.medicalHistory = move(loaded);
+    data.pendingHistory = nullptr;
+    data.pendingHistoryCount = 0;
+    data.pendingHistoryBytes = 0;
+}
+
+// [Malak Soliman] Append a typed event stamped with the current time
+void Patient::addEvent(HistoryEventKind kind, int value, uint8_t detail, string_view text)
+{
+    decodePendingHistory();
+    HistoryEvent event = {};
+    event.timestamp = (uint32_t)MedicalTimeline::now();
+    event.kind = (uint8_t)kind;
+    event.detail = detail;
+    event.value = value;
+    record().medicalHistory.append(event, text);
+}
+
+// [Malak Soliman] Admit patient to hospital
+void Patient::admitPatient(RoomType type)
+{
+    int position = checkedSlot();
+    store->admitted[position] = 1;
+    store->roomTypes[position] = (uint8_t)type;
+    addEvent(EVENT_ADMITTED, 0, (uint8_t)type, string_view());
+}
+
+// [Malak Soliman] Discharge patient from hospital
+void Patient::dischargePatient()
+{
+    int position = checkedSlot();
+    store->admitted[position] = 0;
+    store->beds[position] = -1;
+    addEvent(EVENT_DISCHARGED, 0, 0, string_view());
+}
+
+// [Malak Soliman] Add medical record to patient history
+void Patient::addMedicalRecord(string_view record)
+{
+    addEvent(EVENT_NOTE, 0, 0, record);
+}
+
+// [Malak Soliman] Log an appointment booking in the patient history
+void Patient::recordAppointmentBooked(int doctorId)
+{
+    addEvent(EVENT_APPOINTMENT_BOOKED, doctorId, 0, string_view());
+}
+
+// [Malak Soliman] Request a medical test
+void Patient::requestTest(string_view testName)
+{
+    record().testQueue.emplace_back(testName);
+    addEvent(EVENT_TEST_REQUESTED, 0, 0, testName);
+}
+
+// [Malak Soliman] Perform the next test in queue that the lab does not have
+string Patient::performTest()
+{
+    PatientRecord &patient = record();
+    auto next = patient.testQueue.begin();
+    advance(next, patient.testsAtLab);
+    if (next == patient.testQueue.end())
+    {
+        return "No tests pending";
+    }
+    string testName(*next);
+    patient.testQueue.erase(next);
+    addEvent(EVENT_TEST_PERFORMED, 0, 0, testName);
+    return testName;
+}
+
+// [Malak Soliman] Hand every test the lab does not have yet to the lab,
+// returning how many were sent
+int Patient::sendTestsToLab(LabScheduler &lab)
+{
+    PatientRecord &patient = record();
+    auto next = patient.testQueue.begin();
+    advance(next, patient.testsAtLab);
+    int sent = 0;
+    for (; next != patient.testQueue.end(); ++next)
+    {
+        lab.submit(getId(), *next);
+        sent++;
+    }
+    patient.testsAtLab += sent;
+    return sent;
+}
+
+// [Malak Soliman] Log a performed test and drop the first pending test of
+// that name from the queue (one the lab holds, if any: those come first).
+// Returns false when no such test is pending.
+bool Patient::completeTest(string_view testName)
+{
+    PatientRecord &patient = record();
+    auto it = find(patient.testQueue.begin(), patient.testQueue.end(), testName);
+    if (it == patient.testQueue.end())
+    {
+        return false;
+    }
+    if (distance(patient.testQueue.begin(), it) < (ptrdiff_t)patient.testsAtLab)
+    {
+        patient.testsAtLab--;
+    }
+    patient.testQueue.erase(it);
+    addEvent(EVENT_TEST_PERFORMED, 0, 0, testName);
+    return true;
+}
+
+// [Malak Soliman] Number of requested tests not performed yet
+size_t Patient::getPendingTestCount() const
+{
+    return record().testQueue.size();
+}
+
+// [Malak Soliman] Number of pending tests currently at the lab
+size_t Patient::getTestsAtLab() const
+{
+    return record().testsAtLab;
+}
+
+// [Malak Soliman] Display patient medical history
+void Patient::displayHistory()
+{
+    ReportWriter report;
+    writeHistory(report);
+}
+
+// [Malak Soliman] Display only the newest events of the medical history
+void Patient::displayRecentHistory(int count)
+{
+    ReportWriter report;
+    writeHistory(report, count < 0 ? 0 : (size_t)count);
+}
+
+// [Malak Soliman] One row of the patient listing
+void Patient::writeSummary(ReportWriter &report) const
+{
+    writeSummary(report, getId(), record().name, getAdmissionStatus());
+}
+
+// [Malak Soliman] One row of the patient listing, from copied fields
+void Patient::writeSummary(ReportWriter &report, int id, string_view name, bool admitted)
+{
+    report.beginRow();
+    report.field("id", "ID: ", id);
+    report.field("name", " | Name: ", name);
+    report.field("status", " | Status: ", admitted ? "Admitted" : "Not Admitted");
+    report.endRow();
+}
+
+// [Malak Soliman] Patient details, one field per line in text form
+void Patient::writeDetails(ReportWriter &report) const
+{
+    const PatientRecord &data = record();
+    report.beginTable("patient", "");
+    report.beginRow();
+    report.field("id", "Patient ID: ", getId());
+    report.field("name", "\nName: ", data.name);
+    report.field("age", "\nAge: ", getAge());
+    report.field("contact", "\nContact: ", data.contact);
+    report.field("status", "\nAdmission Status: ", getAdmissionStatus() ? "Admitted" : "Not Admitted");
+    if (getAdmissionStatus())
+    {
+        report.field("roomType", "\nRoom Type: ", enumLabel(getRoomTypeValue()));
+        if (getBed() != -1)
+        {
+            report.field("bed", "\nBed: ", getBed());
+        }
+    }
+    report.endRow();
+    report.endTable("");
+}
+
+// [Malak Soliman] Medical history, oldest first; only the last events when
+// last is given. Each line shows the event time when it has one.
+void Patient::writeHistory(ReportWriter &report, size_t last) const
+{
+    decodePendingHistory();
+    const PatientRecord &data = record();
+    string title = last == SIZE_MAX ? "Medical History for " + string(data.name) + ":"
+                                    : "Last " + to_string(last) + " Medical Records for " + string(data.name) + ":";
+    report.beginTable("history", title);
+    string text;
+    char time[32];
+    const MedicalTimeline &medicalHistory = data.medicalHistory;
+    for (auto it = last == SIZE_MAX ? medicalHistory.begin() : medicalHistory.tail(last); it != medicalHistory.end(); ++it)
+    {
+        const HistoryEvent &event = *it;
+        bool timed = event.timestamp != 0;
+        text.clear();
+        appendEventText(text, event, medicalHistory.text(event));
+        report.beginRow();
+        report.field("time", timed ? "- [" : "- ", string_view(time, timed ? MedicalTimeline::formatTime(event.timestamp, time, sizeof(time)) : 0));
+        report.field("event", timed ? "] " : "", text);
+        report.endRow();
+    }
+    report.endTable("");
+}
+
+// [Malak Soliman] Render a history event as the text shown to staff; text
+// is the event's own text from its timeline
+string Patient::describeEvent(const HistoryEvent &event, string_view text)
+{
+    string rendered;
+    appendEventText(rendered, event, text);
+    return rendered;
+}
+
+// [Malak Soliman] Append the text of a history event to out
+void Patient::appendEventText(string &out, const HistoryEvent &event, string_view text)
+{
+    char digits[16];
+    switch (event.kind)
+    {
+    case EVENT_NOTE:
+        out.append(text);
+        break;
+    case EVENT_ADMITTED:
+        out.append("Patient admitted to ");
+        out.append(enumLabel((RoomType)event.detail));
+        out.append(" room type.");
+        break;
+    case EVENT_DISCHARGED:
+        out.append("Patient discharged.");
+        break;
+    case EVENT_TEST_REQUESTED:
+        out.append("Test requested: ");
+        out.append(text);
+        break;
+    case EVENT_TEST_PERFORMED:
+        out.append("Test performed: ");
+        out.append(text);
+        break;
+    case EVENT_APPOINTMENT_BOOKED:
+        out.append("Appointment booked with Doctor ID: ");
+        out.append(digits, to_chars(digits, digits + sizeof(digits), event.value).ptr);
+        break;
+    default:
+        out.append("Unknown event");
+    }
+}
+
+// [Malak Soliman] Read-only view of the medical history, oldest event first
+const MedicalTimeline &Patient::getHistory() const
+{
+    decodePendingHistory();
+    return record().medicalHistory;
+}
+
+// [Malak Soliman] Get patient ID
+int Patient::getId() const
+{
+    return store->ids[checkedSlot()];
+}
+
+// [Malak Soliman] Get patient name
+string Patient::getName() const
+{
+    return string(record().name);
+}
+
+// [Malak Soliman] Get patient age
+int Patient::getAge() const
+{
+    return store->ages[checkedSlot()];
+}
+
+// [Malak Soliman] Get patient contact information
+string Patient::getContact() const
+{
+    return string(record().contact);
+}
+
+// [Malak Soliman] Get admission status
+bool Patient::getAdmissionStatus() const
+{
+    return store->admitted[checkedSlot()] != 0;
+}
+
+// [Malak Soliman] Get room type as string
+string Patient::getRoomType() const
+{
+    return roomTypeName(getRoomTypeValue());
+}
+
+// [Malak Soliman] Get room type as enum value
+RoomType Patient::getRoomTypeValue() const
+{
+    return (RoomType)store->roomTypes[checkedSlot()];
+}
+
+// [Malak Soliman] Get the assigned bed number, -1 when none
+int Patient::getBed() const
+{
+    return store->beds[checkedSlot()];
+}
+
+// [Malak Soliman] Record the bed the patient was given
+void Patient::setBed(int bedNumber)
+{
+    store->beds[checkedSlot()] = bedNumber;
+}
+
+// [Malak Soliman] Name of a room type
+string Patient::roomTypeName(RoomType type)
+{
+    return string(enumLabel(type));
+}
+
+// [Malak Soliman] Empty store whose records allocate from recordResource
+PatientStore::PatientStore(pmr::memory_resource *recordResource) : resource(recordResource)
+{
+}
+
+// [Malak Soliman] Append a patient, returning its view
+Patient PatientStore::add(int id, string_view name, int age, string_view contact)
+{
+    ids.push_back(id);
+    ages.push_back(age);
+    admitted.push_back(0);
+    roomTypes.push_back((uint8_t)GENERAL_WARD);
+    beds.push_back(-1);
+    records.emplace_back(resource);
+    PatientRecord &record = records.back();
+    record.name.assign(name);
+    record.contact.assign(contact);
+    return Patient(this, (int)ids.size() - 1);
+}
+
+// [Malak Soliman] Append a copy of a patient held by another store
+Patient PatientStore::copyFrom(Patient source)
+{
+    PatientStore &from = *source.store;
+    int slot = source.slot;
+    ids.push_back(from.ids[slot]);
+    ages.push_back(from.ages[slot]);
+    admitted.push_back(from.admitted[slot]);
+    roomTypes.push_back(from.roomTypes[slot]);
+    beds.push_back(from.beds[slot]);
+    records.emplace_back(resource);
+    records.back() = from.records[slot];
+    return Patient(this, (int)ids.size() - 1);
+}
+
+// [Malak Soliman] Remove the patient in a slot by moving the last patient
+// into it. Returns the ID of the moved patient, -1 when none moved.
+int PatientStore::remove(int slot)
+{
+    int last = (int)ids.size() - 1;
+    int moved = -1;
+    if (slot != last)
+    {
+        ids[slot] = ids[last];
+        ages[slot] = ages[last];
+        admitted[slot] = admitted[last];
+        roomTypes[slot] = roomTypes[last];
+        beds[slot] = beds[last];
+        records[slot] = move(records[last]);
+        moved = ids[slot];
+    }
+    ids.pop_back();
+    ages.pop_back();
+    admitted.pop_back();
+    roomTypes.pop_back();
+    beds.pop_back();
+    records.pop_back();
+    return moved;
+}
+
+// [Malak Soliman] View of the patient in a slot
+Patient PatientStore::at(int slot)
+{
+    return Patient(this, slot);
+}
+
+// [Malak Soliman] Number of patients
+size_t PatientStore::size() const
+{
+    return ids.size();
+}
+
+// [Malak Soliman] Make room for count patients
+void PatientStore::reserve(size_t count)
+{
+    ids.reserve(count);
+    ages.reserve(count);
+    admitted.reserve(count);
+    roomTypes.reserve(count);
+    beds.reserve(count);
+    records.reserve(count);
+}
+
+// [Malak Soliman] Forget every patient
+void PatientStore::clear()
+{
+    ids.clear();
+    ages.clear();
+    admitted.clear();
+    roomTypes.clear();
+    beds.clear();
+    records.clear();
+}
+
+// [Malak Soliman] Patient IDs in slot order
+const vector<int> &PatientStore::idColumn() const
+{
+    return ids;
+}
+
+// [Malak Soliman] 1 for admitted patients, 0 otherwise, in slot order
+const vector<uint8_t> &PatientStore::admittedColumn() const
+{
+    return admitted;
+}
+
+// [Malak Soliman] Room types in slot order, meaningful for admitted patients
+const vector<uint8_t> &PatientStore::roomTypeColumn() const
+{
+    return roomTypes;
+}
+
+// [Malak Soliman] Bed numbers in slot order, -1 when none
+const vector<int> &PatientStore::bedColumn() const
+{
+    return beds;
+}
+
+// [Malak Soliman] Add the number of admitted patients of each room type in
+// slots [begin, end) to counts. Eight patients are handled per 64-bit word. Room types fit in two
+// bits, so per byte lane the scan sums the admission flag alone, with each
+// room type bit, and with both; the four counts follow from those sums.
+// Lanes hold at most 255, so they are folded into the totals every 255 words.
+void PatientStore::countAdmitted(size_t counts[ROOM_TYPE_COUNT], size_t begin, size_t end) const
+{
+    static_assert(ROOM_TYPE_COUNT == 4, "room types must fit in two bits");
+    const uint64_t EVEN_LANES = 0x00FF00FF00FF00FFULL;
+    auto fold = [&](uint64_t lanes)
+    {
+        uint64_t pairs = (lanes & EVEN_LANES) + ((lanes >> 8) & EVEN_LANES);
+        return (size_t)((pairs * 0x0001000100010001ULL) >> 48);
+    };
+    const uint8_t *admittedBytes = admitted.data() + begin;
+    const uint8_t *roomTypeBytes = roomTypes.data() + begin;
+    size_t count = end - begin;
+    size_t words = count / 8;
+    size_t total = 0, lowBit = 0, highBit = 0, bothBits = 0;
+    size_t i = 0;
+    while (i < words)
+    {
+        size_t blockEnd = min(words, i + 255);
+        uint64_t totalLanes = 0, lowLanes = 0, highLanes = 0, bothLanes = 0;
+        for (; i < blockEnd; i++)
+        {
+            uint64_t admittedWord;
+            uint64_t roomTypeWord;
+            memcpy(&admittedWord, admittedBytes + i * 8, 8);
+            memcpy(&roomTypeWord, roomTypeBytes + i * 8, 8);
+            uint64_t low = roomTypeWord & admittedWord;
+            uint64_t high = (roomTypeWord >> 1) & admittedWord;
+            totalLanes += admittedWord;
+            lowLanes += low;
+            highLanes += high;
+            bothLanes += low & high;
+        }
+        total += fold(totalLanes);
+        lowBit += fold(lowLanes);
+        highBit += fold(highLanes);
+        bothBits += fold(bothLanes);
+    }
+    for (i = words * 8; i < count; i++)
+    {
+        total += admittedBytes[i];
+        lowBit += admittedBytes[i] & roomTypeBytes[i];
+        highBit += admittedBytes[i] & (roomTypeBytes[i] >> 1);
+        bothBits += admittedBytes[i] & roomTypeBytes[i] & (roomTypeBytes[i] >> 1);
+    }
+    counts[GENERAL_WARD] += total - lowBit - highBit + bothBits;
+    counts[ICU] += lowBit - bothBits;
+    counts[PRIVATE_ROOM] += highBit - bothBits;
+    counts[SEMI_PRIVATE] += bothBits;
+}
+
+// [Malak Soliman] Bytes held by the medical histories: decoded timelines, and
+// history still encoded in the loaded snapshot
+void PatientStore::historyMemory(size_t &decodedBytes, size_t &encodedBytes) const
+{
+    decodedBytes = 0;
+    encodedBytes = 0;
+    for (const PatientRecord &record : records)
+    {
+        decodedBytes += record.medicalHistory.memoryUsed();
+        if (record.pendingHistory != nullptr)
+        {
+            encodedBytes += record.pendingHistoryBytes;
+        }
+    }
+}
+
+// ========== LOCK-FREE APPOINTMENT QUEUE ========== //
+// [Hanna] Bounded multi-producer/multi-consumer ring buffer
+// Every cell carries a sequence number that says whether it is free for the
+// producer of lap N or holds a value for the consumer of lap N, so producers
+// and consumers only ever CAS their own position counter. Capacity is
+// rounded up to a power of two.
+template <typename T>
+class MpmcRingQueue
+{
+private:
+    struct Cell
+    {
+        atomic<size_t> sequence;
+        T value;
+    };
+
+    Cell *cells;
+    size_t mask;
+    pmr::memory_resource *resource; // Where the cells are allocated
+    alignas(64) atomic<size_t> enqueuePos;
+    alignas(64) atomic<size_t> dequeuePos;
+
+public:
+    explicit MpmcRingQueue(size_t capacity, pmr::memory_resource *cellResource = pmr::get_default_resource());
+    MpmcRingQueue(const MpmcRingQueue &) = delete;
+    MpmcRingQueue &operator=(const MpmcRingQueue &) = delete;
+    ~MpmcRingQueue();
+
+    bool tryPush(const T &value);
+    bool tryPop(T &value);
+    size_t tryPushBatch(const T *values, size_t count);
+    size_t tryPopBatch(T *values, size_t count);
+    size_t sizeApprox() const;
+    size_t capacity() const;
+    vector<T> snapshot() const;
+};
+
+// [Hanna] Ring constructor implementation
+template <typename T>
+MpmcRingQueue<T>::MpmcRingQueue(size_t capacity, pmr::memory_resource *cellResource) : resource(cellResource)
+{
+    size_t size = 2;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    cells = (Cell *)resource->allocate(size * sizeof(Cell), alignof(Cell));
+    for (size_t i = 0; i < size; i++)
+    {
+        new (&cells[i]) Cell();
+        cells[i].sequence.store(i, memory_order_relaxed);
+    }
+    mask = size - 1;
+    enqueuePos.store(0, memory_order_relaxed);
+    dequeuePos.store(0, memory_order_relaxed);
+}
+
+// [Hanna] Return the cells to their memory resource
+template <typename T>
+MpmcRingQueue<T>::~MpmcRingQueue()
+{
+    for (size_t i = 0; i <= mask; i++)
+    {
+        cells[i].~Cell();
+    }
+    resource->deallocate(cells, (mask + 1) * sizeof(Cell), alignof(Cell));
+}
+
+// [Hanna] Add one value, false if the ring is full
+template <typename T>
+bool MpmcRingQueue<T>::tryPush(const T &value)
+{
+    return tryPushBatch(&value, 1) == 1;
+}
+
+// [Hanna] Take one value, false if the ring is empty
+template <typename T>
+bool MpmcRingQueue<T>::tryPop(T &value)
+{
+    return tryPopBatch(&value, 1) == 1;
+}
+
+// [Hanna] Add up to count values in FIFO order with a single position claim
+// Returns how many were added; fewer than count only when the ring fills up.
+template <typename T>
+size_t MpmcRingQueue<T>::tryPushBatch(const T *values, size_t count)
+{
+    size_t pos = enqueuePos.load(memory_order_relaxed);
+    size_t ready;
+    while (true)
+    {
+        // Count the free cells in a row starting at pos
+        ready = 0;
+        while (ready < count)
+        {
+            size_t sequence = cells[(pos + ready) & mask].sequence.load(memory_order_acquire);
+            if (sequence != pos + ready)
+            {
+                break;
+            }
+            ready++;
+        }
+        if (ready == 0)
+        {
+            size_t sequence = cells[pos & mask].sequence.load(memory_order_acquire);
+            if ((ptrdiff_t)(sequence - pos) < 0)
+            {
+                return 0; // full
+            }
+            pos = enqueuePos.load(memory_order_relaxed);
+            continue;
+        }
+        if (enqueuePos.compare_exchange_weak(pos, pos + ready, memory_order_relaxed))
+        {
+            break;
+        }
+    }
+    for (size_t i = 0; i < ready; i++)
+    {
+        Cell &cell = cells[(pos + i) & mask];
+        cell.value = values[i];
+        cell.sequence.store(pos + i + 1, memory_order_release);
+    }
+    return ready;
+}
+
+// [Hanna] Take up to count values in FIFO order with a single position claim
+template <typename T>
+size_t MpmcRingQueue<T>::tryPopBatch(T *values, size_t count)
+{
+    size_t pos = dequeuePos.load(memory_order_relaxed);
+    size_t ready;
+    while (true)
+    {
+        // Count the published cells in a row starting at pos
+        ready = 0;
+        while (ready < count)
+        {
+            size_t sequence = cells[(pos + ready) & mask].sequence.load(memory_order_acquire);
+            if (sequence != pos + ready + 1)
+            {
+                break;
+            }
+            ready++;
+        }
+        if (ready == 0)
+        {
+            size_t sequence = cells[pos & mask].sequence.load(memory_order_acquire);
+            if ((ptrdiff_t)(sequence - (pos + 1)) < 0)
+            {
+                return 0; // empty
+            }
+            pos = dequeuePos.load(memory_order_relaxed);
+            continue;
+        }
+        if (dequeuePos.compare_exchange_weak(pos, pos + ready, memory_order_relaxed))
+        {
+            break;
+        }
+    }
+    for (size_t i = 0; i < ready; i++)
+    {
+        Cell &cell = cells[(pos + i) & mask];
+        values[i] = cell.value;
+        cell.sequence.store(pos + i + mask + 1, memory_order_release);
+    }
+    return ready;
+}
+
+// [Hanna] Number of queued values; exact only when no one is pushing or popping
+template <typename T>
+size_t MpmcRingQueue<T>::sizeApprox() const
+{
+    size_t head = dequeuePos.load(memory_order_acquire);
+    size_t tail = enqueuePos.load(memory_order_acquire);
+    return tail > head ? tail - head : 0;
+}
+
+// [Hanna] Maximum number of queued values
+template <typename T>
+size_t MpmcRingQueue<T>::capacity() const
+{
+    return mask + 1;
+}
+
+// [Hanna] Queued values in FIFO order without removing them
+// Only meaningful while the ring is quiescent, e.g. when saving a snapshot.
+template <typename T>
+vector<T> MpmcRingQueue<T>::snapshot() const
+{
+    vector<T> result;
+    size_t head = dequeuePos.load(memory_order_acquire);
+    size_t tail = enqueuePos.load(memory_order_acquire);
+    for (size_t pos = head; pos < tail; pos++)
+    {
+        result.push_back(cells[pos & mask].value);
+    }
+    return result;
+}
+
+// ========== DOCTOR CLASS ========== //
+// [Hanna] Doctor class definition and implementation
+class Doctor
+{
+private:
+    int id;
+    pmr::string name;
+    Department department;
+    ArenaPtr<MpmcRingQueue<int>> appointmentQueue;
+
+    friend class SnapshotCodec;
+
+public:
+    // Booking clients and the doctor's workstation may use the queue concurrently
+    static const size_t APPOINTMENT_QUEUE_CAPACITY = 1024;
+
+    Doctor(int did, string_view n, Department d, pmr::memory_resource *resource = pmr::get_default_resource());
+
+    bool addAppointment(int patientId);
+    int addAppointments(const int *patientIds, int count);
+    int seePatient();
+    int seePatients(int *patientIds, int maxCount);
+    int getQueueLength() const;
+    bool isQueueFull() const;
+    bool hasQueued(int patientId) const;
+
+    int getId() const;
+    string getName() const;
+    string getDepartment() const;
+    Department getDepartmentValue() const;
+    static string departmentName(Department dept);
+    void writeSummary(ReportWriter &report) const;
+};
+
+// [Hanna] Doctor constructor implementation
+// The name and the appointment ring are allocated from resource.
+Doctor::Doctor(int did, string_view n, Department d, pmr::memory_resource *resource)
+    : name(n, resource), appointmentQueue(makeInArena<MpmcRingQueue<int>>(resource, APPOINTMENT_QUEUE_CAPACITY, resource))
+{
+    id = did;
+    department = d;
+}
+
+// [Hanna] Add appointment to doctor's queue, false if the queue is full
+bool Doctor::addAppointment(int patientId)
+{
+    return appointmentQueue->tryPush(patientId);
+}
+
+// [Hanna] Add several appointments in order, returning how many fitted
+int Doctor::addAppointments(const int *patientIds, int count)
+{
+    return (int)appointmentQueue->tryPushBatch(patientIds, (size_t)count);
+}
+
+// [Hanna] See next patient in queue
+int Doctor::seePatient()
+{
+    int patientId;
+    if (!appointmentQueue->tryPop(patientId))
+    {
+        return -1;
+    }
+    return patientId;
+}
+
+// [Hanna] Take up to maxCount waiting patients at once, returning how many
+int Doctor::seePatients(int *patientIds, int maxCount)
+{
+    return (int)appointmentQueue->tryPopBatch(patientIds, (size_t)maxCount);
+}
+
+// [Hanna] Number of patients waiting in the queue
+int Doctor::getQueueLength() const
+{
+    return (int)appointmentQueue->sizeApprox();
+}
+
+// [Hanna] Whether the appointment queue has no room for another patient
+bool Doctor::isQueueFull() const
+{
+    return appointmentQueue->sizeApprox() >= appointmentQueue->capacity();
+}
+
+// [Hanna] Whether a patient waits in the queue
+// Only exact while no one is booking or seeing patients at the same time.
+bool Doctor::hasQueued(int patientId) const
+{
+    vector<int> waiting = appointmentQueue->snapshot();
+    return find(waiting.begin(), waiting.end(), patientId) != waiting.end();
+}
+
+// [Hanna] Get doctor ID
+int Doctor::getId() const
+{
+    return id;
+}
+
+// [Hanna] Get doctor name
+string Doctor::getName() const
+{
+    return string(name);
+}
+
+// [Hanna] Get department as enum value
+Department Doctor::getDepartmentValue() const
+{
+    return department;
+}
+
+// [Hanna] Get department name as string
+string Doctor::getDepartment() const
+{
+    return departmentName(department);
+}
+
+// [Hanna] Name of a department
+string Doctor::departmentName(Department dept)
+{
+    return string(enumLabel(dept));
+}
+
+// [Hanna] One row of the doctor listing
+void Doctor::writeSummary(ReportWriter &report) const
+{
+    report.beginRow();
+    report.field("id", "ID: ", id);
+    report.field("name", " | Name: ", name);
+    report.field("department", " | Department: ", enumLabel(department));
+    report.endRow();
+}
+
+// ========== APPOINTMENT CLASS (Kareem's Task) ========== //
+// [Kareem] Appointment class to track detailed appointment information
+class Appointment
+{
+private:
+    int appointmentId;
+    int doctorId;
+    int patientId;
+    string dateTime;
+    int32_t startMinute;
+    AppointmentStatus status;
+
+    friend class SnapshotCodec;
+
+public:
+    // Length of every appointment slot
+    static const int32_t DURATION_MINUTES = 30;
+    // startMinute of an appointment whose date/time could not be parsed
+    static const int32_t NO_START_TIME = INT32_MIN;
+
+    Appointment(int aid, int did, int pid, string_view dt);
+    Appointment(int aid, int did, int pid, string_view dt, int32_t start);
+
+    void setStatus(AppointmentStatus newStatus);
+    int getAppointmentId() const;
+    int getDoctorId() const;
+    int getPatientId() const;
+    string getDateTime() const;
+    int32_t getStartMinute() const;
+    bool hasStartTime() const;
+    AppointmentStatus getStatusValue() const;
+    string getStatus() const;
+    void writeSummary(ReportWriter &report) const;
+};
+
+bool parseDateTime(string_view text, int32_t &minutes);
+
+// [Kareem] Appointment constructor implementation
+// The date/time is copied once, straight from the caller's view.
+Appointment::Appointment(int aid, int did, int pid, string_view dt) : dateTime(dt)
+{
+    appointmentId = aid;
+    doctorId = did;
+    patientId = pid;
+    if (!parseDateTime(dateTime, startMinute))
+    {
+        startMinute = NO_START_TIME;
+    }
+    status = SCHEDULED;
+}
+
+// [Kareem] Appointment whose start was already parsed from dt
+Appointment::Appointment(int aid, int did, int pid, string_view dt, int32_t start) : dateTime(dt)
+{
+    appointmentId = aid;
+    doctorId = did;
+    patientId = pid;
+    startMinute = start;
+    status = SCHEDULED;
+}
+
+// [Kareem] Set appointment status
+void Appointment::setStatus(AppointmentStatus newStatus)
+{
+    status = newStatus;
+}
+
+// [Kareem] Get appointment ID
+int Appointment::getAppointmentId() const
+{
+    return appointmentId;
+}
+
+// [Kareem] Get doctor ID
+int Appointment::getDoctorId() const
+{
+    return doctorId;
+}
+
+// [Kareem] Get patient ID
+int Appointment::getPatientId() const
+{
+    return patientId;
+}
+
+// [Kareem] Get date and time
+string Appointment::getDateTime() const
+{
+    return dateTime;
+}
+
+// [Kareem] Get the start as minutes since 1970-01-01 00:00
+int32_t Appointment::getStartMinute() const
+{
+    return startMinute;
+}
+
+// [Kareem] Whether the date/time was understood
+bool Appointment::hasStartTime() const
+{
+    return startMinute != NO_START_TIME;
+}
+
+// [Kareem] Get status as enum value
+AppointmentStatus Appointment::getStatusValue() const
+{
+    return status;
+}
+
+// [Kareem] Get status as string
+string Appointment::getStatus() const
+{
+    return string(enumLabel(status));
+}
+
+// [Kareem] One row of the appointment listing
+void Appointment::writeSummary(ReportWriter &report) const
+{
+    report.beginRow();
+    report.field("id", "ID: ", appointmentId);
+    report.field("doctorId", " | Doctor: ", doctorId);
+    report.field("patientId", " | Patient: ", patientId);
+    report.field("dateTime", " | Time: ", dateTime);
+    report.field("status", " | Status: ", enumLabel(status));
+    report.endRow();
+}
+
+// ========== APPOINTMENT CALENDAR ========== //
+// [Mazen Mohamed] Days since 1970-01-01 of a proleptic Gregorian date
+int32_t daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2 ? 1 : 0;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// [Mazen Mohamed] Parse "YYYY-MM-DD HH:MM" (a 'T' separator and trailing
+// ":SS" are accepted) into minutes since 1970-01-01 00:00, wall-clock time
+// Years run from 0001 to 5999, so a start and its end both fit in int32_t.
+bool parseDateTime(string_view text, int32_t &minutes)
+{
+    auto number = [&text](size_t offset, size_t digits, int &value)
+    {
+        value = 0;
+        for (size_t i = offset; i < offset + digits; i++)
+        {
+            if (text[i] < '0' || text[i] > '9')
+            {
+                return false;
+            }
+            value = value * 10 + (text[i] - '0');
+        }
+        return true;
+    };
+    size_t first = text.find_first_not_of(' ');
+    size_t last = text.find_last_not_of(' ');
+    if (first == string_view::npos)
+    {
+        return false;
+    }
+    text = text.substr(first, last - first + 1);
+    if ((text.size() != 16 && text.size() != 19) || text[4] != '-' || text[7] != '-' ||
+        (text[10] != ' ' && text[10] != 'T') || text[13] != ':' || (text.size() == 19 && text[16] != ':'))
+    {
+        return false;
+    }
+    int year, month, day, hour, minute, second = 0;
+    if (!number(0, 4, year) || !number(5, 2, month) || !number(8, 2, day) ||
+        !number(11, 2, hour) || !number(14, 2, minute) || (text.size() == 19 && !number(17, 2, second)))
+    {
+        return false;
+    }
+    static const int DAYS_IN_MONTH[] = {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    if (year < 1 || year > 5999 || month < 1 || month > 12 || day < 1 || day > DAYS_IN_MONTH[month - 1] ||
+        (month == 2 && day == 29 && !leap) || hour > 23 || minute > 59 || second > 59)
+    {
+        return false;
+    }
+    minutes = daysFromCivil(year, month, day) * 1440 + hour * 60 + minute;
+    return true;
+}
+
+// [Mazen Mohamed] Format minutes since 1970-01-01 00:00 as "YYYY-MM-DD HH:MM",
+// the inverse of parseDateTime
+string formatDateTime(int32_t minutes)
+{
+    int32_t days = (minutes >= 0 ? minutes : minutes - 1439) / 1440;
+    int minuteOfDay = minutes - days * 1440;
+    days += 719468;
+    int era = (days >= 0 ? days : days - 146096) / 146097;
+    int dayOfEra = days - era * 146097;
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int shiftedMonth = (5 * dayOfYear + 2) / 153;
+    int day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    int month = shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9;
+    int year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+    char text[64];
+    snprintf(text, sizeof(text), "%04d-%02d-%02d %02d:%02d", year, month, day, minuteOfDay / 60, minuteOfDay % 60);
+    return text;
+}
+
+// [Mazen Mohamed] Appointments indexed by time, per doctor and per patient.
+// Each owner keeps its appointments in a vector sorted by start minute. Every
+// appointment lasts Appointment::DURATION_MINUTES, so sorting by start also
+// sorts by end, and a conflict check or range query is one binary search.
+// Cancelled appointments are not kept here.
+class AppointmentCalendar
+{
+private:
+    struct Slot
+    {
+        int32_t start;
+        int appointmentId;
+
+        bool operator<(const Slot &other) const
+        {
+            return start != other.start ? start < other.start : appointmentId < other.appointmentId;
+        }
+    };
+
+    // Owner ID -> that owner's slots
+    vector<vector<Slot>> byDoctor;
+    vector<vector<Slot>> byPatient;
+
+    static int findOverlap(const vector<vector<Slot>> &owners, int ownerId, int32_t start, int32_t end);
+    static int32_t skipBusy(const vector<vector<Slot>> &owners, int ownerId, int32_t start);
+    static void insert(vector<vector<Slot>> &owners, int ownerId, Slot slot);
+    static void erase(vector<vector<Slot>> &owners, int ownerId, Slot slot);
+
+public:
+    int findDoctorConflict(int doctorId, int32_t start) const;
+    int findPatientConflict(int patientId, int32_t start) const;
+    void add(const Appointment &appointment);
+    void remove(const Appointment &appointment);
+    vector<int> doctorAppointments(int doctorId, int32_t from, int32_t to) const;
+    vector<int> patientAppointments(int patientId, int32_t from, int32_t to) const;
+    int32_t doctorFreeFrom(int doctorId) const;
+    int32_t firstFreeStart(int doctorId, int patientId, int32_t from, int32_t to) const;
+    void clear();
+};
+
+// [Mazen Mohamed] First appointment of ownerId overlapping [start, end), or -1
+int AppointmentCalendar::findOverlap(const vector<vector<Slot>> &owners, int ownerId, int32_t start, int32_t end)
+{
+    if (ownerId <= 0 || ownerId >= (int)owners.size())
+    {
+        return -1;
+    }
+    const vector<Slot> &slots = owners[ownerId];
+    // Slots starting after start - duration are the only ones still running at start
+    auto it = lower_bound(slots.begin(), slots.end(), Slot{start - Appointment::DURATION_MINUTES + 1, INT32_MIN});
+    if (it == slots.end() || it->start >= end)
+    {
+        return -1;
+    }
+    return it->appointmentId;
+}
+
+// [Mazen Mohamed] Earliest start at or after start of a slot in which ownerId
+// has no appointment. Ends are sorted like starts, so one pass over the
+// appointments running into the candidate slot moves it past all of them.
+int32_t AppointmentCalendar::skipBusy(const vector<vector<Slot>> &owners, int ownerId, int32_t start)
+{
+    if (ownerId <= 0 || ownerId >= (int)owners.size())
+    {
+        return start;
+    }
+    const vector<Slot> &slots = owners[ownerId];
+    for (auto it = lower_bound(slots.begin(), slots.end(), Slot{start - Appointment::DURATION_MINUTES + 1, INT32_MIN});
+         it != slots.end() && it->start < start + Appointment::DURATION_MINUTES; ++it)
+    {
+        start = it->start + Appointment::DURATION_MINUTES;
+    }
+    return start;
+}
+
+// [Mazen Mohamed] Insert a slot keeping the owner's slots sorted
+void AppointmentCalendar::insert(vector<vector<Slot>> &owners, int ownerId, Slot slot)
+{
+    if (ownerId <= 0)
+    {
+        return;
+    }
+    if (ownerId >= (int)owners.size())
+    {
+        owners.resize(ownerId + 1);
+    }
+    vector<Slot> &slots = owners[ownerId];
+    slots.insert(upper_bound(slots.begin(), slots.end(), slot), slot);
+}
+
+// [Mazen Mohamed] Remove a slot if present
+void AppointmentCalendar::erase(vector<vector<Slot>> &owners, int ownerId, Slot slot)
+{
+    if (ownerId <= 0 || ownerId >= (int)owners.size())
+    {
+        return;
+    }
+    vector<Slot> &slots = owners[ownerId];
+    auto it = lower_bound(slots.begin(), slots.end(), slot);
+    if (it != slots.end() && it->start == slot.start && it->appointmentId == slot.appointmentId)
+    {
+        slots.erase(it);
+    }
+}
+
+// [Mazen Mohamed] Appointment of the doctor overlapping one starting at start, or -1
+int AppointmentCalendar::findDoctorConflict(int doctorId, int32_t start) const
+{
+    return findOverlap(byDoctor, doctorId, start, start + Appointment::DURATION_MINUTES);
+}
+
+// [Mazen Mohamed] Appointment of the patient overlapping one starting at start, or -1
+int AppointmentCalendar::findPatientConflict(int patientId, int32_t start) const
+{
+    return findOverlap(byPatient, patientId, start, start + Appointment::DURATION_MINUTES);
+}
+
+// [Mazen Mohamed] Index an appointment under its doctor and patient
+void AppointmentCalendar::add(const Appointment &appointment)
+{
+    if (!appointment.hasStartTime())
+    {
+        return;
+    }
+    Slot slot{appointment.getStartMinute(), appointment.getAppointmentId()};
+    insert(byDoctor, appointment.getDoctorId(), slot);
+    insert(byPatient, appointment.getPatientId(), slot);
+}
+
+// [Mazen Mohamed] Drop an appointment from the index
+void AppointmentCalendar::remove(const Appointment &appointment)
+{
+    if (!appointment.hasStartTime())
+    {
+        return;
+    }
+    Slot slot{appointment.getStartMinute(), appointment.getAppointmentId()};
+    erase(byDoctor, appointment.getDoctorId(), slot);
+    erase(byPatient, appointment.getPatientId(), slot);
+}
+
+// [Mazen Mohamed] IDs of the doctor's appointments overlapping [from, to), in time order
+vector<int> AppointmentCalendar::doctorAppointments(int doctorId, int32_t from, int32_t to) const
+{
+    vector<int> found;
+    if (doctorId > 0 && doctorId < (int)byDoctor.size())
+    {
+        const vector<Slot> &slots = byDoctor[doctorId];
+        for (auto it = lower_bound(slots.begin(), slots.end(), Slot{from - Appointment::DURATION_MINUTES + 1, INT32_MIN});
+             it != slots.end() && it->start < to; ++it)
+        {
+            found.push_back(it->appointmentId);
+        }
+    }
+    return found;
+}
+
+// [Mazen Mohamed] IDs of the patient's appointments overlapping [from, to), in time order
+vector<int> AppointmentCalendar::patientAppointments(int patientId, int32_t from, int32_t to) const
+{
+    vector<int> found;
+    if (patientId > 0 && patientId < (int)byPatient.size())
+    {
+        const vector<Slot> &slots = byPatient[patientId];
+        for (auto it = lower_bound(slots.begin(), slots.end(), Slot{from - Appointment::DURATION_MINUTES + 1, INT32_MIN});
+             it != slots.end() && it->start < to; ++it)
+        {
+            found.push_back(it->appointmentId);
+        }
+    }
+    return found;
+}
+
+// [Mazen Mohamed] Minute the doctor's last appointment ends, INT32_MIN when
+// the doctor has none
+int32_t AppointmentCalendar::doctorFreeFrom(int doctorId) const
+{
+    if (doctorId <= 0 || doctorId >= (int)byDoctor.size() || byDoctor[doctorId].empty())
+    {
+        return INT32_MIN;
+    }
+    return byDoctor[doctorId].back().start + Appointment::DURATION_MINUTES;
+}
+
+// [Mazen Mohamed] Earliest start in [from, to) of a slot ending by to in which
+// neither the doctor nor the patient is booked, Appointment::NO_START_TIME if none
+int32_t AppointmentCalendar::firstFreeStart(int doctorId, int patientId, int32_t from, int32_t to) const
+{
+    int32_t start = from;
+    while (start <= to - Appointment::DURATION_MINUTES)
+    {
+        int32_t free = skipBusy(byPatient, patientId, skipBusy(byDoctor, doctorId, start));
+        if (free == start)
+        {
+            return start;
+        }
+        start = free;
+    }
+    return Appointment::NO_START_TIME;
+}
+
+// [Mazen Mohamed] Forget every appointment
+void AppointmentCalendar::clear()
+{
+    byDoctor.clear();
+    byPatient.clear();
+}
+
+// ========== SECONDARY INDEXES ========== //
+// [Mazen Mohamed] IDs grouped by a small enum key, kept up to date on every
+// change so a "who has key K" query costs the size of the answer. Each ID
+// remembers its key and its position in that key's bucket, so moving or
+// removing an ID is a swap with the bucket's last element.
+template <size_t KEYS>
+class EnumIndex
+{
+private:
+    vector<int> buckets[KEYS];
+    // ID -> position in its bucket (-1 when not indexed) and its key
+    vector<int> positions;
+    vector<uint8_t> keys;
+
+public:
+    void insert(int id, size_t key);
+    void erase(int id);
+    bool contains(int id) const;
+    const vector<int> &ids(size_t key) const;
+    void clear();
+};
+
+// [Mazen Mohamed] Index id under key, moving it if it is already indexed
+template <size_t KEYS>
+void EnumIndex<KEYS>::insert(int id, size_t key)
+{
+    if (id < 0 || key >= KEYS)
+    {
+        return;
+    }
+    erase(id);
+    if (id >= (int)positions.size())
+    {
+        positions.resize(id + 1, -1);
+        keys.resize(id + 1, 0);
+    }
+    positions[id] = (int)buckets[key].size();
+    keys[id] = (uint8_t)key;
+    buckets[key].push_back(id);
+}
+
+// [Mazen Mohamed] Remove id from the index if present
+template <size_t KEYS>
+void EnumIndex<KEYS>::erase(int id)
+{
+    if (!contains(id))
+    {
+        return;
+    }
+    vector<int> &bucket = buckets[keys[id]];
+    int position = positions[id];
+    bucket[position] = bucket.back();
+    positions[bucket[position]] = position;
+    bucket.pop_back();
+    positions[id] = -1;
+}
+
+// [Mazen Mohamed] Whether id is indexed under any key
+template <size_t KEYS>
+bool EnumIndex<KEYS>::contains(int id) const
+{
+    return id >= 0 && id < (int)positions.size() && positions[id] != -1;
+}
+
+// [Mazen Mohamed] IDs indexed under key, in no particular order
+template <size_t KEYS>
+const vector<int> &EnumIndex<KEYS>::ids(size_t key) const
+{
+    static const vector<int> none;
+    return key < KEYS ? buckets[key] : none;
+}
+
+// [Mazen Mohamed] Empty the index
+template <size_t KEYS>
+void EnumIndex<KEYS>::clear()
+{
+    for (auto &bucket : buckets)
+    {
+        bucket.clear();
+    }
+    positions.clear();
+    keys.clear();
+}
+
+// [Mazen Mohamed] Doctors of every department in a binary min-heap ordered by
+// load: appointment queue length, then the minute their calendar is free
+// from, then ID. Each doctor remembers its heap position, so a load change
+// sifts it up or down in O(log n) and the least-loaded doctor of a
+// department is the root of its heap.
+class DoctorLoadIndex
+{
+private:
+    struct Load
+    {
+        int queueLength;
+        int32_t freeFrom;
+    };
+
+    vector<int> heaps[DEPARTMENT_COUNT];
+    // Doctor ID -> position in its department's heap (-1 when not indexed),
+    // department and load
+    vector<int> positions;
+    vector<uint8_t> departments;
+    vector<Load> loads;
+
+    bool lighter(int first, int second) const;
+    void place(vector<int> &heap, size_t position, int doctorId);
+    void siftUp(vector<int> &heap, size_t position);
+    void siftDown(vector<int> &heap, size_t position);
+    void update(int doctorId);
+
+public:
+    void insert(int doctorId, Department dept, int queueLength = 0, int32_t freeFrom = INT32_MIN);
+    void erase(int doctorId);
+    bool contains(int doctorId) const;
+    void setQueueLength(int doctorId, int queueLength);
+    void setFreeFrom(int doctorId, int32_t freeFrom);
+    int lightest(Department dept) const;
+    template <typename Accept>
+    int lightest(Department dept, Accept accept) const;
+    void clear();
+};
+
+// [Mazen Mohamed] Whether the first doctor's load is below the second's
+bool DoctorLoadIndex::lighter(int first, int second) const
+{
+    const Load &a = loads[first];
+    const Load &b = loads[second];
+    if (a.queueLength != b.queueLength)
+    {
+        return a.queueLength < b.queueLength;
+    }
+    if (a.freeFrom != b.freeFrom)
+    {
+        return a.freeFrom < b.freeFrom;
+    }
+    return first < second;
+}
+
+// [Mazen Mohamed] Put a doctor at a heap position and remember it
+void DoctorLoadIndex::place(vector<int> &heap, size_t position, int doctorId)
+{
+    heap[position] = doctorId;
+    positions[doctorId] = (int)position;
+}
+
+// [Mazen Mohamed] Move the doctor at position up while it is lighter than its parent
+void DoctorLoadIndex::siftUp(vector<int> &heap, size_t position)
+{
+    int doctorId = heap[position];
+    while (position > 0)
+    {
+        size_t parent = (position - 1) / 2;
+        if (!lighter(doctorId, heap[parent]))
+        {
+            break;
+        }
+        place(heap, position, heap[parent]);
+        position = parent;
+    }
+    place(heap, position, doctorId);
+}
+
+// [Mazen Mohamed] Move the doctor at position down while a child is lighter
+void DoctorLoadIndex::siftDown(vector<int> &heap, size_t position)
+{
+    int doctorId = heap[position];
+    for (;;)
+    {
+        size_t child = 2 * position + 1;
+        if (child >= heap.size())
+        {
+            break;
+        }
+        if (child + 1 < heap.size() && lighter(heap[child + 1], heap[child]))
+        {
+            child++;
+        }
+        if (!lighter(heap[child], doctorId))
+        {
+            break;
+        }
+        place(heap, position, heap[child]);
+        position = child;
+    }
+    place(heap, position, doctorId);
+}
+
+// [Mazen Mohamed] Restore the heap order around a doctor whose load changed
+void DoctorLoadIndex::update(int doctorId)
+{
+    vector<int> &heap = heaps[departments[doctorId]];
+    size_t position = (size_t)positions[doctorId];
+    siftUp(heap, position);
+    siftDown(heap, (size_t)positions[doctorId]);
+}
+
+// [Mazen Mohamed] Index a doctor under dept, moving it if it is already indexed
+void DoctorLoadIndex::insert(int doctorId, Department dept, int queueLength, int32_t freeFrom)
+{
+    if (doctorId < 0 || (size_t)dept >= DEPARTMENT_COUNT)
+    {
+        return;
+    }
+    erase(doctorId);
+    if (doctorId >= (int)positions.size())
+    {
+        positions.resize(doctorId + 1, -1);
+        departments.resize(doctorId + 1, 0);
+        loads.resize(doctorId + 1);
+    }
+    departments[doctorId] = (uint8_t)dept;
+    loads[doctorId] = Load{queueLength, freeFrom};
+    vector<int> &heap = heaps[dept];
+    heap.push_back(doctorId);
+    positions[doctorId] = (int)heap.size() - 1;
+    siftUp(heap, heap.size() - 1);
+}
+
+// [Mazen Mohamed] Remove a doctor from the index if present; the last doctor
+// of the heap takes its place and is sifted into order
+void DoctorLoadIndex::erase(int doctorId)
+{
+    if (!contains(doctorId))
+    {
+        return;
+    }
+    vector<int> &heap = heaps[departments[doctorId]];
+    size_t position = (size_t)positions[doctorId];
+    int last = heap.back();
+    heap.pop_back();
+    positions[doctorId] = -1;
+    if (last != doctorId)
+    {
+        place(heap, position, last);
+        update(last);
+    }
+}
+
+// [Mazen Mohamed] Whether a doctor is indexed
+bool DoctorLoadIndex::contains(int doctorId) const
+{
+    return doctorId >= 0 && doctorId < (int)positions.size() && positions[doctorId] != -1;
+}
+
+// [Mazen Mohamed] Record a doctor's new appointment queue length
+void DoctorLoadIndex::setQueueLength(int doctorId, int queueLength)
+{
+    if (contains(doctorId) && loads[doctorId].queueLength != queueLength)
+    {
+        loads[doctorId].queueLength = queueLength;
+        update(doctorId);
+    }
+}
+
+// [Mazen Mohamed] Record the minute from which a doctor's calendar is free
+void DoctorLoadIndex::setFreeFrom(int doctorId, int32_t freeFrom)
+{
+    if (contains(doctorId) && loads[doctorId].freeFrom != freeFrom)
+    {
+        loads[doctorId].freeFrom = freeFrom;
+        update(doctorId);
+    }
+}
+
+// [Mazen Mohamed] Least-loaded doctor of a department, -1 if it has none
+int DoctorLoadIndex::lightest(Department dept) const
+{
+    if ((size_t)dept >= DEPARTMENT_COUNT || heaps[dept].empty())
+    {
+        return -1;
+    }
+    return heaps[dept].front();
+}
+
+// [Mazen Mohamed] Least-loaded doctor of a department that accept(doctorId)
+// takes, -1 if it takes none. Doctors are offered lightest first by walking
+// the heap best-first, so finding the k-th lightest costs O(k log k).
+template <typename Accept>
+int DoctorLoadIndex::lightest(Department dept, Accept accept) const
+{
+    if ((size_t)dept >= DEPARTMENT_COUNT)
+    {
+        return -1;
+    }
+    const vector<int> &heap = heaps[dept];
+    auto heavier = [&](size_t first, size_t second)
+    {
+        return lighter(heap[second], heap[first]);
+    };
+    // Heap positions whose parents were already offered
+    priority_queue<size_t, vector<size_t>, decltype(heavier)> frontier(heavier);
+    if (!heap.empty())
+    {
+        frontier.push(0);
+    }
+    while (!frontier.empty())
+    {
+        size_t position = frontier.top();
+        frontier.pop();
+        if (accept(heap[position]))
+        {
+            return heap[position];
+        }
+        for (size_t child = 2 * position + 1; child <= 2 * position + 2 && child < heap.size(); child++)
+        {
+            frontier.push(child);
+        }
+    }
+    return -1;
+}
+
+// [Mazen Mohamed] Empty the index
+void DoctorLoadIndex::clear()
+{
+    for (auto &heap : heaps)
+    {
+        heap.clear();
+    }
+    positions.clear();
+    departments.clear();
+    loads.clear();
+}
+
+// ========== BED CAPACITY ========== //
+// [Mazen Mohamed] What admitPatient does when no bed of the type is free
+enum AdmissionPolicy
+{
+    ADMIT_FAIL_FAST, // Reject the admission
+    ADMIT_WAITLIST   // Queue the patient until a bed of that type frees up
+};
+
+template <>
+struct EnumTraits<AdmissionPolicy>
+{
+    static constexpr size_t count = ADMIT_WAITLIST + 1;
+    static constexpr string_view title = "Admission Policy";
+    static constexpr string_view names[count] = {"FAIL_FAST", "WAITLIST"};
+    static constexpr string_view labels[count] = {"Fail Fast", "Waitlist"};
+    static constexpr AdmissionPolicy fallback = ADMIT_FAIL_FAST;
+};
+
+// [Mazen Mohamed] Beds of every room type for a single-threaded hospital.
+// Beds are numbered from 0 per room type. Free beds sit on a per-type stack,
+// so taking and returning a bed is O(1). A type without a configured
+// capacity grows a new bed whenever none is free.
+class BedInventory
+{
+private:
+    struct Ward
+    {
+        int capacity;
+        vector<int> occupants;     // bed -> patient ID, -1 when free
+        vector<int> freeBeds;      // stack of free beds
+        vector<int> freePositions; // bed -> index in freeBeds, -1 when occupied
+        // Patient IDs, first come first served; -1 where a patient left the
+        // line early. The entry of ticket t is waitlist[t - firstTicket].
+        deque<int> waitlist;
+        long long firstTicket;
+        int waiting;
+    };
+    // Where a waiting patient stands in line
+    struct WaitTicket
+    {
+        RoomType type;
+        long long ticket;
+    };
+    EnumArray<RoomType, Ward> wards;
+    unordered_map<int, WaitTicket> tickets;
+
+    static void pushFree(Ward &ward, int bed);
+    static void takeFree(Ward &ward, int bed);
+    void compactWaitlist(RoomType type);
+
+public:
+    static const int UNLIMITED = -1;
+
+    BedInventory();
+
+    bool setCapacity(RoomType type, int capacity);
+    int getCapacity(RoomType type) const;
+    int getOccupied(RoomType type) const;
+    int allocate(RoomType type, int patientId);
+    bool occupy(RoomType type, int bed, int patientId);
+    void release(RoomType type, int bed);
+    void clearOccupancy();
+
+    int enqueue(RoomType type, int patientId);
+    int firstWaiting(RoomType type);
+    int nextWaiting(RoomType type);
+    bool removeWaiting(int patientId);
+    bool isWaiting(int patientId) const;
+    int getWaitingCount(RoomType type) const;
+    vector<int> getWaitlist(RoomType type) const;
+};
+
+// [Mazen Mohamed] Every room type starts without a capacity limit
+BedInventory::BedInventory()
+{
+    for (auto &ward : wards)
+    {
+        ward.capacity = UNLIMITED;
+        ward.firstTicket = 0;
+        ward.waiting = 0;
+    }
+}
+
+// [Mazen Mohamed] Put a bed on top of the free stack
+void BedInventory::pushFree(Ward &ward, int bed)
+{
+    ward.freePositions[bed] = (int)ward.freeBeds.size();
+    ward.freeBeds.push_back(bed);
+}
+
+// [Mazen Mohamed] Take a given bed out of the free stack; the top bed fills its place
+void BedInventory::takeFree(Ward &ward, int bed)
+{
+    int position = ward.freePositions[bed];
+    int top = ward.freeBeds.back();
+    ward.freeBeds[position] = top;
+    ward.freePositions[top] = position;
+    ward.freeBeds.pop_back();
+    ward.freePositions[bed] = -1;
+}
+
+// [Mazen Mohamed] Set how many beds a room type has. Shrinking only works
+// while the beds being removed are empty.
+bool BedInventory::setCapacity(RoomType type, int capacity)
+{
+    Ward &ward = wards[type];
+    if (capacity == UNLIMITED)
+    {
+        ward.capacity = UNLIMITED;
+        return true;
+    }
+    if (capacity < 0)
+    {
+        return false;
+    }
+    for (size_t bed = (size_t)capacity; bed < ward.occupants.size(); bed++)
+    {
+        if (ward.occupants[bed] != -1)
+        {
+            return false;
+        }
+    }
+    ward.capacity = capacity;
+    ward.occupants.resize(capacity, -1);
+    ward.freePositions.assign(capacity, -1);
+    // Lowest bed numbers on top of the stack
+    ward.freeBeds.clear();
+    for (int bed = capacity - 1; bed >= 0; bed--)
+    {
+        if (ward.occupants[bed] == -1)
+        {
+            pushFree(ward, bed);
+        }
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Beds of a room type, UNLIMITED when not configured
+int BedInventory::getCapacity(RoomType type) const
+{
+    return wards[type].capacity;
+}
+
+// [Mazen Mohamed] Number of occupied beds of a room type
+int BedInventory::getOccupied(RoomType type) const
+{
+    const Ward &ward = wards[type];
+    return (int)(ward.occupants.size() - ward.freeBeds.size());
+}
+
+// [Mazen Mohamed] Give a free bed to a patient; -1 when the type is full
+int BedInventory::allocate(RoomType type, int patientId)
+{
+    Ward &ward = wards[type];
+    int bed;
+    if (!ward.freeBeds.empty())
+    {
+        bed = ward.freeBeds.back();
+        ward.freeBeds.pop_back();
+        ward.freePositions[bed] = -1;
+    }
+    else if (ward.capacity == UNLIMITED)
+    {
+        bed = (int)ward.occupants.size();
+        ward.occupants.push_back(-1);
+        ward.freePositions.push_back(-1);
+    }
+    else
+    {
+        return -1;
+    }
+    ward.occupants[bed] = patientId;
+    return bed;
+}
+
+// [Mazen Mohamed] Put a patient in a specific bed, e.g. when restoring a snapshot
+bool BedInventory::occupy(RoomType type, int bed, int patientId)
+{
+    Ward &ward = wards[type];
+    if (bed < 0 || (ward.capacity != UNLIMITED && bed >= ward.capacity))
+    {
+        return false;
+    }
+    if ((int)ward.occupants.size() <= bed)
+    {
+        // An unlimited ward grows up to this bed; lowest new numbers on top
+        int firstNew = (int)ward.occupants.size();
+        ward.occupants.resize(bed + 1, -1);
+        ward.freePositions.resize(bed + 1, -1);
+        for (int added = bed; added >= firstNew; added--)
+        {
+            pushFree(ward, added);
+        }
+    }
+    if (ward.occupants[bed] != -1)
+    {
+        return false;
+    }
+    takeFree(ward, bed);
+    ward.occupants[bed] = patientId;
+    return true;
+}
+
+// [Mazen Mohamed] Return a bed to its room type
+void BedInventory::release(RoomType type, int bed)
+{
+    Ward &ward = wards[type];
+    if (bed < 0 || bed >= (int)ward.occupants.size() || ward.occupants[bed] == -1)
+    {
+        return;
+    }
+    ward.occupants[bed] = -1;
+    pushFree(ward, bed);
+}
+
+// [Mazen Mohamed] Empty every bed and waitlist, keeping the capacities
+void BedInventory::clearOccupancy()
+{
+    for (auto &ward : wards)
+    {
+        ward.occupants.assign(ward.capacity == UNLIMITED ? 0 : ward.capacity, -1);
+        ward.freePositions.assign(ward.occupants.size(), -1);
+        ward.freeBeds.clear();
+        for (int bed = (int)ward.occupants.size() - 1; bed >= 0; bed--)
+        {
+            pushFree(ward, bed);
+        }
+        ward.waitlist.clear();
+        ward.firstTicket = 0;
+        ward.waiting = 0;
+    }
+    tickets.clear();
+}
+
+// [Mazen Mohamed] Queue a patient for a room type; returns their place in line
+int BedInventory::enqueue(RoomType type, int patientId)
+{
+    Ward &ward = wards[type];
+    tickets[patientId] = {type, ward.firstTicket + (long long)ward.waitlist.size()};
+    ward.waitlist.push_back(patientId);
+    return ++ward.waiting;
+}
+
+// [Mazen Mohamed] First patient in line for a room type without taking them
+// off, -1 if none; drops the places of patients who left from the front
+int BedInventory::firstWaiting(RoomType type)
+{
+    Ward &ward = wards[type];
+    while (!ward.waitlist.empty() && ward.waitlist.front() == -1)
+    {
+        ward.waitlist.pop_front();
+        ward.firstTicket++;
+    }
+    return ward.waitlist.empty() ? -1 : ward.waitlist.front();
+}
+
+// [Mazen Mohamed] Take the first waiting patient of a room type, -1 if none
+int BedInventory::nextWaiting(RoomType type)
+{
+    int patientId = firstWaiting(type);
+    if (patientId == -1)
+    {
+        return -1;
+    }
+    Ward &ward = wards[type];
+    ward.waitlist.pop_front();
+    ward.firstTicket++;
+    ward.waiting--;
+    tickets.erase(patientId);
+    return patientId;
+}
+
+// [Mazen Mohamed] Take a patient off whichever waitlist they are on
+// Their place is only marked empty; once most places of a line are empty
+// the line is rebuilt, so every removal costs O(1) on average.
+bool BedInventory::removeWaiting(int patientId)
+{
+    auto found = tickets.find(patientId);
+    if (found == tickets.end())
+    {
+        return false;
+    }
+    RoomType type = found->second.type;
+    Ward &ward = wards[type];
+    ward.waitlist[found->second.ticket - ward.firstTicket] = -1;
+    ward.waiting--;
+    tickets.erase(found);
+    if (ward.waitlist.size() > 2 * (size_t)ward.waiting + 16)
+    {
+        compactWaitlist(type);
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Drop the empty places of a line and number it afresh
+void BedInventory::compactWaitlist(RoomType type)
+{
+    Ward &ward = wards[type];
+    deque<int> compacted;
+    for (int patientId : ward.waitlist)
+    {
+        if (patientId != -1)
+        {
+            tickets[patientId].ticket = ward.firstTicket + (long long)compacted.size();
+            compacted.push_back(patientId);
+        }
+    }
+    ward.waitlist.swap(compacted);
+}
+
+// [Mazen Mohamed] Whether a patient is waiting for a bed
+bool BedInventory::isWaiting(int patientId) const
+{
+    return tickets.count(patientId) != 0;
+}
+
+// [Mazen Mohamed] Number of patients waiting for a room type
+int BedInventory::getWaitingCount(RoomType type) const
+{
+    return wards[type].waiting;
+}
+
+// [Mazen Mohamed] Patients waiting for a room type, first in line first
+vector<int> BedInventory::getWaitlist(RoomType type) const
+{
+    const Ward &ward = wards[type];
+    vector<int> waitlist;
+    waitlist.reserve(ward.waiting);
+    for (int patientId : ward.waitlist)
+    {
+        if (patientId != -1)
+        {
+            waitlist.push_back(patientId);
+        }
+    }
+    return waitlist;
+}
+
+// [Mazen Mohamed] Free beds of one room type shared between threads. The free
+// bed numbers live in a lock-free ring, so two admissions can never pop the
+// same bed. Configure before the pool is shared.
+class BedPool
+{
+private:
+    unique_ptr<MpmcRingQueue<int>> freeBeds;
+    int capacity;
+
+public:
+    BedPool();
+
+    void setCapacity(int beds);
+    bool isLimited() const;
+    bool acquire(int &bed);
+    void release(int bed);
+    int getCapacity() const;
+    size_t availableApprox() const;
+};
+
+// [Mazen Mohamed] A pool starts unlimited and hands out no bed numbers
+BedPool::BedPool() : capacity(BedInventory::UNLIMITED)
+{
+}
+
+// [Mazen Mohamed] Fill the pool with beds 0 .. beds-1; not safe while in use
+void BedPool::setCapacity(int beds)
+{
+    capacity = beds;
+    freeBeds.reset(new MpmcRingQueue<int>((size_t)max(beds, 1)));
+    for (int bed = 0; bed < beds; bed++)
+    {
+        freeBeds->tryPush(bed);
+    }
+}
+
+// [Mazen Mohamed] Whether admissions are limited by this pool
+bool BedPool::isLimited() const
+{
+    return capacity != BedInventory::UNLIMITED;
+}
+
+// [Mazen Mohamed] Take a free bed, false when none is left
+bool BedPool::acquire(int &bed)
+{
+    return freeBeds->tryPop(bed);
+}
+
+// [Mazen Mohamed] Return a bed taken with acquire
+void BedPool::release(int bed)
+{
+    freeBeds->tryPush(bed);
+}
+
+// [Mazen Mohamed] Configured number of beds
+int BedPool::getCapacity() const
+{
+    return capacity;
+}
+
+// [Mazen Mohamed] Free beds right now; only a hint while other threads admit
+size_t BedPool::availableApprox() const
+{
+    return freeBeds ? freeBeds->sizeApprox() : 0;
+}
+
+// ========== NAME SEARCH ========== //
+// [Mazen Mohamed] One fuzzy name search hit
+struct NameMatch
+{
+    int patientId;
+    int distance;     // Edits between the query and the closest part of the name
+    int fullDistance; // Edits between the query and the whole name
+};
+
+// [Mazen Mohamed] Trigram index over patient names for typo-tolerant search.
+// Names are lowercased with punctuation folded to single spaces and padded
+// with one space each side, so " jane smith " yields " ja", "jan", ... "th ".
+// Each trigram keeps an ascending list of patient IDs. The padded query
+// matches a name when it is within maxEdits(query) edits of some part of the
+// padded name, i.e. of a run of whole words. One edit destroys at most three
+// trigrams, so a match shares at least q - 3 * edits of the query's q
+// trigrams, so it appears in at least one of the q - that + 1 rarest posting
+// lists. A search counts hits per patient in those lists (two bytes per
+// patient, so the counters stay in cache), then in the longer lists only for
+// patients already counted (by binary search when that beats a scan), and
+// verifies patients reaching the bound with a bit-parallel (Myers) edit
+// distance that handles 64 characters per machine word.
+class NameSearchIndex
+{
+private:
+    pmr::unordered_map<uint32_t, pmr::vector<int>> postings;
+    pmr::vector<pmr::string> names; // patient ID -> normalized name, empty when not indexed
+    size_t indexed;
+
+    // Scratch reused by add and remove so indexing a name allocates nothing
+    // beyond what the index keeps
+    string nameScratch;
+    vector<uint32_t> keyScratch;
+
+    // Per-query scratch, one per thread so concurrent searches do not share
+    // it: shared trigram counts by patient ID, all zero between searches,
+    // and the IDs whose count became non-zero
+    struct SearchScratch
+    {
+        vector<uint16_t> counts;
+        vector<int> touched;
+    };
+    static thread_local SearchScratch scratch;
+
+    // Query compiled for the bit-parallel edit distance: bit i of
+    // positions[c] is set when character i of the pattern is c
+    struct Pattern
+    {
+        uint64_t positions[256];
+        uint64_t last;
+        int length;
+
+        explicit Pattern(string_view text);
+        int distance(string_view text, bool anywhere) const;
+    };
+
+    static void normalize(string_view name, string &out);
+    static void trigrams(string_view padded, vector<uint32_t> &out);
+    static int maxEdits(size_t queryLength);
+
+public:
+    explicit NameSearchIndex(pmr::memory_resource *resource = pmr::get_default_resource());
+
+    void add(int patientId, string_view name);
+    void remove(int patientId);
+    void reserve(size_t idCount);
+    void clear();
+    size_t size() const;
+    vector<NameMatch> search(string_view query, size_t limit) const;
+};
+
+thread_local NameSearchIndex::SearchScratch NameSearchIndex::scratch;
+
+// [Mazen Mohamed] Create an empty index whose names and lists allocate from resource
+NameSearchIndex::NameSearchIndex(pmr::memory_resource *resource) : postings(resource), names(resource), indexed(0)
+{
+}
+
+// [Mazen Mohamed] Lowercase letters and digits, everything else one space, padded with spaces
+void NameSearchIndex::normalize(string_view name, string &normalized)
+{
+    normalized.assign(1, ' ');
+    for (char c : name)
+    {
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'))
+        {
+            normalized += c;
+        }
+        else if (c >= 'A' && c <= 'Z')
+        {
+            normalized += (char)(c - 'A' + 'a');
+        }
+        else if (normalized.back() != ' ')
+        {
+            normalized += ' ';
+        }
+    }
+    if (normalized.back() != ' ')
+    {
+        normalized += ' ';
+    }
+}
+
+// [Mazen Mohamed] Distinct trigrams of a padded name, packed three bytes to a key
+void NameSearchIndex::trigrams(string_view padded, vector<uint32_t> &out)
+{
+    out.clear();
+    for (size_t i = 0; i + 3 <= padded.size(); i++)
+    {
+        out.push_back((uint32_t)(uint8_t)padded[i] << 16 | (uint32_t)(uint8_t)padded[i + 1] << 8 | (uint8_t)padded[i + 2]);
+    }
+    sort(out.begin(), out.end());
+    out.erase(unique(out.begin(), out.end()), out.end());
+}
+
+// [Mazen Mohamed] Typos tolerated for a query of this many characters
+int NameSearchIndex::maxEdits(size_t queryLength)
+{
+    return queryLength <= 3 ? 0 : queryLength <= 7 ? 1 : 2;
+}
+
+// [Mazen Mohamed] Compile a pattern; only its first 64 characters are used
+NameSearchIndex::Pattern::Pattern(string_view text)
+{
+    length = (int)min(text.size(), (size_t)64);
+    fill(begin(positions), end(positions), 0ULL);
+    for (int i = 0; i < length; i++)
+    {
+        positions[(uint8_t)text[i]] |= 1ULL << i;
+    }
+    last = length > 0 ? 1ULL << (length - 1) : 0;
+}
+
+// [Mazen Mohamed] Levenshtein distance from the pattern to text, or with
+// anywhere set, to the closest substring of text. Myers' bit-vector
+// algorithm: each bit of a 64-bit word is one cell of the dynamic-programming
+// column, so the whole column advances in a few word operations per character.
+int NameSearchIndex::Pattern::distance(string_view text, bool anywhere) const
+{
+    if (length == 0)
+    {
+        return anywhere ? 0 : (int)text.size();
+    }
+    uint64_t positive = ~0ULL;
+    uint64_t negative = 0;
+    int score = length;
+    int best = score;
+    for (char c : text)
+    {
+        uint64_t eq = positions[(uint8_t)c];
+        uint64_t xv = eq | negative;
+        uint64_t xh = (((eq & positive) + positive) ^ positive) | eq;
+        uint64_t horizontalPositive = negative | ~(xh | positive);
+        uint64_t horizontalNegative = positive & xh;
+        if (horizontalPositive & last)
+        {
+            score++;
+        }
+        else if (horizontalNegative & last)
+        {
+            score--;
+        }
+        // A substring match may start anywhere, so the top row stays zero
+        horizontalPositive = (horizontalPositive << 1) | (anywhere ? 0 : 1);
+        horizontalNegative <<= 1;
+        positive = horizontalNegative | ~(xv | horizontalPositive);
+        negative = horizontalPositive & xv;
+        best = min(best, score);
+    }
+    return anywhere ? best : score;
+}
+
+// [Mazen Mohamed] Index a patient's name
+void NameSearchIndex::add(int patientId, string_view name)
+{
+    if (patientId <= 0)
+    {
+        return;
+    }
+    if (patientId >= (int)names.size())
+    {
+        names.resize(patientId + 1);
+    }
+    if (!names[patientId].empty())
+    {
+        remove(patientId);
+    }
+    normalize(name, nameScratch);
+    names[patientId].assign(nameScratch);
+    indexed++;
+    trigrams(names[patientId], keyScratch);
+    for (uint32_t key : keyScratch)
+    {
+        pmr::vector<int> &ids = postings[key];
+        // IDs arrive in increasing order, so this is almost always an append
+        ids.insert(upper_bound(ids.begin(), ids.end(), patientId), patientId);
+    }
+}
+
+// [Mazen Mohamed] Drop a patient from the index
+void NameSearchIndex::remove(int patientId)
+{
+    if (patientId <= 0 || patientId >= (int)names.size() || names[patientId].empty())
+    {
+        return;
+    }
+    trigrams(names[patientId], keyScratch);
+    for (uint32_t key : keyScratch)
+    {
+        pmr::vector<int> &ids = postings[key];
+        auto it = lower_bound(ids.begin(), ids.end(), patientId);
+        if (it != ids.end() && *it == patientId)
+        {
+            ids.erase(it);
+        }
+        if (ids.empty())
+        {
+            postings.erase(key);
+        }
+    }
+    names[patientId].clear();
+    indexed--;
+}
+
+// [Mazen Mohamed] Make room for patient IDs below idCount
+void NameSearchIndex::reserve(size_t idCount)
+{
+    names.reserve(idCount);
+}
+
+// [Mazen Mohamed] Forget every name
+void NameSearchIndex::clear()
+{
+    postings.clear();
+    names.clear();
+    indexed = 0;
+}
+
+// [Mazen Mohamed] Number of indexed names
+size_t NameSearchIndex::size() const
+{
+    return indexed;
+}
+
+// [Mazen Mohamed] Up to limit patients whose names best match query, closest
+// first (ties: better whole-name match, then lower ID)
+vector<NameMatch> NameSearchIndex::search(string_view query, size_t limit) const
+{
+    vector<NameMatch> matches;
+    string padded;
+    normalize(query, padded);
+    if (padded.size() <= 2 || limit == 0)
+    {
+        return matches;
+    }
+    int edits = maxEdits(padded.size() - 2);
+    Pattern pattern(padded);
+
+    vector<uint32_t> keys;
+    trigrams(padded, keys);
+    // A count stops at UINT16_MAX, which then still meets the bound
+    int required = min(max(1, (int)keys.size() - 3 * edits), (int)UINT16_MAX);
+    vector<const pmr::vector<int> *> lists;
+    for (uint32_t key : keys)
+    {
+        auto it = postings.find(key);
+        if (it != postings.end())
+        {
+            lists.push_back(&it->second);
+        }
+    }
+    sort(lists.begin(), lists.end(), [](const pmr::vector<int> *a, const pmr::vector<int> *b)
+         { return a->size() < b->size(); });
+
+    // Missing trigrams are the rarest (empty) lists and use up probe slots
+    size_t probed = keys.size() - required + 1;
+    size_t missing = keys.size() - lists.size();
+    probed = probed > missing ? probed - missing : 0;
+
+    // keys are unique, so a patient's count is its number of shared trigrams
+    vector<uint16_t> &counts = scratch.counts;
+    vector<int> &touched = scratch.touched;
+    if (counts.size() < names.size())
+    {
+        counts.resize(names.size(), 0);
+    }
+    for (size_t l = 0; l < lists.size(); l++)
+    {
+        const pmr::vector<int> &ids = *lists[l];
+        if (l < probed)
+        {
+            for (int patientId : ids)
+            {
+                if (counts[patientId] == 0)
+                {
+                    touched.push_back(patientId);
+                }
+                if (counts[patientId] < UINT16_MAX)
+                {
+                    counts[patientId]++;
+                }
+            }
+        }
+        else if (touched.size() * 16 < ids.size())
+        {
+            for (int patientId : touched)
+            {
+                if (counts[patientId] < UINT16_MAX && binary_search(ids.begin(), ids.end(), patientId))
+                {
+                    counts[patientId]++;
+                }
+            }
+        }
+        else
+        {
+            for (int patientId : ids)
+            {
+                if (counts[patientId] != 0 && counts[patientId] < UINT16_MAX)
+                {
+                    counts[patientId]++;
+                }
+            }
+        }
+    }
+    for (int patientId : touched)
+    {
+        if (counts[patientId] >= required)
+        {
+            const pmr::string &name = names[patientId];
+            int distance = pattern.distance(name, true);
+            if (distance <= edits)
+            {
+                matches.push_back({patientId, distance, pattern.distance(name, false)});
+            }
+        }
+        counts[patientId] = 0;
+    }
+    touched.clear();
+
+    auto closer = [](const NameMatch &a, const NameMatch &b)
+    {
+        if (a.distance != b.distance)
+        {
+            return a.distance < b.distance;
+        }
+        if (a.fullDistance != b.fullDistance)
+        {
+            return a.fullDistance < b.fullDistance;
+        }
+        return a.patientId < b.patientId;
+    };
+    size_t kept = min(limit, matches.size());
+    partial_sort(matches.begin(), matches.begin() + kept, matches.end(), closer);
+    matches.resize(kept);
+    return matches;
+}
+
+// ========== DURABLE FILES ========== //
+// [Mazen Mohamed] FNV-1a over length bytes of data, continuing from hash
+uint32_t checksumBytes(const char *data, size_t length, uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// [Mazen Mohamed] End a file image with the checksum:u32 of everything before it
+void putChecksumTrailer(string &out)
+{
+    putU32(out, checksumBytes(out.data(), out.size()));
+}
+
+// [Mazen Mohamed] Whether a file image ends with the checksum of the rest;
+// on success in stops before the trailer
+bool readChecksumTrailer(BinaryReader &in, const char *data, size_t size)
+{
+    if (size < sizeof(uint32_t))
+    {
+        return false;
+    }
+    BinaryReader trailer{data + size - sizeof(uint32_t), data + size, true};
+    if (trailer.u32() != checksumBytes(data, size - sizeof(uint32_t)))
+    {
+        return false;
+    }
+    in.end = data + size - sizeof(uint32_t);
+    return true;
+}
+
+// [Mazen Mohamed] Flush a written file's data to the disk
+bool syncFile(FILE *file)
+{
+    if (fflush(file) != 0)
+    {
+        return false;
+    }
+#ifndef _WIN32
+    return fsync(fileno(file)) == 0;
+#else
+    return _commit(_fileno(file)) == 0;
+#endif
+}
+
+// [Mazen Mohamed] Make a rename or truncation in the directory holding path
+// durable; on Windows the file system commits metadata on its own
+void syncDirectoryOf(const string &path)
+{
+#ifndef _WIN32
+    size_t slash = path.find_last_of('/');
+    string directory = slash == string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    int descriptor = ::open(directory.c_str(), O_RDONLY);
+    if (descriptor != -1)
+    {
+        fsync(descriptor);
+        ::close(descriptor);
+    }
+#else
+    (void)path;
+#endif
+}
+
+// [Mazen Mohamed] Replace the file at path with size bytes of data. They go
+// to path.tmp first, which is synced and then renamed over path, and the
+// directory is synced last, so after a crash path holds either the old or
+// the new contents, never neither.
+bool replaceFileDurably(const string &path, const char *data, size_t size)
+{
+    string tempPath = path + ".tmp";
+    FILE *file = fopen(tempPath.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    bool written = fwrite(data, 1, size, file) == size && syncFile(file);
+    written = fclose(file) == 0 && written;
+#ifdef _WIN32
+    // rename does not replace an existing file here
+    if (written)
+    {
+        remove(path.c_str());
+    }
+#endif
+    if (!written || rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        remove(tempPath.c_str());
+        return false;
+    }
+    syncDirectoryOf(path);
+    return true;
+}
+
+// [Mazen Mohamed] Cut the file at path down to size bytes in place and sync it
+bool truncateFileDurably(const string &path, size_t size)
+{
+    FILE *file = fopen(path.c_str(), "r+b");
+    if (file == nullptr)
+    {
+        return false;
+    }
+#ifndef _WIN32
+    bool cut = ftruncate(fileno(file), (off_t)size) == 0;
+#else
+    bool cut = _chsize_s(_fileno(file), (long long)size) == 0;
+#endif
+    cut = cut && syncFile(file);
+    return fclose(file) == 0 && cut;
+}
+
+// ========== WRITE-AHEAD LOG ========== //
+// [Mazen Mohamed] Kinds of mutation recorded in the write-ahead log
+enum WalRecordType
+{
+    WAL_REGISTER_PATIENT = 1,
+    WAL_ADD_DOCTOR,
+    WAL_REMOVE_PATIENT,
+    WAL_REMOVE_DOCTOR,
+    WAL_ADMIT_PATIENT,
+    WAL_ADD_EMERGENCY,
+    WAL_HANDLE_EMERGENCY,
+    WAL_BOOK_APPOINTMENT,
+    WAL_MEDICAL_RECORD,
+    WAL_SCHEDULE_APPOINTMENT,
+    WAL_UPDATE_APPOINTMENT_STATUS,
+    WAL_SET_EMERGENCY_PRIORITY,
+    WAL_DISCHARGE_PATIENT,
+    WAL_SET_BED_CAPACITY,
+    WAL_SET_ADMISSION_POLICY,
+    WAL_REQUEST_TEST,
+    WAL_TEST_PERFORMED,
+    WAL_IMPORT_PATIENT,
+    WAL_SEE_PATIENT,
+    // Directory of a HospitalFederation router, kept in a log of its own
+    WAL_DIRECTORY_PATIENT,
+    WAL_DIRECTORY_DOCTOR,
+    WAL_DIRECTORY_APPOINTMENT,
+    WAL_DIRECTORY_VISITOR,
+    WAL_WAITLIST_PATIENT
+};
+
+// [Mazen Mohamed] Append-only log of hospital mutations with group commit
+// Callers only copy their record into a memory buffer. A background thread
+// writes the buffer and fsyncs once per sync window, so many mutations share
+// one fsync. The file starts with magic[8] epoch:u32, where the epoch is
+// bumped every time a checkpoint empties the log. Records follow as
+// <u32 length><u8 type><payload><u32 checksum>, where the payload starts with
+// the i64 time of the mutation. Replay stops at the first torn or corrupt
+// record. A failed write or fsync is sticky: sync() reports it until a
+// truncate starts a fresh log generation.
+class WriteAheadLog
+{
+private:
+    FILE *file;
+    string path;
+    string pending;
+    size_t maxPendingBytes;
+    chrono::milliseconds syncWindow;
+    mutex lock;
+    condition_variable wake;
+    thread flusher;
+    bool stopping;
+    bool flushRequested;
+    bool writing;
+    bool failed;
+    long long appendedRecords;
+    long long durableRecords;
+    long long syncCount;
+
+    void flushLoop();
+    bool writePending(string &batch);
+    bool writeHeader(uint32_t epoch);
+
+public:
+    static const char MAGIC[8];
+    static const size_t HEADER_BYTES = sizeof(MAGIC) + sizeof(uint32_t);
+
+    WriteAheadLog();
+    ~WriteAheadLog();
+    WriteAheadLog(const WriteAheadLog &) = delete;
+    WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+
+    bool open(const string &logPath, uint32_t epoch, int syncWindowMs, size_t batchBytes = 1 << 20);
+    void close();
+    void append(WalRecordType type, const string &payload);
+    bool sync();
+    bool truncate(uint32_t newEpoch);
+    long long getAppendedRecords();
+    long long getSyncCount();
+
+    static uint32_t checksum(uint8_t type, const char *data, size_t length);
+};
+
+const char WriteAheadLog::MAGIC[8] = {'H', 'M', 'S', 'W', 'A', 'L', '\1', '\0'};
+
+// [Mazen Mohamed] WriteAheadLog constructor implementation
+WriteAheadLog::WriteAheadLog()
+{
+    file = nullptr;
+    maxPendingBytes = 1 << 20;
+    syncWindow = chrono::milliseconds(10);
+    stopping = false;
+    flushRequested = false;
+    writing = false;
+    failed = false;
+    appendedRecords = 0;
+    durableRecords = 0;
+    syncCount = 0;
+}
+
+// [Mazen Mohamed] Flush whatever is buffered before going away
+WriteAheadLog::~WriteAheadLog()
+{
+    close();
+}
+
+// [Mazen Mohamed] Open (or create) the log for appending and start the flusher
+// epoch is only written when the file is new. syncWindowMs bounds how long an
+// appended record can wait for its fsync.
+bool WriteAheadLog::open(const string &logPath, uint32_t epoch, int syncWindowMs, size_t batchBytes)
+{
+    close();
+    file = fopen(logPath.c_str(), "ab");
+    if (file == nullptr)
+    {
+        cout << "Failed to open write-ahead log " << logPath << "." << endl;
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0 && !writeHeader(epoch))
+    {
+        fclose(file);
+        file = nullptr;
+        cout << "Failed to initialise write-ahead log " << logPath << "." << endl;
+        return false;
+    }
+    path = logPath;
+    appendedRecords = 0;
+    durableRecords = 0;
+    syncWindow = chrono::milliseconds(max(syncWindowMs, 1));
+    maxPendingBytes = batchBytes;
+    stopping = false;
+    failed = false;
+    flusher = thread(&WriteAheadLog::flushLoop, this);
+    return true;
+}
+
+// [Mazen Mohamed] Stop the flusher, syncing everything appended so far
+// The flusher outlives the file when a truncate failed, so it is joined on
+// its own.
+void WriteAheadLog::close()
+{
+    if (flusher.joinable())
+    {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        flusher.join();
+    }
+    if (file != nullptr)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+// [Mazen Mohamed] Start an empty log generation
+bool WriteAheadLog::writeHeader(uint32_t epoch)
+{
+    string header(MAGIC, sizeof(MAGIC));
+    putU32(header, epoch);
+    return fwrite(header.data(), 1, header.size(), file) == header.size() && fflush(file) == 0;
+}
+
+// [Mazen Mohamed] Write one batch and make it durable; false if any of it
+// may not have reached the disk
+bool WriteAheadLog::writePending(string &batch)
+{
+    bool written = batch.empty() ||
+                   (file != nullptr && fwrite(batch.data(), 1, batch.size(), file) == batch.size() && syncFile(file));
+    batch.clear();
+    return written;
+}
+
+// [Mazen Mohamed] Background group commit: one write + fsync per window
+void WriteAheadLog::flushLoop()
+{
+    string batch;
+    unique_lock<mutex> guard(lock);
+    while (true)
+    {
+        wake.wait_for(guard, syncWindow, [this]
+                      { return stopping || flushRequested || pending.size() >= maxPendingBytes; });
+        batch.swap(pending);
+        long long batchEnd = appendedRecords;
+        bool last = stopping;
+        flushRequested = false;
+        // Once a write failed, later records would follow a hole in the file
+        if (failed)
+        {
+            batch.clear();
+        }
+        bool wrote = !batch.empty();
+        writing = true;
+        guard.unlock();
+        bool written = writePending(batch);
+        guard.lock();
+        writing = false;
+        if (!written)
+        {
+            failed = true;
+        }
+        else if (!failed)
+        {
+            durableRecords = batchEnd;
+        }
+        if (wrote && written)
+        {
+            syncCount++;
+        }
+        wake.notify_all();
+        if (last)
+        {
+            break;
+        }
+    }
+}
+
+// [Mazen Mohamed] Buffer one mutation record for the next group commit
+void WriteAheadLog::append(WalRecordType type, const string &payload)
+{
+    lock_guard<mutex> guard(lock);
+    if (file == nullptr)
+    {
+        return;
+    }
+    size_t start = pending.size();
+    putU32(pending, (uint32_t)(sizeof(uint64_t) + payload.size()));
+    putU8(pending, (uint8_t)type);
+    putU64(pending, (uint64_t)MedicalTimeline::now());
+    pending.append(payload);
+    const char *body = pending.data() + start + sizeof(uint32_t) + 1;
+    putU32(pending, checksum((uint8_t)type, body, sizeof(uint64_t) + payload.size()));
+    appendedRecords++;
+    if (pending.size() >= maxPendingBytes)
+    {
+        wake.notify_all();
+    }
+}
+
+// [Mazen Mohamed] Block until every record appended so far is on disk
+// Returns false when a record could not be written or synced, so the
+// mutations it carries must not be acknowledged.
+bool WriteAheadLog::sync()
+{
+    unique_lock<mutex> guard(lock);
+    if (file == nullptr)
+    {
+        return !failed;
+    }
+    long long target = appendedRecords;
+    flushRequested = true;
+    wake.notify_all();
+    wake.wait(guard, [this, target]
+              { return failed || durableRecords >= target; });
+    return !failed;
+}
+
+// [Mazen Mohamed] Drop every record once they are covered by a snapshot
+// Everything appended so far counts as covered, including records still
+// buffered and those a failed write lost, so a failed log recovers here.
+bool WriteAheadLog::truncate(uint32_t newEpoch)
+{
+    sync();
+    unique_lock<mutex> guard(lock);
+    // A batch the flusher is writing must land before the file is swapped,
+    // and its record count before the counters restart
+    wake.wait(guard, [this]
+              { return !writing; });
+    if (file == nullptr)
+    {
+        return false;
+    }
+    pending.clear();
+    appendedRecords = 0;
+    durableRecords = 0;
+    FILE *emptied = freopen(path.c_str(), "wb", file);
+    if (emptied == nullptr)
+    {
+        file = nullptr;
+        failed = true;
+        cout << "Failed to truncate write-ahead log " << path << "." << endl;
+        return false;
+    }
+    file = emptied;
+    failed = !writeHeader(newEpoch);
+    return !failed;
+}
+
+// [Mazen Mohamed] Number of records appended since the log was opened or truncated
+long long WriteAheadLog::getAppendedRecords()
+{
+    lock_guard<mutex> guard(lock);
+    return appendedRecords;
+}
+
+// [Mazen Mohamed] Number of group commits (fsyncs) performed so far
+long long WriteAheadLog::getSyncCount()
+{
+    lock_guard<mutex> guard(lock);
+    return syncCount;
+}
+
+// [Mazen Mohamed] FNV-1a over the record type and payload
+uint32_t WriteAheadLog::checksum(uint8_t type, const char *data, size_t length)
+{
+    return checksumBytes(data, length, (2166136261u ^ type) * 16777619u);
+}
+
+// ========== CHANGE FEED ========== //
+// [Mazen Mohamed] Kinds of change published on the change feed; the comments
+// say what an event's subject, related, detail and value fields carry (0 when unused)
+enum ChangeType : uint8_t
+{
+    CHANGE_PATIENT_REGISTERED, // subject patient, detail age
+    CHANGE_PATIENT_REMOVED,    // subject patient
+    CHANGE_PATIENT_IMPORTED,   // subject patient (its new ID)
+    CHANGE_DOCTOR_ADDED,       // subject doctor, value department
+    CHANGE_DOCTOR_REMOVED,     // subject doctor
+    CHANGE_PATIENT_ADMITTED,   // subject patient, detail bed, value room type
+    CHANGE_PATIENT_WAITLISTED, // subject patient, detail place on the waitlist, value room type
+    CHANGE_PATIENT_DISCHARGED, // subject patient, detail bed, value room type
+    CHANGE_BED_CAPACITY,       // detail capacity, value room type
+    CHANGE_ADMISSION_POLICY,   // value policy
+    CHANGE_MEDICAL_RECORD,     // subject patient
+    CHANGE_TEST_REQUESTED,     // subject patient
+    CHANGE_TEST_PERFORMED,     // subject patient
+    CHANGE_EMERGENCY_QUEUED,   // subject patient, value priority
+    CHANGE_EMERGENCY_HANDLED,  // subject patient
+    CHANGE_EMERGENCY_PRIORITY, // subject patient, value priority
+    CHANGE_APPOINTMENT_BOOKED, // subject patient, related doctor, detail appointment (0 for a queue booking)
+    CHANGE_APPOINTMENT_STATUS, // subject patient, related doctor, detail appointment, value status
+    CHANGE_PATIENT_SEEN        // subject patient, related doctor
+};
+
+template <>
+struct EnumTraits<ChangeType>
+{
+    static constexpr size_t count = CHANGE_PATIENT_SEEN + 1;
+    static constexpr string_view names[count] = {
+        "PATIENT_REGISTERED", "PATIENT_REMOVED", "PATIENT_IMPORTED", "DOCTOR_ADDED", "DOCTOR_REMOVED",
+        "PATIENT_ADMITTED", "PATIENT_WAITLISTED", "PATIENT_DISCHARGED", "BED_CAPACITY", "ADMISSION_POLICY",
+        "MEDICAL_RECORD", "TEST_REQUESTED", "TEST_PERFORMED", "EMERGENCY_QUEUED", "EMERGENCY_HANDLED",
+        "EMERGENCY_PRIORITY", "APPOINTMENT_BOOKED", "APPOINTMENT_STATUS", "PATIENT_SEEN"};
+};
+
+// [Mazen Mohamed] One published change
+struct ChangeEvent
+{
+    uint64_t sequence; // Position in the feed, counting from 0
+    long long time;    // Seconds since the Unix epoch
+    ChangeType type;
+    uint8_t value;
+    int subject;
+    int related;
+    int detail;
+};
+
+// [Mazen Mohamed] Lock-free ring of change events with one writer and any
+// number of readers. Event n goes to slot n modulo the capacity; the slot's
+// stamp is odd while the writer fills it and 2 * (n + 1) once it is complete.
+// A reader copies the slot and checks the stamp again, so neither side ever
+// waits for the other, and a reader more than a ring behind loses the events
+// that were overwritten.
+// The ring can live in a shared file mapping (a tap, best placed under
+// /dev/shm) that other processes attach to read-only. The mapping starts with
+// a 128 byte header: magic[8] capacity:u64, the published count at offset 64
+// and the closed flag after it; 32 byte slots follow.
+class ChangeFeed
+{
+private:
+    struct Header
+    {
+        char magic[8];
+        uint64_t capacity;
+        uint64_t reserved[6];
+        atomic<uint64_t> published;
+        atomic<uint32_t> closed;
+        uint32_t padding[13];
+    };
+    struct Slot
+    {
+        atomic<uint64_t> stamp;
+        atomic<uint64_t> words[3];
+    };
+
+    Header *header;
+    Slot *slots;
+    uint64_t mask;
+    bool writer;
+    // Memory of an in-process feed, or the mapping of a tap
+    unique_ptr<uint64_t[]> localMemory;
+    void *mapping;
+    size_t mappingBytes;
+
+    void release();
+
+public:
+    static const char MAGIC[8];
+
+    ChangeFeed();
+    ~ChangeFeed();
+    ChangeFeed(const ChangeFeed &) = delete;
+    ChangeFeed &operator=(const ChangeFeed &) = delete;
+
+    bool create(size_t capacity, const string &tapPath = string());
+    bool attach(const string &tapPath);
+    void publish(ChangeType type, int subject, int related = 0, int detail = 0, int value = 0);
+    void close();
+    bool read(uint64_t sequence, ChangeEvent &event) const;
+    uint64_t getPublished() const;
+    uint64_t getCapacity() const;
+    bool isClosed() const;
+};
+
+static_assert(sizeof(atomic<uint64_t>) == 8 && atomic<uint64_t>::is_always_lock_free,
+              "change feed slots must be lock-free to be shared between processes");
+
+const char ChangeFeed::MAGIC[8] = {'H', 'M', 'S', 'F', 'E', 'E', 'D', '\1'};
+
+// [Mazen Mohamed] ChangeFeed constructor implementation
+ChangeFeed::ChangeFeed()
+{
+    header = nullptr;
+    slots = nullptr;
+    mask = 0;
+    writer = false;
+    mapping = nullptr;
+    mappingBytes = 0;
+}
+
+// [Mazen Mohamed] Close the feed and drop its memory
+ChangeFeed::~ChangeFeed()
+{
+    release();
+}
+
+// [Mazen Mohamed] Mark a written feed closed and unmap it
+void ChangeFeed::release()
+{
+    if (writer && header != nullptr)
+    {
+        close();
+    }
+#ifndef _WIN32
+    if (mapping != nullptr)
+    {
+        munmap(mapping, mappingBytes);
+    }
+#endif
+    mapping = nullptr;
+    mappingBytes = 0;
+    localMemory.reset();
+    header = nullptr;
+    slots = nullptr;
+    writer = false;
+}
+
+// [Mazen Mohamed] Set up an empty feed to publish to, holding the last
+// capacity events (rounded up to a power of two). With a tap path the ring is
+// created in a fresh shared mapping of that file; the file stays behind when
+// the feed closes so late readers still find its tail.
+bool ChangeFeed::create(size_t capacity, const string &tapPath)
+{
+    release();
+    uint64_t slotCount = 2;
+    while (slotCount < capacity)
+    {
+        slotCount *= 2;
+    }
+    size_t bytes = sizeof(Header) + slotCount * sizeof(Slot);
+    char *memory;
+    if (tapPath.empty())
+    {
+        localMemory = make_unique<uint64_t[]>(bytes / sizeof(uint64_t));
+        memory = (char *)localMemory.get();
+    }
+    else
+    {
+#ifndef _WIN32
+        // A new file, so readers of an earlier feed keep their old mapping
+        unlink(tapPath.c_str());
+        int fd = ::open(tapPath.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd < 0)
+        {
+            return false;
+        }
+        void *mapped = MAP_FAILED;
+        if (ftruncate(fd, (off_t)bytes) == 0)
+        {
+            mapped = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (mapped == MAP_FAILED)
+        {
+            unlink(tapPath.c_str());
+            return false;
+        }
+        mapping = mapped;
+        mappingBytes = bytes;
+        memory = (char *)mapped;
+#else
+        return false;
+#endif
+    }
+
+    header = new (memory) Header();
+    slots = (Slot *)(memory + sizeof(Header));
+    for (uint64_t i = 0; i < slotCount; i++)
+    {
+        new (&slots[i]) Slot();
+    }
+    header->capacity = slotCount;
+    // Readers check the magic before anything else, so it goes in last
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, MAGIC, sizeof(MAGIC));
+    mask = slotCount - 1;
+    writer = true;
+    return true;
+}
+
+// [Mazen Mohamed] Map the tap of a feed another process publishes to, for reading
+bool ChangeFeed::attach(const string &tapPath)
+{
+    release();
+#ifndef _WIN32
+    int fd = ::open(tapPath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    void *mapped = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(Header))
+    {
+        mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return false;
+    }
+    mapping = mapped;
+    mappingBytes = (size_t)info.st_size;
+    header = (Header *)mapped;
+    slots = (Slot *)((char *)mapped + sizeof(Header));
+    uint64_t slotCount = header->capacity;
+    if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 || slotCount < 2 || (slotCount & (slotCount - 1)) != 0 ||
+        slotCount > (mappingBytes - sizeof(Header)) / sizeof(Slot))
+    {
+        release();
+        return false;
+    }
+    mask = slotCount - 1;
+    return true;
+#else
+    (void)tapPath;
+    return false;
+#endif
+}
+
+// [Mazen Mohamed] Append an event, overwriting the oldest once the ring is
+// full; only the single writer may call this
+void ChangeFeed::publish(ChangeType type, int subject, int related, int detail, int value)
+{
+    uint64_t sequence = header->published.load(memory_order_relaxed);
+    Slot &slot = slots[sequence & mask];
+    slot.stamp.store(sequence * 2 + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot.words[0].store((uint64_t)MedicalTimeline::now(), memory_order_relaxed);
+    slot.words[1].store((uint64_t)(uint32_t)subject | (uint64_t)(uint32_t)related << 32, memory_order_relaxed);
+    slot.words[2].store((uint64_t)(uint32_t)detail | (uint64_t)type << 32 | (uint64_t)(uint8_t)value << 40,
+                        memory_order_relaxed);
+    slot.stamp.store(sequence * 2 + 2, memory_order_release);
+    header->published.store(sequence + 1, memory_order_release);
+}
+
+// [Mazen Mohamed] Tell readers no more events will follow
+void ChangeFeed::close()
+{
+    header->closed.store(1, memory_order_release);
+}
+
+// [Mazen Mohamed] Copy event sequence out of the ring; false when it is not
+// published yet or was overwritten
+bool ChangeFeed::read(uint64_t sequence, ChangeEvent &event) const
+{
+    const Slot &slot = slots[sequence & mask];
+    uint64_t stamp = slot.stamp.load(memory_order_acquire);
+    if (stamp != sequence * 2 + 2)
+    {
+        return false;
+    }
+    uint64_t time = slot.words[0].load(memory_order_relaxed);
+    uint64_t ids = slot.words[1].load(memory_order_relaxed);
+    uint64_t rest = slot.words[2].load(memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (slot.stamp.load(memory_order_relaxed) != stamp)
+    {
+        return false;
+    }
+    event.sequence = sequence;
+    event.time = (long long)time;
+    event.subject = (int)(uint32_t)ids;
+    event.related = (int)(uint32_t)(ids >> 32);
+    event.detail = (int)(uint32_t)rest;
+    event.type = (ChangeType)(uint8_t)(rest >> 32);
+    event.value = (uint8_t)(rest >> 40);
+    return true;
+}
+
+// [Mazen Mohamed] Number of events published so far
+uint64_t ChangeFeed::getPublished() const
+{
+    return header->published.load(memory_order_acquire);
+}
+
+// [Mazen Mohamed] Number of events the ring holds
+uint64_t ChangeFeed::getCapacity() const
+{
+    return mask + 1;
+}
+
+// [Mazen Mohamed] Whether the writer has closed the feed
+bool ChangeFeed::isClosed() const
+{
+    return header->closed.load(memory_order_acquire) != 0;
+}
+
+// [Mazen Mohamed] Reads a change feed from its own position. Its lag is
+// bounded by the ring: events overwritten before they were read are skipped
+// and counted as missed.
+class ChangeSubscriber
+{
+private:
+    const ChangeFeed &feed;
+    uint64_t position;
+    uint64_t missed;
+
+public:
+    explicit ChangeSubscriber(const ChangeFeed &feed, bool fromOldest = false);
+
+    bool poll(ChangeEvent &event);
+    uint64_t getLag() const;
+    uint64_t getMissed() const;
+};
+
+// [Mazen Mohamed] Start at the next event, or at the oldest one still held
+ChangeSubscriber::ChangeSubscriber(const ChangeFeed &feed, bool fromOldest) : feed(feed), missed(0)
+{
+    uint64_t published = feed.getPublished();
+    position = published;
+    if (fromOldest)
+    {
+        position = published > feed.getCapacity() ? published - feed.getCapacity() : 0;
+    }
+}
+
+// [Mazen Mohamed] Next unread event; false once caught up with the writer
+bool ChangeSubscriber::poll(ChangeEvent &event)
+{
+    while (true)
+    {
+        uint64_t published = feed.getPublished();
+        if (position >= published)
+        {
+            return false;
+        }
+        if (published - position > feed.getCapacity())
+        {
+            missed += published - feed.getCapacity() - position;
+            position = published - feed.getCapacity();
+        }
+        if (feed.read(position++, event))
+        {
+            return true;
+        }
+        // Overwritten while it was copied
+        missed++;
+    }
+}
+
+// [Mazen Mohamed] Events published but not read yet
+uint64_t ChangeSubscriber::getLag() const
+{
+    uint64_t published = feed.getPublished();
+    return published > position ? published - position : 0;
+}
+
+// [Mazen Mohamed] Events lost because the reader fell a full ring behind
+uint64_t ChangeSubscriber::getMissed() const
+{
+    return missed;
+}
+
+// [Mazen Mohamed] Render an event as one line of text, e.g.
+// "12 1700000000 PATIENT_ADMITTED subject=4 related=0 detail=2 value=ICU"
+void appendChangeText(string &out, const ChangeEvent &event)
+{
+    char numbers[96];
+    snprintf(numbers, sizeof(numbers), "%llu %lld ", (unsigned long long)event.sequence, event.time);
+    out += numbers;
+    out.append(enumName(event.type));
+    snprintf(numbers, sizeof(numbers), " subject=%d related=%d detail=%d value=", event.subject, event.related,
+             event.detail);
+    out += numbers;
+    switch (event.type)
+    {
+    case CHANGE_DOCTOR_ADDED:
+        out.append(enumName((Department)event.value));
+        break;
+    case CHANGE_PATIENT_ADMITTED:
+    case CHANGE_PATIENT_WAITLISTED:
+    case CHANGE_PATIENT_DISCHARGED:
+    case CHANGE_BED_CAPACITY:
+        out.append(enumName((RoomType)event.value));
+        break;
+    case CHANGE_ADMISSION_POLICY:
+        out.append(enumName((AdmissionPolicy)event.value));
+        break;
+    case CHANGE_EMERGENCY_QUEUED:
+    case CHANGE_EMERGENCY_PRIORITY:
+        out.append(enumName((EmergencyPriority)event.value));
+        break;
+    case CHANGE_APPOINTMENT_BOOKED:
+    case CHANGE_APPOINTMENT_STATUS:
+        out.append(enumName((AppointmentStatus)event.value));
+        break;
+    default:
+        out += to_string(event.value);
+    }
+    out += '\n';
+}
+
+// ========== EMERGENCY TRIAGE QUEUE ========== //
+// [Mazen Mohamed] Indexed binary heap of emergency cases ordered by
+// (priority, arrival). A position index per patient lets a queued case be
+// reprioritized in O(log n) instead of rebuilding the queue. The index is a
+// hash map, so its size follows the queued cases and not the largest ID.
+class EmergencyTriageQueue
+{
+private:
+    struct Entry
+    {
+        int patientId;
+        EmergencyPriority priority;
+        long long sequence;
+    };
+
+    vector<Entry> heap;
+    unordered_map<int, int> positions; // patient ID -> index in heap while queued
+    long long nextSequence;
+
+    bool comesBefore(const Entry &a, const Entry &b) const;
+    void swapEntries(int i, int j);
+    void siftUp(int index);
+    void siftDown(int index);
+
+public:
+    EmergencyTriageQueue();
+
+    bool push(int patientId, EmergencyPriority priority);
+    int pop();
+    bool reprioritize(int patientId, EmergencyPriority priority);
+    bool contains(int patientId) const;
+    EmergencyPriority priorityOf(int patientId) const;
+    bool empty() const;
+    int size() const;
+    vector<int> orderedSnapshot() const;
+};
+
+// [Mazen Mohamed] Triage queue constructor implementation
+EmergencyTriageQueue::EmergencyTriageQueue()
+{
+    nextSequence = 0;
+}
+
+// [Mazen Mohamed] Lower enum value is more severe; ties go to the earlier arrival
+bool EmergencyTriageQueue::comesBefore(const Entry &a, const Entry &b) const
+{
+    if (a.priority != b.priority)
+    {
+        return EnumTraits<EmergencyPriority>::weight[a.priority] > EnumTraits<EmergencyPriority>::weight[b.priority];
+    }
+    return a.sequence < b.sequence;
+}
+
+// [Mazen Mohamed] Swap two heap entries and keep the position index in sync
+void EmergencyTriageQueue::swapEntries(int i, int j)
+{
+    swap(heap[i], heap[j]);
+    positions[heap[i].patientId] = i;
+    positions[heap[j].patientId] = j;
+}
+
+// [Mazen Mohamed] Move an entry towards the root while it outranks its parent
+void EmergencyTriageQueue::siftUp(int index)
+{
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if (!comesBefore(heap[index], heap[parent]))
+        {
+            break;
+        }
+        swapEntries(index, parent);
+        index = parent;
+    }
+}
+
+// [Mazen Mohamed] Move an entry towards the leaves while a child outranks it
+void EmergencyTriageQueue::siftDown(int index)
+{
+    int count = (int)heap.size();
+    while (true)
+    {
+        int best = index;
+        int left = 2 * index + 1;
+        int right = left + 1;
+        if (left < count && comesBefore(heap[left], heap[best]))
+        {
+            best = left;
+        }
+        if (right < count && comesBefore(heap[right], heap[best]))
+        {
+            best = right;
+        }
+        if (best == index)
+        {
+            break;
+        }
+        swapEntries(index, best);
+        index = best;
+    }
+}
+
+// [Mazen Mohamed] Queue a case; a patient can only be queued once
+bool EmergencyTriageQueue::push(int patientId, EmergencyPriority priority)
+{
+    if (patientId < 0 || contains(patientId))
+    {
+        return false;
+    }
+    heap.push_back({patientId, priority, nextSequence++});
+    positions[patientId] = (int)heap.size() - 1;
+    siftUp((int)heap.size() - 1);
+    return true;
+}
+
+// [Mazen Mohamed] Remove and return the most urgent case, -1 if empty
+int EmergencyTriageQueue::pop()
+{
+    if (heap.empty())
+    {
+        return -1;
+    }
+    int patientId = heap[0].patientId;
+    swapEntries(0, (int)heap.size() - 1);
+    heap.pop_back();
+    positions.erase(patientId);
+    if (!heap.empty())
+    {
+        siftDown(0);
+    }
+    return patientId;
+}
+
+// [Mazen Mohamed] Change the priority of a queued case, keeping its arrival order
+bool EmergencyTriageQueue::reprioritize(int patientId, EmergencyPriority priority)
+{
+    if (!contains(patientId))
+    {
+        return false;
+    }
+    int index = positions.at(patientId);
+    heap[index].priority = priority;
+    siftUp(index);
+    siftDown(positions.at(patientId));
+    return true;
+}
+
+// [Mazen Mohamed] Check whether a patient is waiting in the queue
+bool EmergencyTriageQueue::contains(int patientId) const
+{
+    return positions.count(patientId) != 0;
+}
+
+// [Mazen Mohamed] Priority of a queued case, STABLE if it is not queued
+EmergencyPriority EmergencyTriageQueue::priorityOf(int patientId) const
+{
+    if (!contains(patientId))
+    {
+        return STABLE;
+    }
+    return heap[positions.at(patientId)].priority;
+}
+
+// [Mazen Mohamed] Check whether the queue is empty
+bool EmergencyTriageQueue::empty() const
+{
+    return heap.empty();
+}
+
+// [Mazen Mohamed] Number of queued cases
+int EmergencyTriageQueue::size() const
+{
+    return (int)heap.size();
+}
+
+// [Mazen Mohamed] Patient IDs in treatment order, without touching the queue
+// Walks the heap best-first with a small frontier of heap indices.
+vector<int> EmergencyTriageQueue::orderedSnapshot() const
+{
+    vector<int> result;
+    result.reserve(heap.size());
+
+    auto later = [this](int a, int b)
+    { return comesBefore(heap[b], heap[a]); };
+    priority_queue<int, vector<int>, decltype(later)> frontier(later);
+    if (!heap.empty())
+    {
+        frontier.push(0);
+    }
+
+    while (!frontier.empty())
+    {
+        int index = frontier.top();
+        frontier.pop();
+        result.push_back(heap[index].patientId);
+
+        int left = 2 * index + 1;
+        if (left < (int)heap.size())
+        {
+            frontier.push(left);
+        }
+        if (left + 1 < (int)heap.size())
+        {
+            frontier.push(left + 1);
+        }
+    }
+    return result;
+}
+
+// ========== WORK-STEALING TASK POOL ========== //
+// [Mazen Mohamed] Fixed set of worker threads for bulk hospital operations
+// Every worker owns a deque of tasks: it pushes and pops at the back, and an
+// idle worker steals from the front of another's deque, so workers rarely
+// contend for the same lock. Tasks from outside the pool are spread over the
+// deques round-robin, and a thread waiting for its tasks runs queued tasks
+// meanwhile. In deterministic mode no thread is started and every task runs
+// on the calling thread in submission order, for reproducible tests.
+class TaskPool
+{
+private:
+    struct Worker
+    {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<Worker>> workers;
+    vector<thread> threads;
+    mutex sleepLock;
+    condition_variable wakeup;
+    atomic<size_t> queued; // Tasks in all deques
+    atomic<size_t> nextWorker;
+    bool stopping;
+    bool deterministic;
+
+    // Pool and worker index of the current thread, nullptr and -1 outside any pool
+    static thread_local const TaskPool *currentPool;
+    static thread_local int currentWorker;
+
+    int workerIndex() const;
+    void push(function<void()> task);
+    bool runOne();
+    void workerLoop(int index);
+
+public:
+    TaskPool(int threadCount, bool deterministicMode = false);
+    ~TaskPool();
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    int getThreadCount() const;
+    bool isDeterministic() const;
+
+    template <typename Body>
+    void parallelFor(size_t count, size_t grain, Body body);
+};
+
+thread_local const TaskPool *TaskPool::currentPool = nullptr;
+thread_local int TaskPool::currentWorker = -1;
+
+// [Mazen Mohamed] Start threadCount workers (none in deterministic mode)
+TaskPool::TaskPool(int threadCount, bool deterministicMode)
+    : queued(0), nextWorker(0), stopping(false), deterministic(deterministicMode)
+{
+    int count = deterministic ? 0 : max(threadCount, 1);
+    for (int i = 0; i < count; i++)
+    {
+        workers.push_back(make_unique<Worker>());
+    }
+    for (int i = 0; i < count; i++)
+    {
+        threads.emplace_back(&TaskPool::workerLoop, this, i);
+    }
+}
+
+// [Mazen Mohamed] Stop the workers once they are idle
+TaskPool::~TaskPool()
+{
+    {
+        lock_guard<mutex> guard(sleepLock);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (thread &worker : threads)
+    {
+        worker.join();
+    }
+}
+
+// [Mazen Mohamed] Number of worker threads, 0 in deterministic mode
+int TaskPool::getThreadCount() const
+{
+    return (int)threads.size();
+}
+
+// [Mazen Mohamed] Whether tasks run serially on the calling thread
+bool TaskPool::isDeterministic() const
+{
+    return deterministic;
+}
+
+// [Mazen Mohamed] Index of the calling thread among this pool's workers, -1
+// when it is not one of them
+int TaskPool::workerIndex() const
+{
+    return currentPool == this ? currentWorker : -1;
+}
+
+// [Mazen Mohamed] Queue a task on the current worker's deque, or round-robin
+// from outside the pool, and wake a sleeping worker. The task is counted
+// before it is visible, so the count never drops below the tasks queued.
+void TaskPool::push(function<void()> task)
+{
+    int self = workerIndex();
+    int target = self >= 0 ? self : (int)(nextWorker++ % workers.size());
+    {
+        lock_guard<mutex> guard(sleepLock);
+        queued++;
+    }
+    {
+        lock_guard<mutex> guard(workers[target]->lock);
+        workers[target]->tasks.push_back(move(task));
+    }
+    wakeup.notify_one();
+}
+
+// [Mazen Mohamed] Run one queued task: the newest of our own deque, else the
+// oldest of another's. Returns false when every deque was empty.
+bool TaskPool::runOne()
+{
+    int count = (int)workers.size();
+    int self = workerIndex();
+    for (int offset = 0; offset < count; offset++)
+    {
+        int victim = (max(self, 0) + offset) % count;
+        Worker &worker = *workers[victim];
+        function<void()> task;
+        {
+            lock_guard<mutex> guard(worker.lock);
+            if (worker.tasks.empty())
+            {
+                continue;
+            }
+            if (victim == self)
+            {
+                task = move(worker.tasks.back());
+                worker.tasks.pop_back();
+            }
+            else
+            {
+                task = move(worker.tasks.front());
+                worker.tasks.pop_front();
+            }
+        }
+        queued--;
+        task();
+        return true;
+    }
+    return false;
+}
+
+// [Mazen Mohamed] Body of a worker thread: run tasks until stopped, sleeping
+// while there are none
+void TaskPool::workerLoop(int index)
+{
+    currentPool = this;
+    currentWorker = index;
+    while (true)
+    {
+        if (runOne())
+        {
+            continue;
+        }
+        unique_lock<mutex> guard(sleepLock);
+        wakeup.wait(guard, [this]()
+                    { return stopping || queued > 0; });
+        if (stopping && queued == 0)
+        {
+            return;
+        }
+    }
+}
+
+// [Mazen Mohamed] Call body(begin, end) over [0, count) in chunks of grain
+// items and wait for all of them. Chunk boundaries depend only on count and
+// grain, so per-chunk results merged in chunk order come out the same for
+// any number of threads. If a chunk throws, the other chunks still run and
+// the first exception is rethrown here once all of them are done.
+template <typename Body>
+void TaskPool::parallelFor(size_t count, size_t grain, Body body)
+{
+    grain = max(grain, (size_t)1);
+    size_t chunks = (count + grain - 1) / grain;
+    if (deterministic || chunks <= 1)
+    {
+        for (size_t begin = 0; begin < count; begin += grain)
+        {
+            body(begin, min(begin + grain, count));
+        }
+        return;
+    }
+    // Chunks of this call still running, and the first exception one threw
+    struct Completion
+    {
+        mutex lock;
+        condition_variable finished;
+        size_t remaining;
+        exception_ptr error;
+    };
+    Completion completion;
+    completion.remaining = chunks;
+    for (size_t begin = 0; begin < count; begin += grain)
+    {
+        size_t end = min(begin + grain, count);
+        push([&body, &completion, begin, end]()
+             {
+            exception_ptr error;
+            try
+            {
+                body(begin, end);
+            }
+            catch (...)
+            {
+                error = current_exception();
+            }
+            lock_guard<mutex> guard(completion.lock);
+            if (error && !completion.error)
+            {
+                completion.error = error;
+            }
+            if (--completion.remaining == 0)
+            {
+                completion.finished.notify_all();
+            }
+        });
+    }
+
+    // Help with queued tasks; once none are left, the rest of our chunks are
+    // running on workers, so sleep until the last one finishes
+    while (runOne())
+    {
+        lock_guard<mutex> guard(completion.lock);
+        if (completion.remaining == 0)
+        {
+            break;
+        }
+    }
+    unique_lock<mutex> guard(completion.lock);
+    completion.finished.wait(guard, [&completion]()
+                             { return completion.remaining == 0; });
+    if (completion.error)
+    {
+        rethrow_exception(completion.error);
+    }
+}
+
+// ========== LATENCY METRICS ========== //
+// [Mazen Mohamed] Hospital operations whose latency is measured
+enum TimedOperation
+{
+    TIMED_ADMIT_PATIENT,
+    TIMED_BOOK_APPOINTMENT,
+    TIMED_SCHEDULE_APPOINTMENT,
+    TIMED_HANDLE_EMERGENCY
+};
+
+template <>
+struct EnumTraits<TimedOperation>
+{
+    static constexpr size_t count = TIMED_HANDLE_EMERGENCY + 1;
+    static constexpr string_view names[count] = {"admit_patient", "book_appointment", "schedule_appointment",
+                                                 "handle_emergency"};
+    static constexpr string_view labels[count] = {"admitPatient", "bookAppointment", "scheduleAppointment",
+                                                  "handleEmergency"};
+};
+
+// [Mazen Mohamed] HDR-style histogram of latencies in nanoseconds. Values
+// below 8 have a bucket each; above that every power of two is split into 8
+// buckets, so the values sharing a bucket are within 12.5% of each other.
+// The 328 buckets reach past an hour; anything longer lands in the last one.
+struct LatencyHistogram
+{
+    static constexpr int BUCKETS = 328;
+
+    uint64_t counts[BUCKETS] = {};
+    uint64_t calls = 0;      // Calls made, timed or not
+    uint64_t samples = 0;    // Calls timed
+    uint64_t totalNanos = 0; // Sum of the timed latencies
+    uint64_t maxNanos = 0;
+
+    static int bucketOf(uint64_t nanos);
+    static uint64_t bucketHigh(int bucket);
+    uint64_t quantile(double fraction) const;
+};
+
+// [Mazen Mohamed] Bucket a latency is counted in
+int LatencyHistogram::bucketOf(uint64_t nanos)
+{
+    if (nanos < 8)
+    {
+        return (int)nanos;
+    }
+    int exponent = 3;
+    while (exponent < 42 && (nanos >> (exponent + 1)) != 0)
+    {
+        exponent++;
+    }
+    if ((nanos >> (exponent + 1)) != 0)
+    {
+        return BUCKETS - 1;
+    }
+    return (exponent - 2) * 8 + (int)((nanos >> (exponent - 3)) & 7);
+}
+
+// [Mazen Mohamed] Largest latency counted in a bucket
+uint64_t LatencyHistogram::bucketHigh(int bucket)
+{
+    if (bucket < 8)
+    {
+        return (uint64_t)bucket;
+    }
+    int shift = bucket / 8 - 1;
+    return ((uint64_t)(8 + bucket % 8) << shift) + ((uint64_t)1 << shift) - 1;
+}
+
+// [Mazen Mohamed] Latency that fraction (0..1) of the timed calls stayed
+// within, to bucket precision; 0 before any call was timed
+uint64_t LatencyHistogram::quantile(double fraction) const
+{
+    if (samples == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = max<uint64_t>(1, (uint64_t)ceil(fraction * (double)samples));
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < BUCKETS; bucket++)
+    {
+        seen += counts[bucket];
+        if (seen >= rank)
+        {
+            return min(bucketHigh(bucket), maxNanos);
+        }
+    }
+    return maxNanos;
+}
+
+// [Mazen Mohamed] Process-wide latency counters of the timed operations.
+// Every thread counts into its own block, written only by that thread, so
+// recording takes no lock and no atomic read-modify-write; reading sums the
+// blocks of the live threads and the totals of the threads that exited.
+// Reading the clock can cost as much as a fast operation, so only every
+// samplePeriod-th call of an operation on a thread is timed (0 times none);
+// every call is counted.
+class LatencyMetrics
+{
+public:
+    static constexpr size_t OPERATIONS = EnumTraits<TimedOperation>::count;
+
+    struct ThreadCounters
+    {
+        atomic<uint64_t> calls[OPERATIONS];
+        atomic<uint64_t> totalNanos[OPERATIONS];
+        atomic<uint64_t> maxNanos[OPERATIONS];
+        atomic<uint64_t> counts[OPERATIONS][LatencyHistogram::BUCKETS];
+        // Calls left until the next timed one; only the owning thread uses it
+        uint32_t untilSample[OPERATIONS];
+    };
+
+private:
+    mutable mutex lock;
+    vector<ThreadCounters *> live;
+    LatencyHistogram retired[OPERATIONS];
+
+    // Kept outside the shared instance so the recording path reaches them
+    // without a guard check
+    static atomic<uint32_t> samplePeriod;
+    static thread_local ThreadCounters *threadCounters;
+
+    static ThreadCounters &enroll();
+    void retire(ThreadCounters *counters);
+
+public:
+    static LatencyMetrics &shared();
+    static ThreadCounters &local();
+
+    static void setSamplePeriod(uint32_t period);
+    static uint32_t getSamplePeriod();
+    LatencyHistogram histogram(TimedOperation operation) const;
+};
+
+atomic<uint32_t> LatencyMetrics::samplePeriod(128);
+thread_local LatencyMetrics::ThreadCounters *LatencyMetrics::threadCounters = nullptr;
+
+// [Mazen Mohamed] The counters every hospital in the process records into
+LatencyMetrics &LatencyMetrics::shared()
+{
+    static LatencyMetrics metrics;
+    return metrics;
+}
+
+// [Mazen Mohamed] This thread's counters
+inline LatencyMetrics::ThreadCounters &LatencyMetrics::local()
+{
+    if (threadCounters == nullptr)
+    {
+        return enroll();
+    }
+    return *threadCounters;
+}
+
+// [Mazen Mohamed] Add a zeroed block for the calling thread, folded into the
+// totals when the thread exits
+LatencyMetrics::ThreadCounters &LatencyMetrics::enroll()
+{
+    struct Registration
+    {
+        ~Registration()
+        {
+            shared().retire(threadCounters);
+            threadCounters = nullptr;
+        }
+    };
+    LatencyMetrics &metrics = shared();
+    threadCounters = new ThreadCounters();
+    {
+        lock_guard<mutex> guard(metrics.lock);
+        metrics.live.push_back(threadCounters);
+    }
+    static thread_local Registration registration;
+    (void)registration;
+    return *threadCounters;
+}
+
+// [Mazen Mohamed] Fold the block of an exiting thread into the totals
+void LatencyMetrics::retire(ThreadCounters *counters)
+{
+    lock_guard<mutex> guard(lock);
+    for (size_t operation = 0; operation < OPERATIONS; operation++)
+    {
+        LatencyHistogram &total = retired[operation];
+        total.calls += counters->calls[operation].load(memory_order_relaxed);
+        total.totalNanos += counters->totalNanos[operation].load(memory_order_relaxed);
+        total.maxNanos = max(total.maxNanos, counters->maxNanos[operation].load(memory_order_relaxed));
+        for (int bucket = 0; bucket < LatencyHistogram::BUCKETS; bucket++)
+        {
+            uint64_t count = counters->counts[operation][bucket].load(memory_order_relaxed);
+            total.counts[bucket] += count;
+            total.samples += count;
+        }
+    }
+    live.erase(find(live.begin(), live.end(), counters));
+    delete counters;
+}
+
+// [Mazen Mohamed] Time every period-th call of each operation; 0 only counts calls
+void LatencyMetrics::setSamplePeriod(uint32_t period)
+{
+    samplePeriod.store(period, memory_order_relaxed);
+}
+
+// [Mazen Mohamed] Current sample period
+uint32_t LatencyMetrics::getSamplePeriod()
+{
+    return samplePeriod.load(memory_order_relaxed);
+}
+
+// [Mazen Mohamed] Sum of one operation's counters over all threads
+LatencyHistogram LatencyMetrics::histogram(TimedOperation operation) const
+{
+    lock_guard<mutex> guard(lock);
+    LatencyHistogram result = retired[operation];
+    for (const ThreadCounters *counters : live)
+    {
+        result.calls += counters->calls[operation].load(memory_order_relaxed);
+        result.totalNanos += counters->totalNanos[operation].load(memory_order_relaxed);
+        result.maxNanos = max(result.maxNanos, counters->maxNanos[operation].load(memory_order_relaxed));
+        for (int bucket = 0; bucket < LatencyHistogram::BUCKETS; bucket++)
+        {
+            uint64_t count = counters->counts[operation][bucket].load(memory_order_relaxed);
+            result.counts[bucket] += count;
+            result.samples += count;
+        }
+    }
+    return result;
+}
+
+// [Mazen Mohamed] Counts one call of an operation and times it when it is due
+// for a sample; declared at the top of the operation. Builds with
+// -DHMS_NO_LATENCY_METRICS compile it out, leaving the operations without any
+// instrumentation; --bench measures the metrics against such a build.
+#ifdef HMS_NO_LATENCY_METRICS
+static const bool LATENCY_METRICS_COMPILED = false;
+
+class LatencyTimer
+{
+public:
+    explicit LatencyTimer(TimedOperation operation);
+    ~LatencyTimer();
+    LatencyTimer(const LatencyTimer &) = delete;
+    LatencyTimer &operator=(const LatencyTimer &) = delete;
+};
+
+// [Mazen Mohamed] Nothing to count or time
+inline LatencyTimer::LatencyTimer(TimedOperation)
+{
+}
+
+inline LatencyTimer::~LatencyTimer()
+{
+}
+#else
+static const bool LATENCY_METRICS_COMPILED = true;
+
+class LatencyTimer
+{
+private:
+    LatencyMetrics::ThreadCounters &counters;
+    TimedOperation operation;
+    bool timed;
+    chrono::steady_clock::time_point start;
+
+public:
+    explicit LatencyTimer(TimedOperation operation);
+    ~LatencyTimer();
+    LatencyTimer(const LatencyTimer &) = delete;
+    LatencyTimer &operator=(const LatencyTimer &) = delete;
+};
+
+// [Mazen Mohamed] Count the call and start the clock if it is sampled.
+// Inlined into the timed operations, like the destructor.
+inline LatencyTimer::LatencyTimer(TimedOperation operation)
+    : counters(LatencyMetrics::local()), operation(operation), timed(false)
+{
+    atomic<uint64_t> &calls = counters.calls[operation];
+    calls.store(calls.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    if (counters.untilSample[operation] > 0)
+    {
+        counters.untilSample[operation]--;
+        return;
+    }
+    uint32_t period = LatencyMetrics::getSamplePeriod();
+    if (period == 0)
+    {
+        return;
+    }
+    counters.untilSample[operation] = period - 1;
+    timed = true;
+    start = chrono::steady_clock::now();
+}
+
+// [Mazen Mohamed] Record the latency of a sampled call
+inline LatencyTimer::~LatencyTimer()
+{
+    if (!timed)
+    {
+        return;
+    }
+    uint64_t nanos = (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    atomic<uint64_t> &bucket = counters.counts[operation][LatencyHistogram::bucketOf(nanos)];
+    bucket.store(bucket.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic<uint64_t> &total = counters.totalNanos[operation];
+    total.store(total.load(memory_order_relaxed) + nanos, memory_order_relaxed);
+    if (nanos > counters.maxNanos[operation].load(memory_order_relaxed))
+    {
+        counters.maxNanos[operation].store(nanos, memory_order_relaxed);
+    }
+}
+#endif
+
+// [Mazen Mohamed] One metric of the metrics dump: its name, help text,
+// Prometheus type and samples. A sample may add a suffix to the name (e.g.
+// "_sum") and carries Prometheus labels such as room_type="ICU", or none.
+struct MetricSample
+{
+    string suffix;
+    string labels;
+    double value;
+};
+
+struct MetricFamily
+{
+    string name;
+    string help;
+    string type;
+    vector<MetricSample> samples;
+};
+
+// [Mazen Mohamed] Add the call counts and latency summaries of the timed
+// operations, in seconds as Prometheus expects
+void collectLatencyMetrics(vector<MetricFamily> &families)
+{
+    static const double QUANTILES[] = {0.5, 0.9, 0.99, 0.999};
+    MetricFamily calls{"hms_operation_calls_total", "Calls of each timed operation", "counter", {}};
+    MetricFamily latency{"hms_operation_latency_seconds", "Latency of the sampled calls of each timed operation",
+                         "summary", {}};
+    for (size_t operation = 0; operation < LatencyMetrics::OPERATIONS; operation++)
+    {
+        LatencyHistogram histogram = LatencyMetrics::shared().histogram((TimedOperation)operation);
+        string label = "operation=\"" + string(enumName((TimedOperation)operation)) + "\"";
+        calls.samples.push_back({"", label, (double)histogram.calls});
+        for (double quantile : QUANTILES)
+        {
+            char text[32];
+            snprintf(text, sizeof(text), ",quantile=\"%g\"", quantile);
+            latency.samples.push_back({"", label + text, (double)histogram.quantile(quantile) / 1e9});
+        }
+        latency.samples.push_back({"_sum", label, (double)histogram.totalNanos / 1e9});
+        latency.samples.push_back({"_count", label, (double)histogram.samples});
+    }
+    families.push_back(move(calls));
+    families.push_back(move(latency));
+}
+
+// [Mazen Mohamed] Write metrics in the Prometheus text exposition format
+void writePrometheusMetrics(ostream &out, const vector<MetricFamily> &families)
+{
+    string text;
+    char value[32];
+    for (const MetricFamily &family : families)
+    {
+        text += "# HELP " + family.name + " " + family.help + "\n";
+        text += "# TYPE " + family.name + " " + family.type + "\n";
+        for (const MetricSample &sample : family.samples)
+        {
+            text += family.name + sample.suffix;
+            if (!sample.labels.empty())
+            {
+                text += "{" + sample.labels + "}";
+            }
+            snprintf(value, sizeof(value), " %.9g\n", sample.value);
+            text += value;
+        }
+    }
+    out.write(text.data(), (streamsize)text.size());
+}
+
+// ========== HOSPITAL CLASS ========== //
+// [Mazen Mohamed] Hospital class definition and implementation
+class Hospital
+{
+protected:
+    // Pool the patient records, doctors and name index allocate from, so a
+    // registration takes memory from larger blocks instead of the heap.
+    // Declared first so it outlives everything allocated from it.
+    pmr::unsynchronized_pool_resource arena;
+
+    PatientStore patients;
+    vector<Doctor> doctors;
+    EmergencyTriageQueue emergencyQueue;
+    int patientCounter;
+    int doctorCounter;
+
+    // ID -> position in patients/doctors, -1 once the record is removed.
+    // IDs come from the counters, so a dense vector indexed by ID is enough.
+    vector<int> patientSlots;
+    vector<int> doctorSlots;
+
+    // Secondary indexes: doctor IDs by department, admitted patient IDs by room type
+    EnumIndex<DEPARTMENT_COUNT> doctorsByDepartment;
+    EnumIndex<ROOM_TYPE_COUNT> admittedByRoomType;
+    // Doctors of each department by load, for assigning appointments
+    DoctorLoadIndex doctorLoad;
+
+    // Typo-tolerant lookup of patients by name
+    NameSearchIndex nameIndex;
+
+    // Beds per room type and what happens when a type is full
+    BedInventory beds;
+    AdmissionPolicy admissionPolicy;
+
+    // Runs requested tests of all patients; results are written back by collectTestResults
+    LabScheduler lab;
+
+    // Threads for bulk operations (census, snapshot encoding, bulk scheduling);
+    // nullptr runs them serially on the calling thread. arena is not
+    // synchronized, so tasks on these threads only read the records and
+    // write to memory of their own (counters, strings on the default heap);
+    // anything that allocates from arena stays on the calling thread.
+    unique_ptr<TaskPool> workers;
+
+    // Where mutations are recorded; nullptr while logging is off (e.g. during replay)
+    WriteAheadLog *wal;
+    // Where changes are published for other systems; changes is nullptr while
+    // the feed is off or a nested call must not publish twice
+    unique_ptr<ChangeFeed> changeFeed;
+    ChangeFeed *changes;
+
+    Patient findPatient(int patientId);
+    Doctor *findDoctor(int doctorId);
+    void logMutation(WalRecordType type, const string &payload);
+    void publishChange(ChangeType type, int subject, int related = 0, int detail = 0, int value = 0);
+    void releaseBed(RoomType type, int bed);
+    bool admitFromWaitlist(RoomType type);
+    bool recordTestPerformed(int patientId, string_view testName);
+
+    // Priority a new emergency case is queued with; FIFO when all are equal
+    virtual EmergencyPriority emergencyPriorityFor(int patientId) const;
+    // Rebuild derived indexes from the records, e.g. after a snapshot load
+    virtual void rebuildIndexes();
+
+    friend class SnapshotCodec;
+
+public:
+    Hospital();
+    virtual ~Hospital() = default;
+
+    int registerPatient(string_view name, int age, string_view contact);
+    int addDoctor(string_view name, Department dept);
+    void reserve(size_t patientCount, size_t doctorCount = 0);
+    bool removePatient(int patientId);
+    virtual bool removeDoctor(int doctorId);
+    bool admitPatient(int patientId, RoomType type);
+    bool dischargePatient(int patientId);
+    bool addMedicalRecord(int patientId, string_view record);
+    bool addEmergency(int patientId);
+    int handleEmergency();
+    bool bookAppointment(int doctorId, int patientId);
+    int seePatient(int doctorId);
+    int assignDoctor(Department dept) const;
+    void displayPatientInfo(int patientId, ReportFormat format = REPORT_TEXT);
+    void displayDoctorInfo(int doctorId);
+    void displayAllPatients(ReportFormat format = REPORT_TEXT);
+    void displayAllDoctors(ReportFormat format = REPORT_TEXT);
+    const vector<int> &getDoctorsInDepartment(Department dept) const;
+    const vector<int> &getAdmittedPatients(RoomType type) const;
+    void displayDoctorsInDepartment(Department dept);
+    void displayAdmittedPatients(RoomType type);
+    bool setBedCapacity(RoomType type, int capacity);
+    void setAdmissionPolicy(AdmissionPolicy policy);
+    bool isWaitingForBed(int patientId) const;
+    void displayBedOccupancy();
+    void countAdmittedPatients(size_t counts[ROOM_TYPE_COUNT]) const;
+    vector<NameMatch> searchPatients(const string &query, int limit = 10) const;
+    void displayPatientSearch(const string &query, int limit = 10);
+    bool requestTest(int patientId, string_view testName);
+    int sendTestsToLab();
+    int sendTestsToLab(int patientId);
+    int collectTestResults(bool wait);
+    void setLabLanes(int lanes);
+    void setTestRunTime(string_view testName, int milliseconds);
+    void displayLabStatus();
+    void setWorkerThreads(int threads, bool deterministic = false);
+    bool openChangeFeed(size_t capacity, const string &tapPath = string());
+    const ChangeFeed *getChangeFeed() const;
+    virtual void collectMetrics(vector<MetricFamily> &families);
+    void displayMetrics();
+    bool writeMetricsFile(const string &path);
+
+    int getPatientCount() const;
+    int getDoctorCount() const;
+};
+
+// [Mazen Mohamed] Hospital constructor implementation
+// Pooled blocks go up to the size of a doctor's appointment ring (16 bytes per cell).
+Hospital::Hospital()
+    : arena(pmr::pool_options{0, Doctor::APPOINTMENT_QUEUE_CAPACITY * 16}), patients(&arena), nameIndex(&arena)
+{
+    patientCounter = 1;
+    doctorCounter = 1;
+
+    // IDs start at 1, so slot 0 is never used
+    patientSlots.push_back(-1);
+    doctorSlots.push_back(-1);
+    admissionPolicy = ADMIT_FAIL_FAST;
+    wal = nullptr;
+    changes = nullptr;
+}
+
+// [Mazen Mohamed] Record a mutation in the write-ahead log, if one is attached
+void Hospital::logMutation(WalRecordType type, const string &payload)
+{
+    if (wal != nullptr)
+    {
+        wal->append(type, payload);
+    }
+}
+
+// [Mazen Mohamed] Publish a change on the change feed, if one is open
+void Hospital::publishChange(ChangeType type, int subject, int related, int detail, int value)
+{
+    if (changes != nullptr)
+    {
+        changes->publish(type, subject, related, detail, value);
+    }
+}
+
+// [Mazen Mohamed] Publish every later change on a feed holding the last
+// capacity events, shared through the file tapPath when one is given
+bool Hospital::openChangeFeed(size_t capacity, const string &tapPath)
+{
+    changes = nullptr;
+    changeFeed = make_unique<ChangeFeed>();
+    if (!changeFeed->create(capacity, tapPath))
+    {
+        cout << "Could not create change feed tap " << tapPath << "." << endl;
+        changeFeed.reset();
+        return false;
+    }
+    changes = changeFeed.get();
+    return true;
+}
+
+// [Mazen Mohamed] The open change feed, or nullptr
+const ChangeFeed *Hospital::getChangeFeed() const
+{
+    return changeFeed.get();
+}
+
+// [Mazen Mohamed] Look up a patient by ID in constant time; the view tests
+// false when there is no such patient
+Patient Hospital::findPatient(int patientId)
+{
+    if (patientId <= 0 || patientId >= (int)patientSlots.size() || patientSlots[patientId] == -1)
+    {
+        return Patient();
+    }
+    return patients.at(patientSlots[patientId]);
+}
+
+// [Mazen Mohamed] Look up a doctor by ID in constant time
+Doctor *Hospital::findDoctor(int doctorId)
+{
+    if (doctorId <= 0 || doctorId >= (int)doctorSlots.size() || doctorSlots[doctorId] == -1)
+    {
+        return nullptr;
+    }
+    return &doctors[doctorSlots[doctorId]];
+}
+
+// [Mazen Mohamed] Register a new patient
+// Name and contact are copied once, straight into the hospital's pool.
+int Hospital::registerPatient(string_view name, int age, string_view contact)
+{
+    patientSlots.push_back((int)patients.size());
+    nameIndex.add(patientCounter, name);
+    patients.add(patientCounter, name, age, contact);
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putString(payload, name);
+        putI32(payload, age);
+        putString(payload, contact);
+        logMutation(WAL_REGISTER_PATIENT, payload);
+    }
+    publishChange(CHANGE_PATIENT_REGISTERED, patientCounter, 0, age);
+    return patientCounter++;
+}
+
+// [Mazen Mohamed] Add a new doctor
+int Hospital::addDoctor(string_view name, Department dept)
+{
+    doctorSlots.push_back((int)doctors.size());
+    doctors.emplace_back(doctorCounter, name, dept, &arena);
+    doctorsByDepartment.insert(doctorCounter, dept);
+    doctorLoad.insert(doctorCounter, dept);
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putString(payload, name);
+        putU8(payload, (uint8_t)dept);
+        logMutation(WAL_ADD_DOCTOR, payload);
+    }
+    publishChange(CHANGE_DOCTOR_ADDED, doctorCounter, 0, 0, dept);
+    return doctorCounter++;
+}
+
+// [Mazen Mohamed] Make room for patientCount patients and doctorCount doctors
+// in total, so a bulk load does not regrow the stores while it registers
+void Hospital::reserve(size_t patientCount, size_t doctorCount)
+{
+    if (patientCount > patients.size())
+    {
+        patientSlots.reserve(patientSlots.size() + patientCount - patients.size());
+        patients.reserve(patientCount);
+        nameIndex.reserve(patientSlots.capacity());
+    }
+    if (doctorCount > doctors.size())
+    {
+        doctorSlots.reserve(doctorSlots.size() + doctorCount - doctors.size());
+        doctors.reserve(doctorCount);
+    }
+}
+
+// [Mazen Mohamed] Remove a patient record
+// The last record is moved into the freed position so no other slot shifts.
+bool Hospital::removePatient(int patientId)
+{
+    Patient patient = findPatient(patientId);
+    if (!patient)
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return false;
+    }
+    bool hadBed = patient.getAdmissionStatus();
+    RoomType roomType = patient.getRoomTypeValue();
+    int bed = patient.getBed();
+    beds.removeWaiting(patientId);
+
+    int slot = patientSlots[patientId];
+    int moved = patients.remove(slot);
+    if (moved != -1)
+    {
+        patientSlots[moved] = slot;
+    }
+    patientSlots[patientId] = -1;
+    admittedByRoomType.erase(patientId);
+    nameIndex.remove(patientId);
+    if (hadBed)
+    {
+        releaseBed(roomType, bed);
+    }
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, patientId);
+        logMutation(WAL_REMOVE_PATIENT, payload);
+    }
+    publishChange(CHANGE_PATIENT_REMOVED, patientId);
+    return true;
+}
+
+// [Mazen Mohamed] Remove a doctor record
+bool Hospital::removeDoctor(int doctorId)
+{
+    if (findDoctor(doctorId) == nullptr)
+    {
+        cout << "Doctor with ID " << doctorId << " not found." << endl;
+        return false;
+    }
+    int slot = doctorSlots[doctorId];
+    if (slot != (int)doctors.size() - 1)
+    {
+        doctors[slot] = move(doctors.back());
+        doctorSlots[doctors[slot].getId()] = slot;
+    }
+    doctors.pop_back();
+    doctorSlots[doctorId] = -1;
+    doctorsByDepartment.erase(doctorId);
+    doctorLoad.erase(doctorId);
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, doctorId);
+        logMutation(WAL_REMOVE_DOCTOR, payload);
+    }
+    publishChange(CHANGE_DOCTOR_REMOVED, doctorId);
+    return true;
+}
+
+// [Mazen Mohamed] Admit a patient
+bool Hospital::admitPatient(int patientId, RoomType type)
+{
+    LatencyTimer timer(TIMED_ADMIT_PATIENT);
+    Patient patient = findPatient(patientId);
+    if (!patient)
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return false;
+    }
+    if (beds.isWaiting(patientId))
+    {
+        cout << "Patient with ID " << patientId << " is already waiting for a bed." << endl;
+        return false;
+    }
+
+    bool transfer = patient.getAdmissionStatus() && patient.getRoomTypeValue() != type;
+    if (!patient.getAdmissionStatus() || transfer)
+    {
+        int bed = beds.allocate(type, patientId);
+        if (bed == -1 && (transfer || admissionPolicy == ADMIT_FAIL_FAST))
+        {
+            cout << "No free " << Patient::roomTypeName(type) << " bed for patient " << patientId << "." << endl;
+            return false;
+        }
+        if (bed == -1)
+        {
+            int place = beds.enqueue(type, patientId);
+            cout << "No free " << Patient::roomTypeName(type) << " bed; patient " << patientId
+                 << " is number " << place << " on the waitlist." << endl;
+            if (wal != nullptr)
+            {
+                string payload;
+                putI32(payload, patientId);
+                putU8(payload, (uint8_t)type);
+                logMutation(WAL_WAITLIST_PATIENT, payload);
+            }
+            publishChange(CHANGE_PATIENT_WAITLISTED, patientId, 0, place, type);
+            return false;
+        }
+        if (transfer)
+        {
+            releaseBed(patient.getRoomTypeValue(), patient.getBed());
+        }
+        patient.setBed(bed);
+    }
+    patient.admitPatient(type);
+    admittedByRoomType.insert(patientId, type);
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, patientId);
+        putU8(payload, (uint8_t)type);
+        logMutation(WAL_ADMIT_PATIENT, payload);
+    }
+    publishChange(CHANGE_PATIENT_ADMITTED, patientId, 0, patient.getBed(), type);
+    return true;
+}
+
+// [Mazen Mohamed] Free a bed and hand it to the first patient waiting for its room type
+void Hospital::releaseBed(RoomType type, int bed)
+{
+    beds.release(type, bed);
+    admitFromWaitlist(type);
+}
+
+// [Mazen Mohamed] Admit the first waiting patient of a room type if a bed is free
+bool Hospital::admitFromWaitlist(RoomType type)
+{
+    int first;
+    while ((first = beds.firstWaiting(type)) != -1)
+    {
+        int bed = beds.allocate(type, first);
+        if (bed == -1)
+        {
+            return false;
+        }
+        int patientId = beds.nextWaiting(type);
+        Patient patient = findPatient(patientId);
+        if (!patient)
+        {
+            beds.release(type, bed);
+            continue;
+        }
+        patient.setBed(bed);
+        patient.admitPatient(type);
+        admittedByRoomType.insert(patientId, type);
+        cout << "Patient with ID " << patientId << " admitted from the waitlist to "
+             << Patient::roomTypeName(type) << " bed " << bed << "." << endl;
+        publishChange(CHANGE_PATIENT_ADMITTED, patientId, 0, bed, type);
+        return true;
+    }
+    return false;
+}
+
+// [Mazen Mohamed] Set the number of beds of a room type (BedInventory::UNLIMITED
+// to lift the limit); new beds go to waiting patients first
+bool Hospital::setBedCapacity(RoomType type, int capacity)
+{
+    if (!beds.setCapacity(type, capacity))
+    {
+        cout << "Cannot set " << Patient::roomTypeName(type) << " capacity to " << capacity
+             << " while " << beds.getOccupied(type) << " beds are occupied." << endl;
+        return false;
+    }
+    while (admitFromWaitlist(type))
+    {
+    }
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putU8(payload, (uint8_t)type);
+        putI32(payload, capacity);
+        logMutation(WAL_SET_BED_CAPACITY, payload);
+    }
+    publishChange(CHANGE_BED_CAPACITY, 0, 0, capacity, type);
+    return true;
+}
+
+// [Mazen Mohamed] Choose between rejecting and queueing admissions to a full room type
+void Hospital::setAdmissionPolicy(AdmissionPolicy policy)
+{
+    admissionPolicy = policy;
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putU8(payload, (uint8_t)policy);
+        logMutation(WAL_SET_ADMISSION_POLICY, payload);
+    }
+    publishChange(CHANGE_ADMISSION_POLICY, 0, 0, 0, policy);
+}
+
+// [Mazen Mohamed] Whether a patient is on a bed waitlist
+bool Hospital::isWaitingForBed(int patientId) const
+{
+    return beds.isWaiting(patientId);
+}
+
+// [Mazen Mohamed] Patients whose names best match a possibly misspelled query
+vector<NameMatch> Hospital::searchPatients(const string &query, int limit) const
+{
+    return nameIndex.search(query, (size_t)max(limit, 0));
+}
+
+// [Mazen Mohamed] Display the best name matches for a query
+void Hospital::displayPatientSearch(const string &query, int limit)
+{
+    vector<NameMatch> matches = searchPatients(query, limit);
+    cout << "===== PATIENTS MATCHING \"" << query << "\" =====" << endl;
+    for (const NameMatch &match : matches)
+    {
+        Patient patient = findPatient(match.patientId);
+        cout << "ID: " << match.patientId << " | Name: " << patient.getName() << " | Contact: " << patient.getContact()
+             << " | Status: " << (patient.getAdmissionStatus() ? "Admitted" : "Not Admitted") << endl;
+    }
+    if (matches.empty())
+    {
+        cout << "No matching patients." << endl;
+    }
+    cout << "========================" << endl;
+}
+
+// [Mazen Mohamed] Display occupied and free beds per room type
+void Hospital::displayBedOccupancy()
+{
+    cout << "===== BED OCCUPANCY =====" << endl;
+    for (size_t type = 0; type < ROOM_TYPE_COUNT; type++)
+    {
+        RoomType roomType = (RoomType)type;
+        cout << Patient::roomTypeName(roomType) << ": " << beds.getOccupied(roomType) << " occupied";
+        if (beds.getCapacity(roomType) == BedInventory::UNLIMITED)
+        {
+            cout << ", no limit";
+        }
+        else
+        {
+            cout << " of " << beds.getCapacity(roomType);
+        }
+        cout << ", " << beds.getWaitingCount(roomType) << " waiting" << endl;
+    }
+    cout << "=========================" << endl;
+}
+
+// [Mazen Mohamed] Discharge an admitted patient
+bool Hospital::dischargePatient(int patientId)
+{
+    Patient patient = findPatient(patientId);
+    if (!patient)
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return false;
+    }
+    if (!patient.getAdmissionStatus())
+    {
+        cout << "Patient with ID " << patientId << " is not admitted." << endl;
+        return false;
+    }
+    RoomType roomType = patient.getRoomTypeValue();
+    int bed = patient.getBed();
+    patient.dischargePatient();
+    admittedByRoomType.erase(patientId);
+    releaseBed(roomType, bed);
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, patientId);
+        logMutation(WAL_DISCHARGE_PATIENT, payload);
+    }
+    publishChange(CHANGE_PATIENT_DISCHARGED, patientId, 0, bed, roomType);
+    return true;
+}
+
+// [Mazen Mohamed] Add a free-text record to a patient's medical history
+bool Hospital::addMedicalRecord(int patientId, string_view record)
+{
+    Patient patient = findPatient(patientId);
+    if (!patient)
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return false;
+    }
+    patient.addMedicalRecord(record);
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, patientId);
+        putString(payload, record);
+        logMutation(WAL_MEDICAL_RECORD, payload);
+    }
+    publishChange(CHANGE_MEDICAL_RECORD, patientId);
+    return true;
+}
+
+// [Mazen Mohamed] Request a test for a patient; it waits in the patient's
+// queue until it is sent to the lab
+bool Hospital::requestTest(int patientId, string_view testName)
+{
+    Patient patient = findPatient(patientId);
+    if (!patient)
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return false;
+    }
+    patient.requestTest(testName);
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, patientId);
+        putString(payload, testName);
+        logMutation(WAL_REQUEST_TEST, payload);
+    }
+    publishChange(CHANGE_TEST_REQUESTED, patientId);
+    return true;
+}
+
+// [Mazen Mohamed] Gather the pending tests of every patient into the lab's
+// per-type queues; returns how many were sent
+int Hospital::sendTestsToLab()
+{
+    int sent = 0;
+    for (size_t slot = 0; slot < patients.size(); slot++)
+    {
+        sent += patients.at((int)slot).sendTestsToLab(lab);
+    }
+    return sent;
+}
+
+// [Mazen Mohamed] Send one patient's pending tests to the lab; -1 when the
+// patient does not exist
+int Hospital::sendTestsToLab(int patientId)
+{
+    Patient patient = findPatient(patientId);
+    if (!patient)
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return -1;
+    }
+    return patient.sendTestsToLab(lab);
+}
+
+// [Mazen Mohamed] Log a performed test in the patient's history and take it
+// off their queue; false when the patient is gone or has no such test
+bool Hospital::recordTestPerformed(int patientId, string_view testName)
+{
+    Patient patient = findPatient(patientId);
+    if (!patient || !patient.completeTest(testName))
+    {
+        return false;
+    }
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, patientId);
+        putString(payload, testName);
+        logMutation(WAL_TEST_PERFORMED, payload);
+    }
+    publishChange(CHANGE_TEST_PERFORMED, patientId);
+    return true;
+}
+
+// [Mazen Mohamed] Write the tests the lab has finished back to the patients,
+// in the order they were sent. With wait set, first wait for every test the
+// lab holds. Returns how many results were written back; results of patients
+// removed meanwhile are dropped.
+int Hospital::collectTestResults(bool wait)
+{
+    if (wait)
+    {
+        lab.waitIdle();
+    }
+    vector<LabOrder> results;
+    lab.collect(results);
+    int written = 0;
+    StringInterner &strings = StringInterner::shared();
+    for (const LabOrder &result : results)
+    {
+        if (recordTestPerformed(result.patientId, strings.lookup(result.test)))
+        {
+            written++;
+        }
+    }
+    return written;
+}
+
+// [Mazen Mohamed] Set the number of lab lanes working in parallel
+void Hospital::setLabLanes(int lanes)
+{
+    lab.setLanes(lanes);
+}
+
+// [Mazen Mohamed] Set how long one test of a type keeps a lab lane busy
+void Hospital::setTestRunTime(string_view testName, int milliseconds)
+{
+    lab.setRunTime(testName, chrono::milliseconds(max(milliseconds, 0)));
+}
+
+// [Mazen Mohamed] Display lab queue depth and wait times per test type
+void Hospital::displayLabStatus()
+{
+    vector<LabTestStats> stats = lab.stats();
+    cout << "===== LAB =====" << endl;
+    cout << "Lanes: " << lab.getLanes() << " | In lab: " << lab.getOutstanding()
+         << " | Results to collect: " << lab.getFinished() << endl;
+    for (const LabTestStats &type : stats)
+    {
+        cout << type.test << ": " << type.waiting << " waiting, " << type.running << " running, "
+             << type.completed << " done";
+        if (type.completed > 0)
+        {
+            char timing[96];
+            snprintf(timing, sizeof(timing), " | wait avg %.1f ms, max %.1f ms | run avg %.1f ms",
+                     type.averageWaitMs, type.maxWaitMs, type.averageRunMs);
+            cout << timing;
+        }
+        cout << endl;
+    }
+    cout << "===============" << endl;
+}
+
+// [Mazen Mohamed] Default triage priority for a new emergency case
+EmergencyPriority Hospital::emergencyPriorityFor(int patientId) const
+{
+    (void)patientId;
+    return STABLE;
+}
+
+// [Mazen Mohamed] Add emergency case
+bool Hospital::addEmergency(int patientId)
+{
+    if (!findPatient(patientId))
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return false;
+    }
+    if (!emergencyQueue.push(patientId, emergencyPriorityFor(patientId)))
+    {
+        cout << "Patient with ID " << patientId << " is already in the emergency queue." << endl;
+        return false;
+    }
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, patientId);
+        logMutation(WAL_ADD_EMERGENCY, payload);
+    }
+    publishChange(CHANGE_EMERGENCY_QUEUED, patientId, 0, 0, emergencyQueue.priorityOf(patientId));
+    return true;
+}
+
+// [Mazen Mohamed] Handle emergency case
+// The most urgent case goes first; equal priorities are handled in arrival order.
+int Hospital::handleEmergency()
+{
+    LatencyTimer timer(TIMED_HANDLE_EMERGENCY);
+    if (emergencyQueue.empty())
+    {
+        cout << "No emergencies in queue." << endl;
+        return -1;
+    }
+    logMutation(WAL_HANDLE_EMERGENCY, string());
+    int patientId = emergencyQueue.pop();
+    publishChange(CHANGE_EMERGENCY_HANDLED, patientId);
+    return patientId;
+}
+
+// [Mazen Mohamed] Book appointment
+bool Hospital::bookAppointment(int doctorId, int patientId)
+{
+    LatencyTimer timer(TIMED_BOOK_APPOINTMENT);
+    Doctor *doctor = findDoctor(doctorId);
+    if (doctor == nullptr)
+    {
+        cout << "Doctor with ID " << doctorId << " not found." << endl;
+        return false;
+    }
+    if (!doctor->addAppointment(patientId))
+    {
+        cout << "Appointment queue of Doctor ID " << doctorId << " is full." << endl;
+        return false;
+    }
+    doctorLoad.setQueueLength(doctorId, doctor->getQueueLength());
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, doctorId);
+        putI32(payload, patientId);
+        logMutation(WAL_BOOK_APPOINTMENT, payload);
+    }
+    publishChange(CHANGE_APPOINTMENT_BOOKED, patientId, doctorId, 0, SCHEDULED);
+
+    // Log appointment in patient's medical history; the booking stands
+    // even when the patient record is missing
+    Patient patient = findPatient(patientId);
+    if (!patient)
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return true;
+    }
+    patient.recordAppointmentBooked(doctorId);
+    return true;
+}
+
+// [Mazen Mohamed] Take the next patient from a doctor's appointment queue,
+// returning the patient ID or -1
+int Hospital::seePatient(int doctorId)
+{
+    Doctor *doctor = findDoctor(doctorId);
+    if (doctor == nullptr)
+    {
+        cout << "Doctor with ID " << doctorId << " not found." << endl;
+        return -1;
+    }
+    int patientId = doctor->seePatient();
+    if (patientId == -1)
+    {
+        cout << "No patients waiting for Doctor ID " << doctorId << "." << endl;
+        return -1;
+    }
+    doctorLoad.setQueueLength(doctorId, doctor->getQueueLength());
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, doctorId);
+        logMutation(WAL_SEE_PATIENT, payload);
+    }
+    publishChange(CHANGE_PATIENT_SEEN, patientId, doctorId);
+    return patientId;
+}
+
+// [Mazen Mohamed] Least-loaded doctor of a department: the shortest
+// appointment queue, then the earliest free calendar. -1 if it has no doctors.
+int Hospital::assignDoctor(Department dept) const
+{
+    return doctorLoad.lightest(dept);
+}
+
+// [Mazen Mohamed] Display patient information and history
+void Hospital::displayPatientInfo(int patientId, ReportFormat format)
+{
+    Patient patient = findPatient(patientId);
+    if (!patient)
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return;
+    }
+    ReportWriter report(format);
+    patient.writeDetails(report);
+    patient.writeHistory(report);
+}
+
+// [Mazen Mohamed] Display doctor information
+void Hospital::displayDoctorInfo(int doctorId)
+{
+    Doctor *doctor = findDoctor(doctorId);
+    if (doctor == nullptr)
+    {
+        cout << "Doctor with ID " << doctorId << " not found." << endl;
+        return;
+    }
+    cout << "Doctor ID: " << doctor->getId() << endl;
+    cout << "Name: " << doctor->getName() << endl;
+    cout << "Department: " << doctor->getDepartment() << endl;
+}
+
+// [Mazen Mohamed] Display all patients
+void Hospital::displayAllPatients(ReportFormat format)
+{
+    ReportWriter report(format);
+    report.beginTable("patients", "===== ALL PATIENTS =====");
+    for (size_t slot = 0; slot < patients.size(); slot++)
+    {
+        patients.at((int)slot).writeSummary(report);
+    }
+    report.endTable("========================");
+}
+
+// [Mazen Mohamed] Admitted patients per room type, counted from the patient
+// columns rather than the indexes (a full census scan)
+void Hospital::countAdmittedPatients(size_t counts[ROOM_TYPE_COUNT]) const
+{
+    fill(counts, counts + ROOM_TYPE_COUNT, 0);
+    if (workers == nullptr)
+    {
+        patients.countAdmitted(counts, 0, patients.size());
+        return;
+    }
+    // Chunks are a multiple of the 8-patient words the scan works in
+    const size_t GRAIN = 1 << 16;
+    size_t chunks = (patients.size() + GRAIN - 1) / GRAIN;
+    vector<EnumArray<RoomType, size_t>> partial(chunks);
+    workers->parallelFor(patients.size(), GRAIN, [&](size_t begin, size_t end)
+                         {
+        EnumArray<RoomType, size_t> &chunk = partial[begin / GRAIN];
+        chunk.fill(0);
+        patients.countAdmitted(chunk.data(), begin, end); });
+    for (const auto &chunk : partial)
+    {
+        for (size_t type = 0; type < ROOM_TYPE_COUNT; type++)
+        {
+            counts[type] += chunk[type];
+        }
+    }
+}
+
+// [Mazen Mohamed] Run bulk operations on threads worker threads, or serially
+// when threads is 1 or less. Deterministic mode keeps the chunked code paths
+// but runs every chunk on the calling thread in order.
+void Hospital::setWorkerThreads(int threads, bool deterministic)
+{
+    workers.reset();
+    if (threads > 1 || deterministic)
+    {
+        workers = make_unique<TaskPool>(threads, deterministic);
+    }
+}
+
+// [Mazen Mohamed] Number of registered patients
+int Hospital::getPatientCount() const
+{
+    return (int)patients.size();
+}
+
+// [Mazen Mohamed] Number of registered doctors
+int Hospital::getDoctorCount() const
+{
+    return (int)doctors.size();
+}
+
+// [Mazen Mohamed] Latency of the timed operations plus the hospital's gauges:
+// counts, queue depths and memory held by the medical histories
+void Hospital::collectMetrics(vector<MetricFamily> &families)
+{
+    collectLatencyMetrics(families);
+    families.push_back({"hms_patients", "Registered patients", "gauge", {{"", "", (double)getPatientCount()}}});
+    families.push_back({"hms_doctors", "Doctors", "gauge", {{"", "", (double)getDoctorCount()}}});
+
+    MetricFamily admitted{"hms_admitted_patients", "Admitted patients by room type", "gauge", {}};
+    MetricFamily waiting{"hms_bed_waitlist", "Patients waiting for a bed by room type", "gauge", {}};
+    for (size_t type = 0; type < ROOM_TYPE_COUNT; type++)
+    {
+        string label = "room_type=\"" + string(enumName((RoomType)type)) + "\"";
+        admitted.samples.push_back({"", label, (double)admittedByRoomType.ids(type).size()});
+        waiting.samples.push_back({"", label, (double)beds.getWaitingCount((RoomType)type)});
+    }
+    families.push_back(move(admitted));
+    families.push_back(move(waiting));
+
+    EnumArray<Department, size_t> queued{};
+    int longest = 0;
+    for (const Doctor &doctor : doctors)
+    {
+        int length = doctor.getQueueLength();
+        queued[doctor.getDepartmentValue()] += length;
+        longest = max(longest, length);
+    }
+    MetricFamily queues{"hms_doctor_queue_depth", "Patients in the doctors' appointment queues by department",
+                        "gauge", {}};
+    for (size_t dept = 0; dept < DEPARTMENT_COUNT; dept++)
+    {
+        string label = "department=\"" + string(enumName((Department)dept)) + "\"";
+        queues.samples.push_back({"", label, (double)queued[dept]});
+    }
+    families.push_back(move(queues));
+    families.push_back({"hms_doctor_queue_depth_max", "Longest appointment queue of a single doctor", "gauge",
+                        {{"", "", (double)longest}}});
+    families.push_back({"hms_emergency_queue_depth", "Patients in the emergency queue", "gauge",
+                        {{"", "", (double)emergencyQueue.size()}}});
+    families.push_back({"hms_lab_tests_outstanding", "Tests sent to the lab and not collected yet", "gauge",
+                        {{"", "", (double)lab.getOutstanding()}}});
+
+    size_t decodedBytes, encodedBytes;
+    patients.historyMemory(decodedBytes, encodedBytes);
+    families.push_back({"hms_history_memory_bytes", "Memory held by medical histories, decoded or still in the snapshot",
+                        "gauge",
+                        {{"", "state=\"decoded\"", (double)decodedBytes}, {"", "state=\"encoded\"", (double)encodedBytes}}});
+    families.push_back({"hms_interned_strings", "Distinct test names and notes in the shared string table", "gauge",
+                        {{"", "", (double)StringInterner::shared().size()}}});
+}
+
+// [Mazen Mohamed] Display the metrics: latency percentiles of the timed
+// operations, then one line per gauge
+void Hospital::displayMetrics()
+{
+    vector<MetricFamily> families;
+    collectMetrics(families);
+    cout << "===== METRICS =====" << endl;
+    for (size_t operation = 0; operation < LatencyMetrics::OPERATIONS; operation++)
+    {
+        LatencyHistogram histogram = LatencyMetrics::shared().histogram((TimedOperation)operation);
+        char line[160];
+        snprintf(line, sizeof(line),
+                 "%s: %llu calls, %llu timed | p50 %.1f us | p99 %.1f us | p99.9 %.1f us | max %.1f us",
+                 string(enumLabel((TimedOperation)operation)).c_str(), (unsigned long long)histogram.calls,
+                 (unsigned long long)histogram.samples, histogram.quantile(0.5) / 1e3, histogram.quantile(0.99) / 1e3,
+                 histogram.quantile(0.999) / 1e3, histogram.maxNanos / 1e3);
+        cout << line << endl;
+    }
+    for (const MetricFamily &family : families)
+    {
+        if (family.type != "gauge")
+        {
+            continue;
+        }
+        cout << family.help << ":";
+        for (size_t i = 0; i < family.samples.size(); i++)
+        {
+            // Show only the label value, e.g. ICU for room_type="ICU"
+            const string &labels = family.samples[i].labels;
+            size_t quote = labels.find('"');
+            cout << (i > 0 ? ", " : " ");
+            if (quote != string::npos)
+            {
+                cout << labels.substr(quote + 1, labels.size() - quote - 2) << " ";
+            }
+            cout << (long long)family.samples[i].value;
+        }
+        cout << endl;
+    }
+    cout << "===================" << endl;
+}
+
+// [Mazen Mohamed] Write the metrics to a Prometheus text file. The file is
+// replaced in one step, so a scraper never reads a half-written one.
+bool Hospital::writeMetricsFile(const string &path)
+{
+    vector<MetricFamily> families;
+    collectMetrics(families);
+    string tempPath = path + ".tmp";
+    ofstream out(tempPath, ios::trunc);
+    writePrometheusMetrics(out, families);
+    out.close();
+    if (!out || rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        cout << "Could not write metrics to " << path << "." << endl;
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Display all doctors
+void Hospital::displayAllDoctors(ReportFormat format)
+{
+    ReportWriter report(format);
+    report.beginTable("doctors", "===== ALL DOCTORS =====");
+    for (const auto &doctor : doctors)
+    {
+        doctor.writeSummary(report);
+    }
+    report.endTable("=======================");
+}
+
+// [Mazen Mohamed] Rebuild the department, doctor load and room type indexes from the records
+void Hospital::rebuildIndexes()
+{
+    doctorsByDepartment.clear();
+    doctorLoad.clear();
+    for (const auto &doctor : doctors)
+    {
+        doctorsByDepartment.insert(doctor.getId(), doctor.getDepartmentValue());
+        doctorLoad.insert(doctor.getId(), doctor.getDepartmentValue(), doctor.getQueueLength());
+    }
+    // Names are added in ID order so every trigram list is built by appending
+    vector<pair<int, int>> byId;
+    const vector<int> &ids = patients.idColumn();
+    for (size_t slot = 0; slot < ids.size(); slot++)
+    {
+        byId.push_back({ids[slot], (int)slot});
+    }
+    sort(byId.begin(), byId.end());
+    nameIndex.clear();
+    for (const auto &entry : byId)
+    {
+        nameIndex.add(entry.first, patients.at(entry.second).getName());
+    }
+
+    // Patients keep their beds; ones restored without a bed get the next free one.
+    // Only the admission column is scanned; the few admitted patients are visited.
+    admittedByRoomType.clear();
+    beds.clearOccupancy();
+    const vector<uint8_t> &admitted = patients.admittedColumn();
+    vector<int> needBed;
+    for (size_t slot = 0; slot < admitted.size(); slot++)
+    {
+        if (admitted[slot] == 0)
+        {
+            continue;
+        }
+        Patient patient = patients.at((int)slot);
+        admittedByRoomType.insert(patient.getId(), patient.getRoomTypeValue());
+        if (patient.getBed() == -1 || !beds.occupy(patient.getRoomTypeValue(), patient.getBed(), patient.getId()))
+        {
+            patient.setBed(-1);
+            needBed.push_back((int)slot);
+        }
+    }
+    for (int slot : needBed)
+    {
+        Patient patient = patients.at(slot);
+        patient.setBed(beds.allocate(patient.getRoomTypeValue(), patient.getId()));
+    }
+}
+
+// [Mazen Mohamed] IDs of the doctors in a department, in no particular order
+const vector<int> &Hospital::getDoctorsInDepartment(Department dept) const
+{
+    return doctorsByDepartment.ids(dept);
+}
+
+// [Mazen Mohamed] IDs of the patients admitted to a room type, in no particular order
+const vector<int> &Hospital::getAdmittedPatients(RoomType type) const
+{
+    return admittedByRoomType.ids(type);
+}
+
+// [Mazen Mohamed] Display the doctors of one department
+void Hospital::displayDoctorsInDepartment(Department dept)
+{
+    vector<int> ids = doctorsByDepartment.ids(dept);
+    sort(ids.begin(), ids.end());
+    cout << "===== " << Doctor::departmentName(dept) << " DOCTORS =====" << endl;
+    for (int doctorId : ids)
+    {
+        cout << "ID: " << doctorId << " | Name: " << findDoctor(doctorId)->getName() << endl;
+    }
+    cout << "=======================" << endl;
+}
+
+// [Mazen Mohamed] Display the patients admitted to one room type
+void Hospital::displayAdmittedPatients(RoomType type)
+{
+    vector<int> ids = admittedByRoomType.ids(type);
+    sort(ids.begin(), ids.end());
+    cout << "===== PATIENTS IN " << Patient::roomTypeName(type) << " =====" << endl;
+    for (int patientId : ids)
+    {
+        cout << "ID: " << patientId << " | Name: " << findPatient(patientId).getName() << endl;
+    }
+    cout << "========================" << endl;
+}
+
+class MappedFile;
+
+// [Mazen Mohamed] One appointment to book through scheduleAppointments
+struct AppointmentRequest
+{
+    int doctorId;
+    int patientId;
+    string dateTime;
+};
+
+// ========== EXTENDED HOSPITAL CLASS (Mazen's Task Extension) ========== //
+// [Mazen Mohamed] Extended Hospital class with additional functionality
+class ExtendedHospital : public Hospital
+{
+private:
+    vector<Appointment> appointments;
+    int appointmentCounter;
+    map<int, EmergencyPriority> emergencyPriorities;
+
+    // Appointment ID -> position in appointments, same scheme as patientSlots
+    vector<int> appointmentSlots;
+
+    // Non-cancelled appointments by doctor and patient, ordered by time
+    AppointmentCalendar calendar;
+    // Appointment IDs by status, and by doctor department and status together
+    // (key department * APPOINTMENT_STATUS_COUNT + status)
+    EnumIndex<APPOINTMENT_STATUS_COUNT> appointmentsByStatus;
+    EnumIndex<DEPARTMENT_COUNT * APPOINTMENT_STATUS_COUNT> appointmentsByDepartmentStatus;
+    // Set while replaying the log: records were accepted once, so they are
+    // applied again without the date/time and conflict checks
+    bool replaying;
+
+    // Mapping of the last loaded snapshot; patients decode history from it lazily
+    shared_ptr<MappedFile> snapshotData;
+
+    // Write-ahead log generation and how many of its records were replayed
+    unique_ptr<WriteAheadLog> writeAheadLog;
+    uint32_t walEpoch;
+    long long walReplayedRecords;
+
+    long long walPosition();
+    bool replayWriteAheadLog(const string &path, uint32_t snapshotEpoch, long long coveredRecords, bool &appendable,
+                             bool readOnly = false);
+
+    Appointment *findAppointment(int appointmentId);
+    EmergencyPriority emergencyPriorityFor(int patientId) const override;
+    bool checkCalendarConflict(int doctorId, int patientId, int32_t start);
+    int commitAppointment(int doctorId, int patientId, string_view dateTime, int32_t start);
+    void indexAppointment(const Appointment &appointment);
+    void rebuildIndexes() override;
+
+    friend class SnapshotCodec;
+
+public:
+    ExtendedHospital();
+
+    bool removeDoctor(int doctorId) override;
+    int scheduleAppointment(int doctorId, int patientId, string_view dateTime);
+    vector<int> scheduleAppointments(const vector<AppointmentRequest> &requests);
+    int assignAppointment(int patientId, Department dept, string_view from, string_view to);
+    void reserveAppointments(size_t count);
+    bool updateAppointmentStatus(int appointmentId, AppointmentStatus status);
+    void displayAppointmentInfo(int appointmentId);
+    void setEmergencyPriority(int patientId, EmergencyPriority priority);
+    vector<int> getEmergencyQueueByPriority();
+    void displayAllAppointments(ReportFormat format = REPORT_TEXT);
+    vector<int> getDoctorSchedule(int doctorId, const string &from, const string &to);
+    vector<int> getPatientSchedule(int patientId, const string &from, const string &to);
+    void displayDoctorSchedule(int doctorId, const string &from, const string &to);
+    const vector<int> &getAppointmentsByStatus(AppointmentStatus status) const;
+    const vector<int> &getAppointments(Department dept, AppointmentStatus status) const;
+    void displayAppointments(Department dept, AppointmentStatus status);
+    void collectMetrics(vector<MetricFamily> &families) override;
+
+    bool saveSnapshot(const string &path);
+    bool loadSnapshot(const string &path);
+    bool exportPatient(int patientId, string &record, bool forMove = false);
+    int importPatient(string_view record);
+
+    bool recover(const string &snapshotPath, const string &walPath, int syncWindowMs = 10);
+    bool recoverReadOnly(const string &snapshotPath, const string &walPath);
+    bool checkpoint(const string &snapshotPath);
+    bool syncWriteAheadLog();
+};
+
+// [Mazen Mohamed] Extended Hospital constructor implementation
+ExtendedHospital::ExtendedHospital() : Hospital()
+{
+    appointmentCounter = 1;
+    appointmentSlots.push_back(-1);
+    replaying = false;
+    walEpoch = 0;
+    walReplayedRecords = 0;
+}
+
+// [Mazen Mohamed] Look up an appointment by ID in constant time
+Appointment *ExtendedHospital::findAppointment(int appointmentId)
+{
+    if (appointmentId <= 0 || appointmentId >= (int)appointmentSlots.size() || appointmentSlots[appointmentId] == -1)
+    {
+        return nullptr;
+    }
+    return &appointments[appointmentSlots[appointmentId]];
+}
+
+// [Mazen Mohamed] Remove a doctor; their appointments leave the department index
+bool ExtendedHospital::removeDoctor(int doctorId)
+{
+    if (!Hospital::removeDoctor(doctorId))
+    {
+        return false;
+    }
+    for (const auto &appointment : appointments)
+    {
+        if (appointment.getDoctorId() == doctorId)
+        {
+            appointmentsByDepartmentStatus.erase(appointment.getAppointmentId());
+        }
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Schedule a new appointment with date/time
+int ExtendedHospital::scheduleAppointment(int doctorId, int patientId, string_view dateTime)
+{
+    LatencyTimer timer(TIMED_SCHEDULE_APPOINTMENT);
+    // Check if doctor exists
+    if (findDoctor(doctorId) == nullptr)
+    {
+        cout << "Doctor with ID " << doctorId << " not found." << endl;
+        return -1;
+    }
+
+    // Check if patient exists
+    if (!findPatient(patientId))
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return -1;
+    }
+
+    // Reject unreadable times; replay keeps them, as they were accepted once
+    int32_t start;
+    if (!parseDateTime(dateTime, start))
+    {
+        if (!replaying)
+        {
+            cout << "Invalid date/time \"" << dateTime << "\"; expected YYYY-MM-DD HH:MM." << endl;
+            return -1;
+        }
+        start = Appointment::NO_START_TIME;
+    }
+    return commitAppointment(doctorId, patientId, dateTime, start);
+}
+
+// [Mazen Mohamed] Book a checked appointment starting at start unless it is a
+// double booking, returning its ID or -1
+int ExtendedHospital::commitAppointment(int doctorId, int patientId, string_view dateTime, int32_t start)
+{
+    if (!replaying && checkCalendarConflict(doctorId, patientId, start))
+    {
+        return -1;
+    }
+    // The queue booking below must not fail once the appointment is recorded
+    if (!replaying && findDoctor(doctorId)->isQueueFull())
+    {
+        cout << "Appointment queue of Doctor ID " << doctorId << " is full." << endl;
+        return -1;
+    }
+
+    // Add the appointment to the calendar and indexes
+    const Appointment &newAppointment = appointments.emplace_back(appointmentCounter, doctorId, patientId, dateTime, start);
+    calendar.add(newAppointment);
+    doctorLoad.setFreeFrom(doctorId, calendar.doctorFreeFrom(doctorId));
+    indexAppointment(newAppointment);
+    appointmentSlots.push_back((int)appointments.size() - 1);
+
+    // Also book appointment in the base class system; the schedule record
+    // below already covers it, so the nested booking is not logged twice
+    WriteAheadLog *log = wal;
+    ChangeFeed *feed = changes;
+    wal = nullptr;
+    changes = nullptr;
+    bookAppointment(doctorId, patientId);
+    wal = log;
+    changes = feed;
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, doctorId);
+        putI32(payload, patientId);
+        putString(payload, dateTime);
+        logMutation(WAL_SCHEDULE_APPOINTMENT, payload);
+    }
+    publishChange(CHANGE_APPOINTMENT_BOOKED, patientId, doctorId, appointmentCounter, SCHEDULED);
+    return appointmentCounter++;
+}
+
+// [Mazen Mohamed] Schedule an appointment with the least-loaded doctor of a
+// department who has a free slot between from and to, in that doctor's
+// earliest slot the patient is also free. Doctors are tried in load order,
+// so usually only the lightest few are looked at. Returns the appointment ID
+// or -1; the log records it as an ordinary scheduled appointment.
+int ExtendedHospital::assignAppointment(int patientId, Department dept, string_view from, string_view to)
+{
+    int32_t windowStart, windowEnd;
+    if (!parseDateTime(from, windowStart) || !parseDateTime(to, windowEnd))
+    {
+        cout << "Invalid date/time; expected YYYY-MM-DD HH:MM." << endl;
+        return -1;
+    }
+    if (!findPatient(patientId))
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return -1;
+    }
+    int32_t start = Appointment::NO_START_TIME;
+    int doctorId = doctorLoad.lightest(dept, [&](int candidate)
+    {
+        if (findDoctor(candidate)->isQueueFull())
+        {
+            return false;
+        }
+        start = calendar.firstFreeStart(candidate, patientId, windowStart, windowEnd);
+        return start != Appointment::NO_START_TIME;
+    });
+    if (doctorId == -1)
+    {
+        cout << "No " << enumLabel(dept) << " doctor has a free slot for Patient ID " << patientId
+             << " in that window." << endl;
+        return -1;
+    }
+    return commitAppointment(doctorId, patientId, formatDateTime(start), start);
+}
+
+// [Mazen Mohamed] Schedule many appointments and return their IDs in request
+// order, -1 for each rejected one. The requests are parsed and checked against
+// the doctors and patients on the worker threads; the bookings are then made
+// one by one in request order, so earlier requests win double bookings and the
+// messages are the same as for single calls.
+vector<int> ExtendedHospital::scheduleAppointments(const vector<AppointmentRequest> &requests)
+{
+    enum Check : uint8_t
+    {
+        CHECK_OK,
+        CHECK_NO_DOCTOR,
+        CHECK_NO_PATIENT,
+        CHECK_BAD_TIME
+    };
+    vector<int32_t> starts(requests.size());
+    vector<uint8_t> checks(requests.size());
+    auto checkRange = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const AppointmentRequest &request = requests[i];
+            if (findDoctor(request.doctorId) == nullptr)
+            {
+                checks[i] = CHECK_NO_DOCTOR;
+            }
+            else if (!findPatient(request.patientId))
+            {
+                checks[i] = CHECK_NO_PATIENT;
+            }
+            else
+            {
+                checks[i] = parseDateTime(request.dateTime, starts[i]) ? CHECK_OK : CHECK_BAD_TIME;
+            }
+        }
+    };
+    if (workers == nullptr)
+    {
+        checkRange(0, requests.size());
+    }
+    else
+    {
+        workers->parallelFor(requests.size(), 2048, checkRange);
+    }
+
+    reserveAppointments(appointments.size() + requests.size());
+    vector<int> ids(requests.size(), -1);
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+        const AppointmentRequest &request = requests[i];
+        switch (checks[i])
+        {
+        case CHECK_NO_DOCTOR:
+            cout << "Doctor with ID " << request.doctorId << " not found." << endl;
+            break;
+        case CHECK_NO_PATIENT:
+            cout << "Patient with ID " << request.patientId << " not found." << endl;
+            break;
+        case CHECK_BAD_TIME:
+            cout << "Invalid date/time \"" << request.dateTime << "\"; expected YYYY-MM-DD HH:MM." << endl;
+            break;
+        default:
+            ids[i] = commitAppointment(request.doctorId, request.patientId, request.dateTime, starts[i]);
+        }
+    }
+    return ids;
+}
+
+// [Mazen Mohamed] Make room for count appointments in total, for bulk scheduling
+void ExtendedHospital::reserveAppointments(size_t count)
+{
+    if (count > appointments.size())
+    {
+        appointmentSlots.reserve(appointmentSlots.size() + count - appointments.size());
+        appointments.reserve(count);
+    }
+}
+
+// [Mazen Mohamed] Update appointment status
+bool ExtendedHospital::updateAppointmentStatus(int appointmentId, AppointmentStatus status)
+{
+    Appointment *appointment = findAppointment(appointmentId);
+    if (appointment == nullptr)
+    {
+        cout << "Appointment with ID " << appointmentId << " not found." << endl;
+        return false;
+    }
+
+    // Cancelling frees the slot; reviving a cancelled appointment needs it free again
+    bool wasCancelled = appointment->getStatusValue() == CANCELLED;
+    if (!wasCancelled && status == CANCELLED)
+    {
+        calendar.remove(*appointment);
+    }
+    else if (wasCancelled && status != CANCELLED)
+    {
+        if (!replaying && appointment->hasStartTime() &&
+            checkCalendarConflict(appointment->getDoctorId(), appointment->getPatientId(), appointment->getStartMinute()))
+        {
+            return false;
+        }
+        calendar.add(*appointment);
+    }
+    doctorLoad.setFreeFrom(appointment->getDoctorId(), calendar.doctorFreeFrom(appointment->getDoctorId()));
+    appointment->setStatus(status);
+    indexAppointment(*appointment);
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, appointmentId);
+        putU8(payload, (uint8_t)status);
+        logMutation(WAL_UPDATE_APPOINTMENT_STATUS, payload);
+    }
+    publishChange(CHANGE_APPOINTMENT_STATUS, appointment->getPatientId(), appointment->getDoctorId(), appointmentId,
+                  status);
+    return true;
+}
+
+// [Mazen Mohamed] Report whether the doctor or the patient is busy in the slot starting at start
+bool ExtendedHospital::checkCalendarConflict(int doctorId, int patientId, int32_t start)
+{
+    int conflict = calendar.findDoctorConflict(doctorId, start);
+    if (conflict != -1)
+    {
+        cout << "Doctor with ID " << doctorId << " is already booked at that time (appointment " << conflict << ")." << endl;
+        return true;
+    }
+    conflict = calendar.findPatientConflict(patientId, start);
+    if (conflict != -1)
+    {
+        cout << "Patient with ID " << patientId << " is already booked at that time (appointment " << conflict << ")." << endl;
+        return true;
+    }
+    return false;
+}
+
+// [Mazen Mohamed] File an appointment under its current status and its doctor's department
+void ExtendedHospital::indexAppointment(const Appointment &appointment)
+{
+    int appointmentId = appointment.getAppointmentId();
+    AppointmentStatus status = appointment.getStatusValue();
+    appointmentsByStatus.insert(appointmentId, status);
+    Doctor *doctor = findDoctor(appointment.getDoctorId());
+    if (doctor != nullptr)
+    {
+        appointmentsByDepartmentStatus.insert(appointmentId, doctor->getDepartmentValue() * APPOINTMENT_STATUS_COUNT + status);
+    }
+    else
+    {
+        appointmentsByDepartmentStatus.erase(appointmentId);
+    }
+}
+
+// [Mazen Mohamed] Rebuild every derived index, e.g. after a snapshot load
+void ExtendedHospital::rebuildIndexes()
+{
+    Hospital::rebuildIndexes();
+    calendar.clear();
+    appointmentsByStatus.clear();
+    appointmentsByDepartmentStatus.clear();
+    for (const auto &appointment : appointments)
+    {
+        if (appointment.getStatusValue() != CANCELLED)
+        {
+            calendar.add(appointment);
+        }
+        indexAppointment(appointment);
+    }
+    for (const auto &doctor : doctors)
+    {
+        doctorLoad.setFreeFrom(doctor.getId(), calendar.doctorFreeFrom(doctor.getId()));
+    }
+}
+
+// [Mazen Mohamed] IDs of the appointments with a status, in no particular order
+const vector<int> &ExtendedHospital::getAppointmentsByStatus(AppointmentStatus status) const
+{
+    return appointmentsByStatus.ids(status);
+}
+
+// [Mazen Mohamed] IDs of the appointments with a status in one department, in no particular order
+const vector<int> &ExtendedHospital::getAppointments(Department dept, AppointmentStatus status) const
+{
+    return appointmentsByDepartmentStatus.ids(dept * APPOINTMENT_STATUS_COUNT + status);
+}
+
+// [Mazen Mohamed] Display the appointments with a status in one department
+void ExtendedHospital::displayAppointments(Department dept, AppointmentStatus status)
+{
+    vector<int> ids = getAppointments(dept, status);
+    sort(ids.begin(), ids.end());
+    cout << "===== " << Doctor::departmentName(dept) << " APPOINTMENTS =====" << endl;
+    for (int appointmentId : ids)
+    {
+        const Appointment *appointment = findAppointment(appointmentId);
+        cout << "ID: " << appointmentId << " | Doctor: " << appointment->getDoctorId()
+             << " | Patient: " << appointment->getPatientId() << " | Time: " << appointment->getDateTime()
+             << " | Status: " << appointment->getStatus() << endl;
+    }
+    cout << "============================" << endl;
+}
+
+// [Mazen Mohamed] Hospital metrics plus the appointments by status
+void ExtendedHospital::collectMetrics(vector<MetricFamily> &families)
+{
+    Hospital::collectMetrics(families);
+    MetricFamily byStatus{"hms_appointments", "Scheduled appointments by status", "gauge", {}};
+    for (size_t status = 0; status < APPOINTMENT_STATUS_COUNT; status++)
+    {
+        byStatus.samples.push_back({"", "status=\"" + string(enumName((AppointmentStatus)status)) + "\"",
+                                    (double)appointmentsByStatus.ids(status).size()});
+    }
+    families.push_back(move(byStatus));
+}
+
+// [Mazen Mohamed] IDs of the doctor's appointments overlapping [from, to), in time order
+vector<int> ExtendedHospital::getDoctorSchedule(int doctorId, const string &from, const string &to)
+{
+    int32_t start, end;
+    if (!parseDateTime(from, start) || !parseDateTime(to, end))
+    {
+        return vector<int>();
+    }
+    return calendar.doctorAppointments(doctorId, start, end);
+}
+
+// [Mazen Mohamed] IDs of the patient's appointments overlapping [from, to), in time order
+vector<int> ExtendedHospital::getPatientSchedule(int patientId, const string &from, const string &to)
+{
+    int32_t start, end;
+    if (!parseDateTime(from, start) || !parseDateTime(to, end))
+    {
+        return vector<int>();
+    }
+    return calendar.patientAppointments(patientId, start, end);
+}
+
+// [Mazen Mohamed] Display a doctor's appointments between two date/times
+void ExtendedHospital::displayDoctorSchedule(int doctorId, const string &from, const string &to)
+{
+    int32_t start, end;
+    if (!parseDateTime(from, start) || !parseDateTime(to, end))
+    {
+        cout << "Invalid date/time; expected YYYY-MM-DD HH:MM." << endl;
+        return;
+    }
+    cout << "===== SCHEDULE OF DOCTOR " << doctorId << " =====" << endl;
+    for (int appointmentId : calendar.doctorAppointments(doctorId, start, end))
+    {
+        const Appointment *appointment = findAppointment(appointmentId);
+        cout << "ID: " << appointmentId << " | Patient: " << appointment->getPatientId()
+             << " | Time: " << appointment->getDateTime() << " | Status: " << appointment->getStatus() << endl;
+    }
+    cout << "==========================" << endl;
+}
+
+// [Mazen Mohamed] Display appointment information
+void ExtendedHospital::displayAppointmentInfo(int appointmentId)
+{
+    Appointment *appointment = findAppointment(appointmentId);
+    if (appointment == nullptr)
+    {
+        cout << "Appointment with ID " << appointmentId << " not found." << endl;
+        return;
+    }
+    cout << "Appointment ID: " << appointment->getAppointmentId() << endl;
+    cout << "Doctor ID: " << appointment->getDoctorId() << endl;
+    cout << "Patient ID: " << appointment->getPatientId() << endl;
+    cout << "Date/Time: " << appointment->getDateTime() << endl;
+    cout << "Status: " << appointment->getStatus() << endl;
+}
+
+// [Mazen Mohamed] Set emergency priority for a patient
+// A case that is already queued is moved to its new place immediately.
+void ExtendedHospital::setEmergencyPriority(int patientId, EmergencyPriority priority)
+{
+    emergencyPriorities[patientId] = priority;
+    emergencyQueue.reprioritize(patientId, priority);
+
+    if (wal != nullptr)
+    {
+        string payload;
+        putI32(payload, patientId);
+        putU8(payload, (uint8_t)priority);
+        logMutation(WAL_SET_EMERGENCY_PRIORITY, payload);
+    }
+    publishChange(CHANGE_EMERGENCY_PRIORITY, patientId, 0, 0, priority);
+}
+
+// [Mazen Mohamed] Priority recorded for a patient, STABLE if none was set
+EmergencyPriority ExtendedHospital::emergencyPriorityFor(int patientId) const
+{
+    auto it = emergencyPriorities.find(patientId);
+    if (it == emergencyPriorities.end())
+    {
+        return STABLE;
+    }
+    return it->second;
+}
+
+// [Mazen Mohamed] Get emergency queue sorted by priority
+vector<int> ExtendedHospital::getEmergencyQueueByPriority()
+{
+    return emergencyQueue.orderedSnapshot();
+}
+
+// [Mazen Mohamed] Display all appointments
+void ExtendedHospital::displayAllAppointments(ReportFormat format)
+{
+    ReportWriter report(format);
+    report.beginTable("appointments", "===== ALL APPOINTMENTS =====");
+    for (const auto &appointment : appointments)
+    {
+        appointment.writeSummary(report);
+    }
+    report.endTable("============================");
+}
+
+// ========== SNAPSHOT PERSISTENCE ========== //
+// [Mazen Mohamed] Read-only view of a whole file
+// Memory-mapped where available, read into memory otherwise.
+class MappedFile
+{
+private:
+    const char *bytes;
+    size_t length;
+#ifdef _WIN32
+    vector<char> buffer;
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const string &path);
+    const char *data() const;
+    size_t size() const;
+};
+
+// [Mazen Mohamed] MappedFile constructor implementation
+MappedFile::MappedFile()
+{
+    bytes = nullptr;
+    length = 0;
+}
+
+// [Mazen Mohamed] Release the mapping
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if (bytes != nullptr && length > 0)
+    {
+        munmap((void *)bytes, length);
+    }
+#endif
+}
+
+// [Mazen Mohamed] Map a file for reading
+bool MappedFile::open(const string &path)
+{
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+    void *mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        return false;
+    }
+    bytes = (const char *)mapped;
+    length = (size_t)info.st_size;
+    return true;
+#else
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file)
+    {
+        return false;
+    }
+    buffer.resize((size_t)file.tellg());
+    file.seekg(0);
+    if (buffer.empty() || !file.read(buffer.data(), buffer.size()))
+    {
+        return false;
+    }
+    bytes = buffer.data();
+    length = buffer.size();
+    return true;
+#endif
+}
+
+// [Mazen Mohamed] Start of the file contents
+const char *MappedFile::data() const
+{
+    return bytes;
+}
+
+// [Mazen Mohamed] File size in bytes
+size_t MappedFile::size() const
+{
+    return length;
+}
+
+// [Mazen Mohamed] Versioned binary snapshot of an ExtendedHospital
+// Layout (native little-endian, strings are <u32 length><bytes>):
+//   header:       magic[8] version:u32 patientCounter doctorCounter appointmentCounter:i32
+//                 walEpoch:u32 walRecords:u64 (the log position covered)
+//   patients:     count:u32 { id age:i32 admitted roomType:u8 bed:i32 name contact
+//                             tests:u32 {string} historyCount historyBytes:u32
+//                             {timestamp:u32 kind detail:u8 value:i32 [string]} }
+//                 (the string is present for notes and tests)
+//   doctors:      count:u32 { id:i32 department:u8 name queue:u32 {patientId:i32} }
+//   appointments: count:u32 { id doctorId patientId:i32 status:u8 dateTime }
+//   emergencies:  count:u32 { patientId:i32 priority:u8 } in treatment order
+//   priorities:   count:u32 { patientId:i32 priority:u8 }
+//   beds:         policy:u8 { capacity:i32 waiting:u32 {patientId:i32} } per room type
+//   trailer:      checksum:u32 (FNV-1a of everything before it)
+// Only this version is read; a file of any other version is refused, and
+// so is one whose checksum does not match or whose IDs are out of range.
+// Each patient's history block is length-prefixed so loading can skip it
+// and leave the decode to the first time the history is used.
+class SnapshotCodec
+{
+private:
+    static const char MAGIC[8];
+    static const uint32_t VERSION = 1;
+
+    static void encodePatient(PatientStore &patients, size_t slot, string &out, bool withTests = true);
+    static bool decodePatient(BinaryReader &in, int patientCounter, PatientStore &patients);
+
+public:
+    static void encode(ExtendedHospital &hospital, string &out);
+    static bool save(ExtendedHospital &hospital, const string &path);
+    static bool load(ExtendedHospital &hospital, const string &path);
+    static bool exportPatient(ExtendedHospital &hospital, int patientId, string &out, bool withTests);
+    static int importPatient(ExtendedHospital &hospital, string_view record);
+};
+
+const char SnapshotCodec::MAGIC[8] = {'H', 'M', 'S', 'S', 'N', 'A', 'P', '\0'};
+
+// [Mazen Mohamed] Append one patient's record; this only reads the hospital
+void SnapshotCodec::encodePatient(PatientStore &patients, size_t slot, string &out, bool withTests)
+{
+    putI32(out, patients.ids[slot]);
+    putI32(out, patients.ages[slot]);
+    putU8(out, patients.admitted[slot]);
+    putU8(out, patients.roomTypes[slot]);
+    putI32(out, patients.beds[slot]);
+    PatientRecord &patient = patients.records[slot];
+    putString(out, patient.name);
+    putString(out, patient.contact);
+
+    putU32(out, withTests ? (uint32_t)patient.testQueue.size() : 0);
+    for (const pmr::string &test : patient.testQueue)
+    {
+        if (!withTests)
+        {
+            break;
+        }
+        putString(out, test);
+    }
+
+    // Oldest first: undecoded history bytes come straight from the old snapshot
+    string decoded;
+    for (const HistoryEvent &event : patient.medicalHistory)
+    {
+        putU32(decoded, event.timestamp);
+        putU8(decoded, event.kind);
+        putU8(decoded, event.detail);
+        putI32(decoded, event.value);
+        if (event.hasText())
+        {
+            putString(decoded, patient.medicalHistory.text(event));
+        }
+    }
+    putU32(out, patient.pendingHistoryCount + (uint32_t)patient.medicalHistory.size());
+    putU32(out, patient.pendingHistoryBytes + (uint32_t)decoded.size());
+    if (patient.pendingHistory != nullptr)
+    {
+        out.append(patient.pendingHistory, patient.pendingHistoryBytes);
+    }
+    out.append(decoded);
+}
+
+// [Mazen Mohamed] Decode one patient record written by encodePatient and add
+// it to patients; history bytes are left in the input for a lazy decode
+bool SnapshotCodec::decodePatient(BinaryReader &in, int patientCounter, PatientStore &patients)
+{
+    int id = in.i32();
+    int age = in.i32();
+    bool admitted = in.u8() != 0;
+    RoomType roomType = (RoomType)in.u8();
+    int bed = in.i32();
+    if (id <= 0 || id >= patientCounter || !isEnumValue<RoomType>(roomType))
+    {
+        in.ok = false;
+        return false;
+    }
+    string_view name = in.view();
+    string_view contact = in.view();
+    int slot = patients.add(id, name, age, contact).slot;
+    patients.admitted[slot] = admitted ? 1 : 0;
+    patients.roomTypes[slot] = (uint8_t)roomType;
+    patients.beds[slot] = admitted ? bed : -1;
+    PatientRecord &patient = patients.records[slot];
+
+    uint32_t testCount = in.u32();
+    for (uint32_t t = 0; t < testCount && in.ok; t++)
+    {
+        patient.testQueue.emplace_back(in.view());
+    }
+
+    patient.pendingHistoryCount = in.u32();
+    patient.pendingHistoryBytes = in.u32();
+    patient.pendingHistory = in.skip(patient.pendingHistoryBytes);
+    if (patient.pendingHistoryCount == 0)
+    {
+        patient.pendingHistory = nullptr;
+    }
+    return in.ok;
+}
+
+// [Mazen Mohamed] Encode the whole hospital into out
+// Patients are encoded in chunks on the hospital's worker threads, if it has
+// any, and the chunks appended in slot order, so the bytes do not depend on
+// the number of threads.
+void SnapshotCodec::encode(ExtendedHospital &hospital, string &out)
+{
+    out.append(MAGIC, sizeof(MAGIC));
+    putU32(out, VERSION);
+    putI32(out, hospital.patientCounter);
+    putI32(out, hospital.doctorCounter);
+    putI32(out, hospital.appointmentCounter);
+    putU32(out, hospital.walEpoch);
+    putU64(out, (uint64_t)hospital.walPosition());
+
+    PatientStore &patients = hospital.patients;
+    putU32(out, (uint32_t)patients.size());
+
+    if (hospital.workers == nullptr)
+    {
+        for (size_t slot = 0; slot < patients.size(); slot++)
+        {
+            encodePatient(patients, slot, out);
+        }
+    }
+    else
+    {
+        const size_t GRAIN = 4096;
+        vector<string> chunks((patients.size() + GRAIN - 1) / GRAIN);
+        hospital.workers->parallelFor(patients.size(), GRAIN, [&](size_t begin, size_t end)
+                                      {
+            string &chunk = chunks[begin / GRAIN];
+            for (size_t slot = begin; slot < end; slot++)
+            {
+                encodePatient(patients, slot, chunk);
+            } });
+        for (const string &chunk : chunks)
+        {
+            out.append(chunk);
+        }
+    }
+
+    putU32(out, (uint32_t)hospital.doctors.size());
+    for (const auto &doctor : hospital.doctors)
+    {
+        putI32(out, doctor.id);
+        putU8(out, (uint8_t)doctor.department);
+        putString(out, doctor.name);
+        vector<int> waiting = doctor.appointmentQueue->snapshot();
+        putU32(out, (uint32_t)waiting.size());
+        for (int patientId : waiting)
+        {
+            putI32(out, patientId);
+        }
+    }
+
+    putU32(out, (uint32_t)hospital.appointments.size());
+    for (const auto &appointment : hospital.appointments)
+    {
+        putI32(out, appointment.appointmentId);
+        putI32(out, appointment.doctorId);
+        putI32(out, appointment.patientId);
+        putU8(out, (uint8_t)appointment.status);
+        putString(out, appointment.dateTime);
+    }
+
+    vector<int> emergencies = hospital.emergencyQueue.orderedSnapshot();
+    putU32(out, (uint32_t)emergencies.size());
+    for (int patientId : emergencies)
+    {
+        putI32(out, patientId);
+        putU8(out, (uint8_t)hospital.emergencyQueue.priorityOf(patientId));
+    }
+
+    putU32(out, (uint32_t)hospital.emergencyPriorities.size());
+    for (const auto &entry : hospital.emergencyPriorities)
+    {
+        putI32(out, entry.first);
+        putU8(out, (uint8_t)entry.second);
+    }
+
+    putU8(out, (uint8_t)hospital.admissionPolicy);
+    for (size_t type = 0; type < ROOM_TYPE_COUNT; type++)
+    {
+        putI32(out, hospital.beds.getCapacity((RoomType)type));
+        vector<int> waitlist = hospital.beds.getWaitlist((RoomType)type);
+        putU32(out, (uint32_t)waitlist.size());
+        for (int patientId : waitlist)
+        {
+            putI32(out, patientId);
+        }
+    }
+    putChecksumTrailer(out);
+}
+
+// [Mazen Mohamed] Encode the whole hospital and replace the file at path
+// replaceFileDurably keeps the previous snapshot until the new one is on
+// disk, so a crash mid-save never leaves a truncated snapshot or none.
+bool SnapshotCodec::save(ExtendedHospital &hospital, const string &path)
+{
+    string out;
+    encode(hospital, out);
+
+    if (!replaceFileDurably(path, out.data(), out.size()))
+    {
+        cout << "Failed to write snapshot to " << path << "." << endl;
+        return false;
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Replace the hospital state with the snapshot at path
+// Nothing is changed unless the whole file decodes cleanly.
+bool SnapshotCodec::load(ExtendedHospital &hospital, const string &path)
+{
+    shared_ptr<MappedFile> file = make_shared<MappedFile>();
+    if (!file->open(path))
+    {
+        return false;
+    }
+
+    BinaryReader in{file->data(), file->data() + file->size(), true};
+    const char *magic = in.skip(sizeof(MAGIC));
+    if (magic == nullptr || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        cout << "File " << path << " is not a hospital snapshot." << endl;
+        return false;
+    }
+    uint32_t version = in.u32();
+    if (version != VERSION)
+    {
+        cout << "Unsupported snapshot version " << version << " in " << path << "." << endl;
+        return false;
+    }
+    if (!readChecksumTrailer(in, file->data(), file->size()))
+    {
+        cout << "Snapshot " << path << " is truncated or corrupt." << endl;
+        return false;
+    }
+
+    int patientCounter = in.i32();
+    int doctorCounter = in.i32();
+    int appointmentCounter = in.i32();
+    uint32_t walEpoch = in.u32();
+    long long walRecords = (long long)in.u64();
+
+    // Every encoded patient takes at least 26 bytes, which bounds the reserve
+    PatientStore patients(&hospital.arena);
+    uint32_t patientCount = in.u32();
+    patients.reserve(min((size_t)patientCount, (size_t)(in.end - in.cursor) / 26));
+    for (uint32_t i = 0; i < patientCount && in.ok; i++)
+    {
+        decodePatient(in, patientCounter, patients);
+    }
+
+    vector<Doctor> doctors;
+    uint32_t doctorCount = in.u32();
+    for (uint32_t i = 0; i < doctorCount && in.ok; i++)
+    {
+        int id = in.i32();
+        Department department = (Department)in.u8();
+        if (id <= 0 || id >= doctorCounter || !isEnumValue<Department>(department))
+        {
+            in.ok = false;
+            break;
+        }
+        doctors.emplace_back(id, in.view(), department, &hospital.arena);
+        uint32_t waiting = in.u32();
+        for (uint32_t w = 0; w < waiting && in.ok; w++)
+        {
+            int patientId = in.i32();
+            in.ok = in.ok && patientId > 0 && patientId < patientCounter;
+            doctors.back().addAppointment(patientId);
+        }
+    }
+
+    vector<Appointment> appointments;
+    uint32_t appointmentCount = in.u32();
+    for (uint32_t i = 0; i < appointmentCount && in.ok; i++)
+    {
+        int id = in.i32();
+        int doctorId = in.i32();
+        int patientId = in.i32();
+        AppointmentStatus status = (AppointmentStatus)in.u8();
+        if (id <= 0 || id >= appointmentCounter || doctorId <= 0 || doctorId >= doctorCounter ||
+            patientId <= 0 || patientId >= patientCounter || !isEnumValue<AppointmentStatus>(status))
+        {
+            in.ok = false;
+            break;
+        }
+        appointments.emplace_back(id, doctorId, patientId, in.view());
+        appointments.back().status = status;
+    }
+
+    vector<pair<int, EmergencyPriority>> emergencies;
+    uint32_t emergencyCount = in.u32();
+    for (uint32_t i = 0; i < emergencyCount && in.ok; i++)
+    {
+        int patientId = in.i32();
+        uint8_t priority = in.u8();
+        if (!isEnumValue<EmergencyPriority>(priority))
+        {
+            in.ok = false;
+            break;
+        }
+        emergencies.push_back({patientId, (EmergencyPriority)priority});
+    }
+
+    map<int, EmergencyPriority> priorities;
+    uint32_t priorityCount = in.u32();
+    for (uint32_t i = 0; i < priorityCount && in.ok; i++)
+    {
+        int patientId = in.i32();
+        uint8_t priority = in.u8();
+        if (!isEnumValue<EmergencyPriority>(priority))
+        {
+            in.ok = false;
+            break;
+        }
+        priorities[patientId] = (EmergencyPriority)priority;
+    }
+
+    int capacities[ROOM_TYPE_COUNT];
+    vector<int> waitlists[ROOM_TYPE_COUNT];
+    AdmissionPolicy admissionPolicy = (AdmissionPolicy)in.u8();
+    for (size_t type = 0; type < ROOM_TYPE_COUNT && in.ok; type++)
+    {
+        capacities[type] = in.i32();
+        uint32_t waiting = in.u32();
+        for (uint32_t w = 0; w < waiting && in.ok; w++)
+        {
+            int patientId = in.i32();
+            in.ok = in.ok && patientId > 0 && patientId < patientCounter;
+            waitlists[type].push_back(patientId);
+        }
+        if (capacities[type] < BedInventory::UNLIMITED)
+        {
+            in.ok = false;
+        }
+    }
+    if (!isEnumValue<AdmissionPolicy>(admissionPolicy) || in.cursor != in.end)
+    {
+        in.ok = false;
+    }
+
+    // Rebuild the ID indexes; IDs of removed records stay unmapped, and an
+    // ID held by two records makes the file corrupt
+    auto indexIds = [&in](vector<int> &slots, int counter, size_t count, auto idOf)
+    {
+        slots.assign(max(counter, 1), -1);
+        for (size_t i = 0; i < count && in.ok; i++)
+        {
+            int &slot = slots[idOf(i)];
+            in.ok = slot == -1;
+            slot = (int)i;
+        }
+    };
+    vector<int> patientSlots, doctorSlots, appointmentSlots;
+    indexIds(patientSlots, patientCounter, patients.size(), [&patients](size_t i)
+             { return patients.ids[i]; });
+    indexIds(doctorSlots, doctorCounter, doctors.size(), [&doctors](size_t i)
+             { return doctors[i].id; });
+    indexIds(appointmentSlots, appointmentCounter, appointments.size(), [&appointments](size_t i)
+             { return appointments[i].appointmentId; });
+
+    if (!in.ok)
+    {
+        cout << "Snapshot " << path << " is truncated or corrupt." << endl;
+        return false;
+    }
+
+    hospital.patientSlots.swap(patientSlots);
+    hospital.doctorSlots.swap(doctorSlots);
+    hospital.appointmentSlots.swap(appointmentSlots);
+    // Tests still at the lab belong to the patients being replaced
+    hospital.lab.reset();
+    hospital.patients = move(patients);
+    hospital.doctors.swap(doctors);
+    hospital.appointments.swap(appointments);
+    hospital.beds = BedInventory();
+    for (size_t type = 0; type < ROOM_TYPE_COUNT; type++)
+    {
+        hospital.beds.setCapacity((RoomType)type, capacities[type]);
+    }
+    hospital.admissionPolicy = admissionPolicy;
+    hospital.rebuildIndexes();
+    for (size_t type = 0; type < ROOM_TYPE_COUNT; type++)
+    {
+        for (int patientId : waitlists[type])
+        {
+            hospital.beds.enqueue((RoomType)type, patientId);
+        }
+    }
+    // Cases of unknown patients are dropped instead of queued
+    hospital.emergencyQueue = EmergencyTriageQueue();
+    for (const auto &emergency : emergencies)
+    {
+        if (!hospital.findPatient(emergency.first))
+        {
+            cout << "Dropping emergency case of unknown patient " << emergency.first << " from snapshot." << endl;
+            continue;
+        }
+        hospital.emergencyQueue.push(emergency.first, emergency.second);
+    }
+    hospital.emergencyPriorities.swap(priorities);
+    hospital.patientCounter = patientCounter;
+    hospital.doctorCounter = doctorCounter;
+    hospital.appointmentCounter = appointmentCounter;
+    hospital.snapshotData = file;
+    hospital.walEpoch = walEpoch;
+    hospital.walReplayedRecords = walRecords;
+    return true;
+}
+
+// [Mazen Mohamed] Encode a single patient, prefixed with the snapshot version,
+// for another hospital to import; pending tests only with withTests set
+bool SnapshotCodec::exportPatient(ExtendedHospital &hospital, int patientId, string &out, bool withTests)
+{
+    Patient patient = hospital.findPatient(patientId);
+    if (!patient)
+    {
+        return false;
+    }
+    putU32(out, VERSION);
+    encodePatient(hospital.patients, (size_t)patient.slot, out, withTests);
+    return true;
+}
+
+// [Mazen Mohamed] Add a patient exported by another hospital under a new ID
+// The patient arrives without a bed, and the history is decoded at once
+// because the record does not outlive the call. Returns -1 for a bad record.
+int SnapshotCodec::importPatient(ExtendedHospital &hospital, string_view record)
+{
+    BinaryReader in{record.data(), record.data() + record.size(), true};
+    uint32_t version = in.u32();
+    if (!in.ok || version != VERSION)
+    {
+        return -1;
+    }
+    PatientStore &patients = hospital.patients;
+    int slot = (int)patients.size();
+    if (!decodePatient(in, INT32_MAX, patients) || in.cursor != in.end)
+    {
+        if ((int)patients.size() > slot)
+        {
+            patients.remove(slot);
+        }
+        return -1;
+    }
+
+    int id = hospital.patientCounter++;
+    patients.ids[slot] = id;
+    patients.admitted[slot] = 0;
+    patients.beds[slot] = -1;
+    hospital.patientSlots.push_back(slot);
+    hospital.nameIndex.add(id, patients.records[slot].name);
+    patients.at(slot).decodePendingHistory();
+    return id;
+}
+
+// [Mazen Mohamed] Save the hospital state to a binary snapshot file
+bool ExtendedHospital::saveSnapshot(const string &path)
+{
+    return SnapshotCodec::save(*this, path);
+}
+
+// [Mazen Mohamed] Restore the hospital state from a binary snapshot file
+bool ExtendedHospital::loadSnapshot(const string &path)
+{
+    return SnapshotCodec::load(*this, path);
+}
+
+// [Mazen Mohamed] Encode a patient for another hospital. A move takes the
+// pending tests along and needs an idle patient: one with a bed, a place in a
+// bed, emergency or doctor's queue, appointments or tests at the lab is tied
+// to this hospital and is refused. A copy carries name and history only, so the tests
+// are not run twice.
+bool ExtendedHospital::exportPatient(int patientId, string &record, bool forMove)
+{
+    Patient patient = findPatient(patientId);
+    if (!patient)
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return false;
+    }
+    auto queuedWithDoctor = [this, patientId]()
+    {
+        return any_of(doctors.begin(), doctors.end(), [patientId](const Doctor &doctor)
+                      { return doctor.hasQueued(patientId); });
+    };
+    if (forMove && (patient.getAdmissionStatus() || beds.isWaiting(patientId) || emergencyQueue.contains(patientId) ||
+                    patient.getTestsAtLab() > 0 ||
+                    !calendar.patientAppointments(patientId, INT32_MIN, INT32_MAX).empty() || queuedWithDoctor()))
+    {
+        cout << "Patient " << patientId << " has open admissions, appointments or tests and cannot be moved." << endl;
+        return false;
+    }
+    record.clear();
+    return SnapshotCodec::exportPatient(*this, patientId, record, forMove);
+}
+
+// [Mazen Mohamed] Register a patient exported by another hospital; returns the new ID or -1
+int ExtendedHospital::importPatient(string_view record)
+{
+    int patientId = SnapshotCodec::importPatient(*this, record);
+    if (patientId == -1)
+    {
+        cout << "Patient record could not be imported." << endl;
+        return -1;
+    }
+    if (wal != nullptr)
+    {
+        string payload;
+        putString(payload, record);
+        logMutation(WAL_IMPORT_PATIENT, payload);
+    }
+    publishChange(CHANGE_PATIENT_IMPORTED, patientId);
+    return patientId;
+}
+
+// ========== CRASH RECOVERY ========== //
+// [Mazen Mohamed] Number of records in the current log generation that the
+// in-memory state already reflects
+long long ExtendedHospital::walPosition()
+{
+    return walReplayedRecords + (writeAheadLog ? writeAheadLog->getAppendedRecords() : 0);
+}
+
+// [Mazen Mohamed] Apply the log at path on top of the current state
+// Records the loaded snapshot already covers are skipped. Returns whether
+// the log was applied; appendable says whether new records can follow it.
+// A torn tail is cut off, and a file that is no log is moved aside, unless
+// readOnly is set.
+bool ExtendedHospital::replayWriteAheadLog(const string &path, uint32_t snapshotEpoch, long long coveredRecords, bool &appendable,
+                                           bool readOnly)
+{
+    appendable = false;
+    size_t validBytes = 0;
+    size_t fileBytes = 0;
+    {
+        MappedFile file;
+        if (!file.open(path))
+        {
+            return false;
+        }
+        fileBytes = file.size();
+
+        BinaryReader in{file.data(), file.data() + file.size(), true};
+        const char *magic = in.skip(sizeof(WriteAheadLog::MAGIC));
+        uint32_t epoch = in.u32();
+        if (!in.ok || memcmp(magic, WriteAheadLog::MAGIC, sizeof(WriteAheadLog::MAGIC)) != 0)
+        {
+            if (!readOnly)
+            {
+                cout << "File " << path << " is not a write-ahead log; starting a new one." << endl;
+                rename(path.c_str(), (path + ".corrupt").c_str());
+            }
+            return false;
+        }
+        if (epoch < snapshotEpoch)
+        {
+            // Older than the snapshot: everything in it is already applied
+            return false;
+        }
+
+        long long skip = epoch == snapshotEpoch ? coveredRecords : 0;
+        long long index = 0;
+        validBytes = in.cursor - file.data();
+        replaying = true;
+        while (in.cursor < in.end)
+        {
+            uint32_t length = in.u32();
+            uint8_t type = in.u8();
+            const char *payload = in.skip(length);
+            uint32_t sum = in.u32();
+            if (!in.ok || sum != WriteAheadLog::checksum(type, payload, length))
+            {
+                break;
+            }
+            validBytes = in.cursor - file.data();
+            if (index++ < skip)
+            {
+                continue;
+            }
+
+            // History entries the replay adds get the time of the original mutation
+            BinaryReader record{payload, payload + length, true};
+            MedicalTimeline::setClockOverride((long long)record.u64());
+            switch (type)
+            {
+            case WAL_REGISTER_PATIENT:
+            {
+                string_view name = record.view();
+                int age = record.i32();
+                registerPatient(name, age, record.view());
+                break;
+            }
+            case WAL_ADD_DOCTOR:
+            {
+                string_view name = record.view();
+                addDoctor(name, (Department)record.u8());
+                break;
+            }
+            case WAL_REMOVE_PATIENT:
+                removePatient(record.i32());
+                break;
+            case WAL_REMOVE_DOCTOR:
+                removeDoctor(record.i32());
+                break;
+            case WAL_ADMIT_PATIENT:
+            {
+                int patientId = record.i32();
+                admitPatient(patientId, (RoomType)record.u8());
+                break;
+            }
+            case WAL_ADD_EMERGENCY:
+                addEmergency(record.i32());
+                break;
+            case WAL_HANDLE_EMERGENCY:
+                handleEmergency();
+                break;
+            case WAL_BOOK_APPOINTMENT:
+            {
+                int doctorId = record.i32();
+                bookAppointment(doctorId, record.i32());
+                break;
+            }
+            case WAL_MEDICAL_RECORD:
+            {
+                int patientId = record.i32();
+                addMedicalRecord(patientId, record.view());
+                break;
+            }
+            case WAL_SCHEDULE_APPOINTMENT:
+            {
+                int doctorId = record.i32();
+                int patientId = record.i32();
+                scheduleAppointment(doctorId, patientId, record.view());
+                break;
+            }
+            case WAL_UPDATE_APPOINTMENT_STATUS:
+            {
+                int appointmentId = record.i32();
+                updateAppointmentStatus(appointmentId, (AppointmentStatus)record.u8());
+                break;
+            }
+            case WAL_SET_EMERGENCY_PRIORITY:
+            {
+                int patientId = record.i32();
+                setEmergencyPriority(patientId, (EmergencyPriority)record.u8());
+                break;
+            }
+            case WAL_DISCHARGE_PATIENT:
+                dischargePatient(record.i32());
+                break;
+            case WAL_SET_BED_CAPACITY:
+            {
+                RoomType roomType = (RoomType)record.u8();
+                setBedCapacity(roomType, record.i32());
+                break;
+            }
+            case WAL_SET_ADMISSION_POLICY:
+                setAdmissionPolicy((AdmissionPolicy)record.u8());
+                break;
+            case WAL_REQUEST_TEST:
+            {
+                int patientId = record.i32();
+                requestTest(patientId, record.view());
+                break;
+            }
+            case WAL_TEST_PERFORMED:
+            {
+                int patientId = record.i32();
+                recordTestPerformed(patientId, record.view());
+                break;
+            }
+            case WAL_IMPORT_PATIENT:
+                importPatient(record.view());
+                break;
+            case WAL_SEE_PATIENT:
+                seePatient(record.i32());
+                break;
+            case WAL_WAITLIST_PATIENT:
+            {
+                // The admission found no bed, so the patient joined the line;
+                // logs from before this record used WAL_ADMIT_PATIENT for it
+                int patientId = record.i32();
+                RoomType roomType = (RoomType)record.u8();
+                if (findPatient(patientId) && !beds.isWaiting(patientId))
+                {
+                    beds.enqueue(roomType, patientId);
+                }
+                break;
+            }
+            default:
+                cout << "Skipping unknown write-ahead log record type " << (int)type << "." << endl;
+            }
+        }
+        MedicalTimeline::setClockOverride(0);
+        replaying = false;
+        walEpoch = epoch;
+        walReplayedRecords = index;
+        appendable = true;
+    }
+    if (validBytes < fileBytes && !readOnly)
+    {
+        // Keep only the intact prefix so new records are not appended after
+        // garbage; cutting in place leaves the intact records where they were
+        cout << "Discarded " << (fileBytes - validBytes) << " bytes of incomplete write-ahead log." << endl;
+        if (!truncateFileDurably(path, validBytes))
+        {
+            appendable = false;
+        }
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Load the last snapshot and replay the log on top without
+// changing, creating or logging to either file, e.g. to list the state while
+// another process keeps appending to the log. Replay stops before a record
+// that is still being written.
+bool ExtendedHospital::recoverReadOnly(const string &snapshotPath, const string &walPath)
+{
+    if (ifstream(snapshotPath).good() && !loadSnapshot(snapshotPath))
+    {
+        return false;
+    }
+    bool appendable = false;
+    replayWriteAheadLog(walPath, walEpoch, walReplayedRecords, appendable, true);
+    return true;
+}
+
+// [Mazen Mohamed] Load the last snapshot, replay the log on top and keep logging
+bool ExtendedHospital::recover(const string &snapshotPath, const string &walPath, int syncWindowMs)
+{
+    if (writeAheadLog)
+    {
+        writeAheadLog->close();
+    }
+    wal = nullptr;
+
+    if (ifstream(snapshotPath).good() && !loadSnapshot(snapshotPath))
+    {
+        return false;
+    }
+
+    bool appendable = false;
+    bool replayed = replayWriteAheadLog(walPath, walEpoch, walReplayedRecords, appendable);
+    if (!appendable)
+    {
+        // A log whose torn tail could not be cut is folded into the snapshot first
+        if (replayed && !saveSnapshot(snapshotPath))
+        {
+            return false;
+        }
+        // Start a fresh generation newer than anything the snapshot covers
+        remove(walPath.c_str());
+        walEpoch++;
+        walReplayedRecords = 0;
+    }
+
+    writeAheadLog.reset(new WriteAheadLog());
+    if (!writeAheadLog->open(walPath, walEpoch, syncWindowMs))
+    {
+        writeAheadLog.reset();
+        return false;
+    }
+    wal = writeAheadLog.get();
+    return true;
+}
+
+// [Mazen Mohamed] Write a snapshot and empty the log it now covers
+bool ExtendedHospital::checkpoint(const string &snapshotPath)
+{
+    if (!saveSnapshot(snapshotPath))
+    {
+        return false;
+    }
+    if (writeAheadLog)
+    {
+        if (!writeAheadLog->truncate(walEpoch + 1))
+        {
+            return false;
+        }
+        walEpoch++;
+        walReplayedRecords = 0;
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Block until every logged mutation is durable; false if
+// the log lost some of them
+bool ExtendedHospital::syncWriteAheadLog()
+{
+    return !writeAheadLog || writeAheadLog->sync();
+}
+
+// ========== CONCURRENT HOSPITAL ========== //
+// [Mazen Mohamed] Model of a hospital core that many terminals drive at once
+// Records are spread over shards by ID, each shard behind its own
+// reader/writer lock, and IDs come from atomic counters. An operation never
+// holds two shard locks at the same time, so there is no lock ordering to get
+// wrong. Read paths copy what they show under a shared lock and do all the
+// formatting and console output after releasing it, so writers only ever wait
+// for a short copy.
+//
+// This class exists for the --stress test of the locking scheme, not to run
+// a hospital. It has no write-ahead log, snapshot, change feed, metrics,
+// indexes, medical records, tests or waitlists, and nothing is persisted.
+// Hospital and ExtendedHospital remain the only real implementation; they
+// are single-threaded, so a service in front of them serializes calls.
+class ConcurrentHospital
+{
+private:
+    static const int SHARD_COUNT = 16;
+
+    // Records of one shard; a record with ID id lives at slots[id / SHARD_COUNT]
+    template <typename Record>
+    struct Shard
+    {
+        mutable shared_mutex lock;
+        vector<Record> records;
+        vector<int> slots;
+
+        Record *find(int id);
+        template <typename... Args>
+        void emplace(int id, Args &&...args);
+    };
+
+    // Patients of one shard, kept column-wise like Hospital's; a patient
+    // with ID id lives at slots[id / SHARD_COUNT]. Records allocate from the
+    // shard's own pool, which only writers (holding the lock) touch.
+    struct PatientShard
+    {
+        mutable shared_mutex lock;
+        pmr::unsynchronized_pool_resource pool;
+        PatientStore records;
+        vector<int> slots;
+
+        PatientShard();
+        Patient find(int id);
+        void insert(int id, string_view name, int age, string_view contact);
+    };
+
+    PatientShard patientShards[SHARD_COUNT];
+    Shard<Doctor> doctorShards[SHARD_COUNT];
+    Shard<Appointment> appointmentShards[SHARD_COUNT];
+    atomic<int> patientCounter;
+    atomic<int> doctorCounter;
+    atomic<int> appointmentCounter;
+
+    mutex emergencyLock;
+    EmergencyTriageQueue emergencyQueue;
+
+    // Free beds per room type; admissions take them without a shared lock
+    EnumArray<RoomType, BedPool> bedPools;
+
+    static int shardOf(int id);
+    bool patientExists(int patientId);
+    bool doctorExists(int doctorId);
+
+public:
+    ConcurrentHospital();
+
+    int registerPatient(string_view name, int age, string_view contact);
+    int addDoctor(string_view name, Department dept);
+    void setBedCapacity(RoomType type, int capacity);
+    bool admitPatient(int patientId, RoomType type);
+    bool dischargePatient(int patientId);
+    bool checkBedAssignments();
+    bool bookAppointment(int doctorId, int patientId);
+    int seePatient(int doctorId);
+    int scheduleAppointment(int doctorId, int patientId, string_view dateTime);
+    bool updateAppointmentStatus(int appointmentId, AppointmentStatus status);
+    void addEmergency(int patientId, EmergencyPriority priority);
+    int handleEmergency();
+    void displayPatientInfo(int patientId);
+    void displayAllPatients();
+    void displayAllAppointments();
+};
+
+// [Mazen Mohamed] Look up a record of this shard, nullptr if missing
+template <typename Record>
+Record *ConcurrentHospital::Shard<Record>::find(int id)
+{
+    int local = id / SHARD_COUNT;
+    if (id <= 0 || local >= (int)slots.size() || slots[local] == -1)
+    {
+        return nullptr;
+    }
+    return &records[slots[local]];
+}
+
+// [Mazen Mohamed] Construct a record in this shard; the caller holds the write lock
+template <typename Record>
+template <typename... Args>
+void ConcurrentHospital::Shard<Record>::emplace(int id, Args &&...args)
+{
+    int local = id / SHARD_COUNT;
+    if (local >= (int)slots.size())
+    {
+        slots.resize(local + 1, -1);
+    }
+    slots[local] = (int)records.size();
+    records.emplace_back(forward<Args>(args)...);
+}
+
+// [Mazen Mohamed] Empty shard whose records use its pool
+ConcurrentHospital::PatientShard::PatientShard() : records(&pool)
+{
+}
+
+// [Mazen Mohamed] Look up a patient of this shard; the view tests false if missing
+Patient ConcurrentHospital::PatientShard::find(int id)
+{
+    int local = id / SHARD_COUNT;
+    if (id <= 0 || local >= (int)slots.size() || slots[local] == -1)
+    {
+        return Patient();
+    }
+    return records.at(slots[local]);
+}
+
+// [Mazen Mohamed] Add a patient to this shard; the caller holds the write lock
+void ConcurrentHospital::PatientShard::insert(int id, string_view name, int age, string_view contact)
+{
+    int local = id / SHARD_COUNT;
+    if (local >= (int)slots.size())
+    {
+        slots.resize(local + 1, -1);
+    }
+    slots[local] = (int)records.size();
+    records.add(id, name, age, contact);
+}
+
+// [Mazen Mohamed] ConcurrentHospital constructor implementation
+ConcurrentHospital::ConcurrentHospital()
+    : patientCounter(1), doctorCounter(1), appointmentCounter(1)
+{
+}
+
+// [Mazen Mohamed] Shard that owns a given ID
+int ConcurrentHospital::shardOf(int id)
+{
+    return id % SHARD_COUNT;
+}
+
+// [Mazen Mohamed] Check for a patient under its shard's read lock
+bool ConcurrentHospital::patientExists(int patientId)
+{
+    if (patientId <= 0)
+    {
+        return false;
+    }
+    PatientShard &shard = patientShards[shardOf(patientId)];
+    shared_lock<shared_mutex> guard(shard.lock);
+    return (bool)shard.find(patientId);
+}
+
+// [Mazen Mohamed] Check for a doctor under its shard's read lock
+bool ConcurrentHospital::doctorExists(int doctorId)
+{
+    if (doctorId <= 0)
+    {
+        return false;
+    }
+    Shard<Doctor> &shard = doctorShards[shardOf(doctorId)];
+    shared_lock<shared_mutex> guard(shard.lock);
+    return shard.find(doctorId) != nullptr;
+}
+
+// [Mazen Mohamed] Register a new patient
+int ConcurrentHospital::registerPatient(string_view name, int age, string_view contact)
+{
+    int id = patientCounter.fetch_add(1);
+    PatientShard &shard = patientShards[shardOf(id)];
+    unique_lock<shared_mutex> guard(shard.lock);
+    shard.insert(id, name, age, contact);
+    return id;
+}
+
+// [Mazen Mohamed] Add a new doctor
+int ConcurrentHospital::addDoctor(string_view name, Department dept)
+{
+    int id = doctorCounter.fetch_add(1);
+    Shard<Doctor> &shard = doctorShards[shardOf(id)];
+    unique_lock<shared_mutex> guard(shard.lock);
+    shard.emplace(id, id, name, dept);
+    return id;
+}
+
+// [Mazen Mohamed] Admit a patient
+bool ConcurrentHospital::admitPatient(int patientId, RoomType type)
+{
+    if (patientId <= 0)
+    {
+        return false;
+    }
+    PatientShard &shard = patientShards[shardOf(patientId)];
+    unique_lock<shared_mutex> guard(shard.lock);
+    Patient patient = shard.find(patientId);
+    if (!patient)
+    {
+        return false;
+    }
+    bool admitted = patient.getAdmissionStatus();
+    if (!admitted || patient.getRoomTypeValue() != type)
+    {
+        // The shard lock keeps this patient's bed stable; the pool keeps
+        // two patients from getting the same bed
+        int bed = -1;
+        if (bedPools[type].isLimited() && !bedPools[type].acquire(bed))
+        {
+            return false;
+        }
+        if (admitted && patient.getBed() != -1)
+        {
+            bedPools[patient.getRoomTypeValue()].release(patient.getBed());
+        }
+        patient.setBed(bed);
+    }
+    patient.admitPatient(type);
+    return true;
+}
+
+// [Mazen Mohamed] Discharge a patient and return their bed to its pool
+bool ConcurrentHospital::dischargePatient(int patientId)
+{
+    if (patientId <= 0)
+    {
+        return false;
+    }
+    PatientShard &shard = patientShards[shardOf(patientId)];
+    unique_lock<shared_mutex> guard(shard.lock);
+    Patient patient = shard.find(patientId);
+    if (!patient || !patient.getAdmissionStatus())
+    {
+        return false;
+    }
+    if (patient.getBed() != -1)
+    {
+        bedPools[patient.getRoomTypeValue()].release(patient.getBed());
+    }
+    patient.dischargePatient();
+    return true;
+}
+
+// [Mazen Mohamed] Limit a room type to capacity beds; call before sharing the hospital
+void ConcurrentHospital::setBedCapacity(RoomType type, int capacity)
+{
+    bedPools[type].setCapacity(capacity);
+}
+
+// [Mazen Mohamed] Check that no bed is held twice and no pool is oversubscribed.
+// Only meaningful while no admission is in flight.
+bool ConcurrentHospital::checkBedAssignments()
+{
+    vector<vector<bool>> taken(ROOM_TYPE_COUNT);
+    for (size_t type = 0; type < ROOM_TYPE_COUNT; type++)
+    {
+        taken[type].assign(max(bedPools[type].getCapacity(), 0), false);
+    }
+    size_t held[ROOM_TYPE_COUNT] = {};
+    for (auto &shard : patientShards)
+    {
+        shared_lock<shared_mutex> guard(shard.lock);
+        const vector<uint8_t> &admitted = shard.records.admittedColumn();
+        const vector<uint8_t> &roomTypes = shard.records.roomTypeColumn();
+        const vector<int> &bedNumbers = shard.records.bedColumn();
+        for (size_t slot = 0; slot < admitted.size(); slot++)
+        {
+            int bed = bedNumbers[slot];
+            if (admitted[slot] == 0 || bed == -1)
+            {
+                continue;
+            }
+            vector<bool> &beds = taken[roomTypes[slot]];
+            if (bed >= (int)beds.size() || beds[bed])
+            {
+                return false;
+            }
+            beds[bed] = true;
+            held[roomTypes[slot]]++;
+        }
+    }
+    for (size_t type = 0; type < ROOM_TYPE_COUNT; type++)
+    {
+        if (bedPools[type].isLimited() && held[type] + bedPools[type].availableApprox() != (size_t)bedPools[type].getCapacity())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Book appointment
+// The doctor's queue and the patient's history are updated under their own
+// shard locks one after the other, never both at once. Enqueueing only needs
+// the doctor shard's read lock, so bookings for one doctor run in parallel.
+bool ConcurrentHospital::bookAppointment(int doctorId, int patientId)
+{
+    if (doctorId <= 0 || !patientExists(patientId))
+    {
+        return false;
+    }
+    {
+        // The appointment queue is lock-free, so a read lock on the shard is enough
+        Shard<Doctor> &shard = doctorShards[shardOf(doctorId)];
+        shared_lock<shared_mutex> guard(shard.lock);
+        Doctor *doctor = shard.find(doctorId);
+        if (doctor == nullptr || !doctor->addAppointment(patientId))
+        {
+            return false;
+        }
+    }
+    PatientShard &shard = patientShards[shardOf(patientId)];
+    unique_lock<shared_mutex> guard(shard.lock);
+    Patient patient = shard.find(patientId);
+    if (patient)
+    {
+        patient.recordAppointmentBooked(doctorId);
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Next patient for a doctor's workstation, -1 if none
+int ConcurrentHospital::seePatient(int doctorId)
+{
+    if (doctorId <= 0)
+    {
+        return -1;
+    }
+    Shard<Doctor> &shard = doctorShards[shardOf(doctorId)];
+    shared_lock<shared_mutex> guard(shard.lock);
+    Doctor *doctor = shard.find(doctorId);
+    return doctor == nullptr ? -1 : doctor->seePatient();
+}
+
+// [Mazen Mohamed] Schedule a new appointment with date/time
+int ConcurrentHospital::scheduleAppointment(int doctorId, int patientId, string_view dateTime)
+{
+    if (!doctorExists(doctorId) || !patientExists(patientId))
+    {
+        return -1;
+    }
+    // Queue the patient first, so a full queue leaves no appointment behind
+    if (!bookAppointment(doctorId, patientId))
+    {
+        return -1;
+    }
+    int id = appointmentCounter.fetch_add(1);
+    Shard<Appointment> &shard = appointmentShards[shardOf(id)];
+    unique_lock<shared_mutex> guard(shard.lock);
+    shard.emplace(id, id, doctorId, patientId, dateTime);
+    return id;
+}
+
+// [Mazen Mohamed] Update appointment status
+bool ConcurrentHospital::updateAppointmentStatus(int appointmentId, AppointmentStatus status)
+{
+    if (appointmentId <= 0)
+    {
+        return false;
+    }
+    Shard<Appointment> &shard = appointmentShards[shardOf(appointmentId)];
+    unique_lock<shared_mutex> guard(shard.lock);
+    Appointment *appointment = shard.find(appointmentId);
+    if (appointment == nullptr)
+    {
+        return false;
+    }
+    appointment->setStatus(status);
+    return true;
+}
+
+// [Mazen Mohamed] Add emergency case
+void ConcurrentHospital::addEmergency(int patientId, EmergencyPriority priority)
+{
+    if (!patientExists(patientId))
+    {
+        return;
+    }
+    lock_guard<mutex> guard(emergencyLock);
+    emergencyQueue.push(patientId, priority);
+}
+
+// [Mazen Mohamed] Handle the most urgent emergency case, -1 if none
+int ConcurrentHospital::handleEmergency()
+{
+    lock_guard<mutex> guard(emergencyLock);
+    return emergencyQueue.pop();
+}
+
+// [Mazen Mohamed] Display patient information from a point-in-time copy
+void ConcurrentHospital::displayPatientInfo(int patientId)
+{
+    PatientStore copy;
+    if (patientId > 0)
+    {
+        PatientShard &shard = patientShards[shardOf(patientId)];
+        shared_lock<shared_mutex> guard(shard.lock);
+        Patient patient = shard.find(patientId);
+        if (patient)
+        {
+            copy.copyFrom(patient);
+        }
+    }
+    if (copy.size() == 0)
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return;
+    }
+
+    Patient patient = copy.at(0);
+    ReportWriter report;
+    patient.writeDetails(report);
+    patient.writeHistory(report);
+}
+
+// [Mazen Mohamed] Display all patients from per-shard copies
+// Each shard is copied a chunk of slots at a time and its lock is released
+// between chunks, so a registration never waits for more than one chunk of
+// name copies. Patients are never removed here, so a slot keeps its patient
+// and the chunks together see everyone registered before the listing began.
+void ConcurrentHospital::displayAllPatients()
+{
+    const size_t CHUNK_SLOTS = 1024;
+    struct Row
+    {
+        int id;
+        string name;
+        bool admitted;
+    };
+    vector<Row> rows;
+    for (auto &shard : patientShards)
+    {
+        for (size_t from = 0;; from += CHUNK_SLOTS)
+        {
+            shared_lock<shared_mutex> guard(shard.lock);
+            size_t to = min(from + CHUNK_SLOTS, shard.records.size());
+            for (size_t slot = from; slot < to; slot++)
+            {
+                Patient patient = shard.records.at((int)slot);
+                rows.push_back({patient.getId(), patient.getName(), patient.getAdmissionStatus()});
+            }
+            if (to < from + CHUNK_SLOTS)
+            {
+                break;
+            }
+        }
+    }
+    sort(rows.begin(), rows.end(), [](const Row &a, const Row &b)
+         { return a.id < b.id; });
+
+    ReportWriter report;
+    report.beginTable("patients", "===== ALL PATIENTS =====");
+    for (const auto &row : rows)
+    {
+        Patient::writeSummary(report, row.id, row.name, row.admitted);
+    }
+    report.endTable("========================");
+}
+
+// [Mazen Mohamed] Display all appointments from per-shard copies
+void ConcurrentHospital::displayAllAppointments()
+{
+    vector<Appointment> rows;
+    for (auto &shard : appointmentShards)
+    {
+        shared_lock<shared_mutex> guard(shard.lock);
+        rows.insert(rows.end(), shard.records.begin(), shard.records.end());
+    }
+    sort(rows.begin(), rows.end(), [](const Appointment &a, const Appointment &b)
+         { return a.getAppointmentId() < b.getAppointmentId(); });
+
+    ReportWriter report;
+    report.beginTable("appointments", "===== ALL APPOINTMENTS =====");
+    for (const auto &appointment : rows)
+    {
+        appointment.writeSummary(report);
+    }
+    report.endTable("============================");
+}
+
+// ========== STRESS TEST ========== //
+// [Mazen Mohamed] Discards everything written to it
+class NullBuffer : public streambuf
+{
+protected:
+    int overflow(int c) override
+    {
+        return c;
+    }
+    streamsize xsputn(const char *, streamsize count) override
+    {
+        return count;
+    }
+};
+
+// [Mazen Mohamed] Drive one ConcurrentHospital from 1, 2, 4 .. maxThreads threads
+// Every run starts from the same census and each thread runs the same
+// front-desk mix (registrations, admissions and discharges against a limited
+// number of beds, scheduling, emergencies and patient lookups, with an
+// occasional full listing), so ops/second should
+// grow with the thread count up to the number of cores. Console output is
+// discarded while running.
+void runConcurrencyStress(int maxThreads, int operationsPerThread)
+{
+    const int doctorCount = 64;
+    const int patientCount = 10000;
+    cout << "threads,operations,seconds,ops_per_second" << endl;
+
+    NullBuffer sink;
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        ConcurrentHospital hospital;
+        for (int d = 0; d < doctorCount; d++)
+        {
+            hospital.addDoctor("Dr. Stress " + to_string(d), (Department)(d % DEPARTMENT_COUNT));
+        }
+        for (int p = 0; p < patientCount; p++)
+        {
+            hospital.registerPatient("Stress Patient " + to_string(p), 30, "555-0000");
+        }
+        // Fewer beds than patients, so admissions contend for the last free ones
+        for (size_t type = 0; type < ROOM_TYPE_COUNT; type++)
+        {
+            hospital.setBedCapacity((RoomType)type, patientCount / 16);
+        }
+
+        streambuf *console = cout.rdbuf(&sink);
+        auto start = chrono::steady_clock::now();
+        vector<thread> workers;
+        for (int t = 0; t < threads; t++)
+        {
+            workers.emplace_back([&hospital, t, operationsPerThread]()
+                                 {
+                unsigned seed = 2166136261u ^ (unsigned)t;
+                for (int i = 0; i < operationsPerThread; i++)
+                {
+                    seed = seed * 1664525u + 1013904223u;
+                    int roll = (int)((seed >> 16) % 1000);
+                    int doctorId = 1 + (int)(seed % doctorCount);
+                    int patientId = 1 + (int)((seed >> 8) % patientCount);
+                    if (roll < 100)
+                    {
+                        hospital.registerPatient("Walk-in Patient", 30, "555-0000");
+                    }
+                    else if (roll < 300)
+                    {
+                        int aptId = hospital.scheduleAppointment(doctorId, patientId, "2024-01-01 09:00");
+                        hospital.updateAppointmentStatus(aptId, COMPLETED);
+                    }
+                    else if (roll < 350)
+                    {
+                        hospital.seePatient(doctorId);
+                    }
+                    else if (roll < 385)
+                    {
+                        hospital.admitPatient(patientId, (RoomType)(seed % ROOM_TYPE_COUNT));
+                    }
+                    else if (roll < 400)
+                    {
+                        hospital.dischargePatient(patientId);
+                    }
+                    else if (roll < 450)
+                    {
+                        hospital.addEmergency(patientId, (EmergencyPriority)(seed % EnumTraits<EmergencyPriority>::count));
+                        hospital.handleEmergency();
+                    }
+                    else if (roll < 999)
+                    {
+                        hospital.displayPatientInfo(patientId);
+                    }
+                    else
+                    {
+                        hospital.displayAllPatients();
+                    }
+                } });
+        }
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout.rdbuf(console);
+        if (!hospital.checkBedAssignments())
+        {
+            cerr << "Bed check failed with " << threads << " threads: a bed was handed out twice." << endl;
+        }
+
+        long long operations = (long long)threads * operationsPerThread;
+        cout << threads << "," << operations << "," << seconds << "," << (long long)(operations / seconds) << endl;
+    }
+}
+
+// [Hanna] std::queue behind a mutex, the baseline for the ring buffer benchmark
+class MutexQueue
+{
+private:
+    mutex lock;
+    queue<int> items;
+
+public:
+    size_t tryPushBatch(const int *values, size_t count)
+    {
+        lock_guard<mutex> guard(lock);
+        for (size_t i = 0; i < count; i++)
+        {
+            items.push(values[i]);
+        }
+        return count;
+    }
+    size_t tryPopBatch(int *values, size_t count)
+    {
+        lock_guard<mutex> guard(lock);
+        size_t taken = 0;
+        while (taken < count && !items.empty())
+        {
+            values[taken++] = items.front();
+            items.pop();
+        }
+        return taken;
+    }
+};
+
+// [Hanna] Move total values through a queue with the given thread counts
+// Returns elapsed seconds. Each call moves up to batch values at a time.
+template <typename Queue>
+double timeQueue(Queue &queue, int producers, int consumers, int total, int batch)
+{
+    atomic<int> consumed(0);
+    vector<thread> threads;
+    auto start = chrono::steady_clock::now();
+    for (int p = 0; p < producers; p++)
+    {
+        int share = total / producers + (p < total % producers ? 1 : 0);
+        threads.emplace_back([&queue, share, batch, p]()
+                             {
+            vector<int> values(batch, p);
+            int sent = 0;
+            while (sent < share)
+            {
+                size_t pushed = queue.tryPushBatch(values.data(), (size_t)min(batch, share - sent));
+                if (pushed == 0)
+                {
+                    this_thread::yield();
+                }
+                sent += (int)pushed;
+            } });
+    }
+    for (int c = 0; c < consumers; c++)
+    {
+        threads.emplace_back([&queue, &consumed, total, batch]()
+                             {
+            vector<int> values(batch);
+            while (consumed.load(memory_order_relaxed) < total)
+            {
+                size_t taken = queue.tryPopBatch(values.data(), (size_t)batch);
+                if (taken == 0)
+                {
+                    this_thread::yield();
+                }
+                consumed.fetch_add((int)taken, memory_order_relaxed);
+            } });
+    }
+    for (auto &worker : threads)
+    {
+        worker.join();
+    }
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// [Hanna] Compare the lock-free appointment ring with a mutex-guarded std::queue
+void runQueueBenchmark(int producers, int consumers, int total)
+{
+    cout << "queue,producers,consumers,batch,operations,seconds,ops_per_second" << endl;
+    for (int batch : {1, 16})
+    {
+        MpmcRingQueue<int> ring(Doctor::APPOINTMENT_QUEUE_CAPACITY);
+        double ringSeconds = timeQueue(ring, producers, consumers, total, batch);
+        cout << "mpmc_ring," << producers << "," << consumers << "," << batch << "," << total << ","
+             << ringSeconds << "," << (long long)(total / ringSeconds) << endl;
+
+        MutexQueue locked;
+        double lockedSeconds = timeQueue(locked, producers, consumers, total, batch);
+        cout << "mutex_queue," << producers << "," << consumers << "," << batch << "," << total << ","
+             << lockedSeconds << "," << (long long)(total / lockedSeconds) << endl;
+    }
+}
+
+// ========== BENCHMARK SUITE ========== //
+// [Mazen Mohamed] One measured operation at one data size
+struct BenchmarkResult
+{
+    string operation;
+    long long size;
+    long long operations;
+    double seconds;
+    unsigned long long allocations;
+};
+
+// [Mazen Mohamed] Time and heap allocations of one timed loop
+struct BenchmarkRun
+{
+    double seconds;
+    unsigned long long allocations;
+};
+
+// [Mazen Mohamed] Deterministic generator for synthetic patients, doctors and times
+class SyntheticData
+{
+private:
+    uint64_t state;
+
+public:
+    explicit SyntheticData(uint64_t seed) : state(seed) {}
+
+    uint32_t next()
+    {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return (uint32_t)(state >> 33);
+    }
+    int below(int bound)
+    {
+        return (int)(next() % (uint32_t)bound);
+    }
+    // Two- or three-syllable first and last names, so a name search sees a
+    // realistic spread of letter combinations
+    string patientName()
+    {
+        static const char *const SYLLABLES[] = {
+            "al", "an", "ar", "ba", "be", "bri", "ca", "cha", "da", "de", "di", "do", "el", "en", "fa", "fi",
+            "ga", "gra", "ha", "he", "in", "is", "ja", "jo", "ka", "ke", "la", "le", "li", "lo", "ma", "me",
+            "mi", "mo", "na", "ne", "ni", "no", "or", "pa", "pe", "ra", "re", "ri", "ro", "sa", "se", "sha",
+            "si", "so", "ta", "te", "ti", "to", "tha", "ul", "va", "ve", "vi", "wa", "ya", "yo", "za", "zi"};
+        string name;
+        for (int word = 0; word < 2; word++)
+        {
+            int syllables = 2 + below(2);
+            size_t start = name.size();
+            for (int i = 0; i < syllables; i++)
+            {
+                name += SYLLABLES[below(64)];
+            }
+            name[start] = (char)toupper((unsigned char)name[start]);
+            name += word == 0 ? " " : "";
+        }
+        return name;
+    }
+    string contact()
+    {
+        return "555-" + to_string(1000 + below(9000));
+    }
+    // Half-hour slot between 08:00 and 18:00 on some day of 2024-2033
+    string dateTime()
+    {
+        char text[20];
+        snprintf(text, sizeof(text), "%04d-%02d-%02d %02d:%02d", 2024 + below(10), 1 + below(12),
+                 1 + below(28), 8 + below(10), below(2) * 30);
+        return text;
+    }
+};
+
+// [Mazen Mohamed] Wall-clock seconds and heap allocations taken by work()
+template <typename Work>
+BenchmarkRun timeBenchmark(Work work)
+{
+    unsigned long long allocationsBefore = heapAllocations();
+    auto start = chrono::steady_clock::now();
+    work();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return {seconds, heapAllocations() - allocationsBefore};
+}
+
+// [Mazen Mohamed] Measure the core ExtendedHospital operations on a hospital
+// holding `size` patients. Updates run at most OPERATION_LIMIT times per size
+// so the large sizes measure the cost at that scale, not only a longer loop.
+void benchmarkHospitalSize(long long size, vector<BenchmarkResult> &results)
+{
+    const long long OPERATION_LIMIT = 1000000;
+    const long long DISPLAY_LIMIT = 10000;
+    SyntheticData data(0x9E3779B97F4A7C15ULL ^ (uint64_t)size);
+    ExtendedHospital hospital;
+    int patientCount = (int)size;
+    // Each doctor carries a fixed-size appointment ring, so their number is capped
+    int doctorCount = (int)min(max(size / 10, 10LL), 10000LL);
+    long long updates = min(size, OPERATION_LIMIT);
+    long long bookings = min(updates, (long long)doctorCount * (long long)(Doctor::APPOINTMENT_QUEUE_CAPACITY / 2));
+    long long displays = min(size, DISPLAY_LIMIT);
+
+    // Every stride-th name is kept to build the name searches from
+    long long searches = min(size, DISPLAY_LIMIT / 10);
+    long long stride = max(size / searches, 1LL);
+    vector<string> sampledNames;
+    sampledNames.reserve(searches);
+    // Loaded in bulk, so the stores are sized up front (and the reserve timed with them)
+    BenchmarkRun run = timeBenchmark([&]()
+                                   {
+        hospital.reserve(patientCount, doctorCount);
+        for (int i = 0; i < patientCount; i++)
+        {
+            string name = data.patientName();
+            if (i % stride == 0 && (long long)sampledNames.size() < searches)
+            {
+                sampledNames.push_back(name);
+            }
+            hospital.registerPatient(name, 1 + data.below(90), data.contact());
+        } });
+    results.push_back({"registerPatient", size, patientCount, run.seconds, run.allocations});
+
+    run = timeBenchmark([&]()
+                            {
+        for (int i = 0; i < doctorCount; i++)
+        {
+            hospital.addDoctor("Dr. " + to_string(i), (Department)(i % DEPARTMENT_COUNT));
+        } });
+    results.push_back({"addDoctor", size, doctorCount, run.seconds, run.allocations});
+
+    // Registered names with one character mistyped
+    for (string &name : sampledNames)
+    {
+        name[data.below((int)name.size())] = 'x';
+    }
+    run = timeBenchmark([&]()
+                            {
+        for (const string &query : sampledNames)
+        {
+            hospital.searchPatients(query);
+        } });
+    results.push_back({"searchPatients", size, searches, run.seconds, run.allocations});
+
+    run = timeBenchmark([&]()
+                            {
+        for (long long i = 0; i < bookings; i++)
+        {
+            hospital.bookAppointment(1 + data.below(doctorCount), 1 + data.below(patientCount));
+        } });
+    results.push_back({"bookAppointment", size, bookings, run.seconds, run.allocations});
+
+    run = timeBenchmark([&]()
+                            {
+        hospital.reserveAppointments(bookings);
+        for (long long i = 0; i < bookings; i++)
+        {
+            hospital.scheduleAppointment(1 + data.below(doctorCount), 1 + data.below(patientCount), data.dateTime());
+        } });
+    results.push_back({"scheduleAppointment", size, bookings, run.seconds, run.allocations});
+
+    // A working day of one doctor
+    run = timeBenchmark([&]()
+                            {
+        for (long long i = 0; i < displays; i++)
+        {
+            string day = data.dateTime().substr(0, 10);
+            hospital.getDoctorSchedule(1 + data.below(doctorCount), day + " 08:00", day + " 18:00");
+        } });
+    results.push_back({"getDoctorSchedule", size, displays, run.seconds, run.allocations});
+
+    run = timeBenchmark([&]()
+                            {
+        for (long long i = 0; i < bookings; i++)
+        {
+            hospital.updateAppointmentStatus(1 + data.below((int)bookings), (AppointmentStatus)data.below(4));
+        } });
+    results.push_back({"updateAppointmentStatus", size, bookings, run.seconds, run.allocations});
+
+    // Distinct patients, a third of them with a raised priority
+    for (long long i = 0; i < updates; i++)
+    {
+        int patientId = (int)(1 + (i * 7919) % patientCount);
+        if (i % 3 == 0)
+        {
+            hospital.setEmergencyPriority(patientId, (EmergencyPriority)data.below(2));
+        }
+        hospital.addEmergency(patientId);
+    }
+    long long handled = 0;
+    run = timeBenchmark([&]()
+                            {
+        while (hospital.handleEmergency() != -1)
+        {
+            handled++;
+        } });
+    results.push_back({"handleEmergency", size, handled, run.seconds, run.allocations});
+
+    // Patient details include the medical history, so give those patients some
+    for (long long i = 0; i < displays; i++)
+    {
+        int patientId = (int)(1 + (i * 104729) % patientCount);
+        hospital.admitPatient(patientId, (RoomType)data.below(4));
+        hospital.addMedicalRecord(patientId, "Routine check-up");
+    }
+    run = timeBenchmark([&]()
+                            {
+        for (long long i = 0; i < displays; i++)
+        {
+            hospital.displayPatientInfo((int)(1 + (i * 104729) % patientCount));
+        } });
+    results.push_back({"displayPatientInfo", size, displays, run.seconds, run.allocations});
+
+    // Whole-hospital scans; one operation is one patient visited
+    const long long CENSUS_SCANS = max(OPERATION_LIMIT / size, 10LL);
+    size_t census[ROOM_TYPE_COUNT];
+    size_t admittedSeen = 0;
+    run = timeBenchmark([&]()
+                            {
+        for (long long i = 0; i < CENSUS_SCANS; i++)
+        {
+            hospital.countAdmittedPatients(census);
+            admittedSeen += census[GENERAL_WARD];
+        } });
+    if (admittedSeen == 0 && displays > 0)
+    {
+        cerr << "Census found no admitted patients." << endl;
+    }
+    results.push_back({"censusScan", size, CENSUS_SCANS * size, run.seconds, run.allocations});
+
+    run = timeBenchmark([&]()
+                            {
+        for (long long i = 0; i < displays; i++)
+        {
+            hospital.displayDoctorInfo(1 + data.below(doctorCount));
+        } });
+    results.push_back({"displayDoctorInfo", size, displays, run.seconds, run.allocations});
+
+    run = timeBenchmark([&]()
+                            {
+        for (long long i = 0; i < displays; i++)
+        {
+            hospital.displayAppointmentInfo(1 + data.below((int)bookings));
+        } });
+    results.push_back({"displayAppointmentInfo", size, displays, run.seconds, run.allocations});
+
+    // Secondary index lookups, walking the IDs found
+    long long found = 0;
+    run = timeBenchmark([&]()
+                            {
+        for (long long i = 0; i < displays; i++)
+        {
+            for (int patientId : hospital.getAdmittedPatients((RoomType)(i % ROOM_TYPE_COUNT)))
+            {
+                found += patientId;
+            }
+            for (int appointmentId : hospital.getAppointments((Department)(i % DEPARTMENT_COUNT), (AppointmentStatus)(i % APPOINTMENT_STATUS_COUNT)))
+            {
+                found += appointmentId;
+            }
+        } });
+    results.push_back({"indexQuery", size, displays, run.seconds, run.allocations});
+    cout << found;
+
+    // Full listings: one call, counted per row rendered
+    run = timeBenchmark([&]()
+                            { hospital.displayAllPatients(); });
+    results.push_back({"displayAllPatients", size, patientCount, run.seconds, run.allocations});
+
+    run = timeBenchmark([&]()
+                            { hospital.displayAllDoctors(); });
+    results.push_back({"displayAllDoctors", size, doctorCount, run.seconds, run.allocations});
+
+    run = timeBenchmark([&]()
+                            { hospital.displayAllAppointments(); });
+    results.push_back({"displayAllAppointments", size, bookings, run.seconds, run.allocations});
+}
+
+// [Mazen Mohamed] Nanoseconds per call of operation in the JSON results of an
+// earlier --bench run, e.g. of an uninstrumented build; 0 if it is missing
+double benchmarkNanosFrom(const string &json, const string &operation)
+{
+    const string OPERATIONS_KEY = "\"operations\": ";
+    const string SECONDS_KEY = "\"seconds\": ";
+    size_t entry = json.find("\"operation\": \"" + operation + "\"");
+    size_t operations = json.find(OPERATIONS_KEY, entry);
+    size_t seconds = json.find(SECONDS_KEY, entry);
+    if (entry == string::npos || operations == string::npos || seconds == string::npos)
+    {
+        return 0;
+    }
+    double count = strtod(json.c_str() + operations + OPERATIONS_KEY.size(), nullptr);
+    return count > 0 ? strtod(json.c_str() + seconds + SECONDS_KEY.size(), nullptr) * 1e9 / count : 0;
+}
+
+// [Mazen Mohamed] Cost of the latency metrics: handleEmergency and
+// admitPatient, the cheapest timed operations, with the sample period in
+// force against counting calls only (period 0). The settings take turns
+// over several rounds and the fastest round of each is kept, so a noisy
+// round does not decide the result. A build without the timer
+// (-DHMS_NO_LATENCY_METRICS) records the uninstrumented baseline instead;
+// given that run's JSON as baselineJson, the instrumented build reports
+// its overhead against it. The differences go to stderr.
+void benchmarkMetricsOverhead(vector<BenchmarkResult> &results, const string &baselineJson)
+{
+    const int PATIENTS = 200000;
+    const int ROUNDS = 10;
+    const double TARGET_PERCENT = 2;
+    const char *const OPERATIONS[2] = {"handleEmergency", "admitPatient"};
+    int settings = LATENCY_METRICS_COMPILED ? 2 : 1;
+    uint32_t period = LatencyMetrics::getSamplePeriod();
+    ExtendedHospital hospital;
+    hospital.reserve(PATIENTS, 0);
+    for (int i = 0; i < PATIENTS; i++)
+    {
+        hospital.registerPatient("Patient", 40, "555-0000");
+    }
+    hospital.setBedCapacity(GENERAL_WARD, PATIENTS);
+
+    // best[operation][0] sampled (or uninstrumented), best[operation][1] counted only
+    BenchmarkRun best[2][2] = {};
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        // Odd rounds start with the other setting, so neither always runs first
+        for (int turn = 0; turn < settings; turn++)
+        {
+            int counting = (turn + round) % settings;
+            LatencyMetrics::setSamplePeriod(counting == 0 ? period : 0);
+            for (int patientId = 1; patientId <= PATIENTS; patientId++)
+            {
+                hospital.addEmergency(patientId);
+            }
+            BenchmarkRun handled = timeBenchmark([&]()
+                                                 {
+                while (hospital.handleEmergency() != -1)
+                {
+                } });
+            BenchmarkRun admitted = timeBenchmark([&]()
+                                                  {
+                for (int patientId = 1; patientId <= PATIENTS; patientId++)
+                {
+                    hospital.admitPatient(patientId, GENERAL_WARD);
+                } });
+            for (int patientId = 1; patientId <= PATIENTS; patientId++)
+            {
+                hospital.dischargePatient(patientId);
+            }
+            BenchmarkRun runs[2] = {handled, admitted};
+            for (int op = 0; op < 2; op++)
+            {
+                if (round == 0 || runs[op].seconds < best[op][counting].seconds)
+                {
+                    best[op][counting] = runs[op];
+                }
+            }
+        }
+    }
+    LatencyMetrics::setSamplePeriod(period);
+
+    for (int op = 0; op < 2; op++)
+    {
+        string name = OPERATIONS[op];
+        double measured = best[op][0].seconds * 1e9 / PATIENTS;
+        if (!LATENCY_METRICS_COMPILED)
+        {
+            results.push_back({name + "Uninstrumented", PATIENTS, PATIENTS, best[op][0].seconds, best[op][0].allocations});
+            cerr << "Uninstrumented " << name << ": " << measured << " ns per call." << endl;
+            continue;
+        }
+        results.push_back({name + "Sampled", PATIENTS, PATIENTS, best[op][0].seconds, best[op][0].allocations});
+        results.push_back({name + "CountedOnly", PATIENTS, PATIENTS, best[op][1].seconds, best[op][1].allocations});
+        double counted = best[op][1].seconds * 1e9 / PATIENTS;
+        cerr << "Latency sampling on " << name << ": " << measured << " ns per call against " << counted
+             << " ns counted only (" << (counted > 0 ? (measured - counted) * 100 / counted : 0) << "%)." << endl;
+        double baseline = benchmarkNanosFrom(baselineJson, name + "Uninstrumented");
+        if (baseline > 0)
+        {
+            double overhead = (measured - baseline) * 100 / baseline;
+            cerr << "Latency metrics on " << name << ": " << measured << " ns per call against " << baseline
+                 << " ns uninstrumented (" << overhead << "%, target " << TARGET_PERCENT << "%: "
+                 << (overhead <= TARGET_PERCENT ? "met" : "missed") << ")." << endl;
+        }
+    }
+}
+
+// [Mazen Mohamed] Write the results as JSON
+void writeBenchmarkJson(ostream &out, const vector<BenchmarkResult> &results)
+{
+    out << "{\n  \"benchmark\": \"hospital-core\",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchmarkResult &result = results[i];
+        double perOperation = result.operations > 0 ? result.seconds * 1e9 / (double)result.operations : 0;
+        double perSecond = result.seconds > 0 ? (double)result.operations / result.seconds : 0;
+        double allocationsPerOperation = result.operations > 0 ? (double)result.allocations / (double)result.operations : 0;
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"operation\": \"" << result.operation << "\", \"size\": " << result.size
+            << ", \"operations\": " << result.operations << ", \"seconds\": " << result.seconds
+            << ", \"ns_per_op\": " << (long long)perOperation
+            << ", \"ops_per_second\": " << (long long)perSecond
+            << ", \"allocations_per_op\": ";
+        // null when this build does not count allocations
+        if (HEAP_ALLOCATIONS_COUNTED)
+        {
+            out << allocationsPerOperation;
+        }
+        else
+        {
+            out << "null";
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+// [Mazen Mohamed] Run the suite for 10^2 .. 10^maxExponent patients and write
+// JSON to outputPath (stdout when empty or "-"). baselinePath names the JSON
+// of a -DHMS_NO_LATENCY_METRICS build to measure the metrics against.
+// Progress goes to stderr; everything the hospital prints is rendered and
+// discarded.
+void runBenchmarks(int maxExponent, const string &outputPath, const string &baselinePath)
+{
+    string baselineJson;
+    if (!baselinePath.empty())
+    {
+        ifstream baseline(baselinePath);
+        baselineJson.assign(istreambuf_iterator<char>(baseline), istreambuf_iterator<char>());
+        if (benchmarkNanosFrom(baselineJson, "handleEmergencyUninstrumented") == 0)
+        {
+            cerr << "No uninstrumented results in " << baselinePath << "." << endl;
+        }
+    }
+    vector<BenchmarkResult> results;
+    NullBuffer sink;
+    long long size = 100;
+    for (int exponent = 2; exponent <= maxExponent; exponent++, size *= 10)
+    {
+        cerr << "Benchmarking " << size << " patients..." << endl;
+        streambuf *console = cout.rdbuf(&sink);
+        benchmarkHospitalSize(size, results);
+        cout.rdbuf(console);
+    }
+    cerr << "Benchmarking the latency sampling..." << endl;
+    streambuf *console = cout.rdbuf(&sink);
+    benchmarkMetricsOverhead(results, baselineJson);
+    cout.rdbuf(console);
+
+    if (outputPath.empty() || outputPath == "-")
+    {
+        writeBenchmarkJson(cout, results);
+        return;
+    }
+    ofstream file(outputPath);
+    writeBenchmarkJson(file, results);
+    if (!file)
+    {
+        cerr << "Could not write " << outputPath << "." << endl;
+    }
+}
+
+// [Mazen Mohamed] Scaling of the bulk operations with the worker pool: census
+// scan, snapshot encoding and bulk scheduling on 1, 2, 4 .. maxThreads
+// threads, as CSV. Every run is checked against the serial one (same census,
+// same snapshot bytes, same appointment IDs); mismatches go to stderr.
+void runPoolBenchmark(int maxThreads, int patientCount)
+{
+    const int CENSUS_ROUNDS = 20;
+    const int SNAPSHOT_ROUNDS = 3;
+    int doctorCount = max(patientCount / 100, 10);
+    int requestCount = min(patientCount, 200000);
+    NullBuffer sink;
+    streambuf *console = cout.rdbuf(&sink);
+
+    // A hospital with admitted patients and some history for the scans
+    SyntheticData data(0x5EEDULL ^ (uint64_t)patientCount);
+    ExtendedHospital hospital;
+    hospital.reserve(patientCount, doctorCount);
+    for (int i = 0; i < patientCount; i++)
+    {
+        int patientId = hospital.registerPatient(data.patientName(), 1 + data.below(90), data.contact());
+        if (data.below(3) == 0)
+        {
+            hospital.admitPatient(patientId, (RoomType)data.below(ROOM_TYPE_COUNT));
+        }
+        hospital.addMedicalRecord(patientId, "Routine check-up");
+    }
+    for (int i = 0; i < doctorCount; i++)
+    {
+        hospital.addDoctor("Dr. " + to_string(i), (Department)(i % DEPARTMENT_COUNT));
+    }
+    vector<AppointmentRequest> requests;
+    requests.reserve(requestCount);
+    for (int i = 0; i < requestCount; i++)
+    {
+        requests.push_back({1 + data.below(doctorCount), 1 + data.below(patientCount), data.dateTime()});
+    }
+
+    // Bulk scheduling changes the hospital, so each run books into a fresh one
+    auto scheduleRun = [&](int threads, vector<int> &ids)
+    {
+        ExtendedHospital target;
+        target.setWorkerThreads(threads);
+        target.reserve(patientCount, doctorCount);
+        for (int i = 0; i < patientCount; i++)
+        {
+            target.registerPatient("Patient", 40, "555-0000");
+        }
+        for (int i = 0; i < doctorCount; i++)
+        {
+            target.addDoctor("Dr. " + to_string(i), (Department)(i % DEPARTMENT_COUNT));
+        }
+        auto start = chrono::steady_clock::now();
+        ids = target.scheduleAppointments(requests);
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+
+    size_t baseCensus[ROOM_TYPE_COUNT];
+    hospital.countAdmittedPatients(baseCensus);
+    string baseSnapshot;
+    SnapshotCodec::encode(hospital, baseSnapshot);
+    vector<int> baseIds;
+    scheduleRun(1, baseIds);
+    cout.rdbuf(console);
+
+    vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2)
+    {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    cout << "threads,operation,items,seconds,speedup" << endl;
+    double baseSeconds[3] = {0, 0, 0};
+    for (int threads : threadCounts)
+    {
+        console = cout.rdbuf(&sink);
+        hospital.setWorkerThreads(threads);
+        double seconds[3];
+
+        size_t census[ROOM_TYPE_COUNT];
+        auto start = chrono::steady_clock::now();
+        for (int round = 0; round < CENSUS_ROUNDS; round++)
+        {
+            hospital.countAdmittedPatients(census);
+        }
+        seconds[0] = chrono::duration<double>(chrono::steady_clock::now() - start).count() / CENSUS_ROUNDS;
+        bool same = equal(census, census + ROOM_TYPE_COUNT, baseCensus);
+
+        string snapshot;
+        start = chrono::steady_clock::now();
+        for (int round = 0; round < SNAPSHOT_ROUNDS; round++)
+        {
+            snapshot.clear();
+            SnapshotCodec::encode(hospital, snapshot);
+        }
+        seconds[1] = chrono::duration<double>(chrono::steady_clock::now() - start).count() / SNAPSHOT_ROUNDS;
+        same = same && snapshot == baseSnapshot;
+
+        vector<int> ids;
+        seconds[2] = scheduleRun(threads, ids);
+        same = same && ids == baseIds;
+        cout.rdbuf(console);
+
+        if (!same)
+        {
+            cerr << "Results with " << threads << " threads differ from the serial run." << endl;
+        }
+        const char *const OPERATIONS[3] = {"censusScan", "snapshotEncode", "scheduleAppointments"};
+        const long long ITEMS[3] = {patientCount, patientCount, requestCount};
+        for (int op = 0; op < 3; op++)
+        {
+            if (threads == 1)
+            {
+                baseSeconds[op] = seconds[op];
+            }
+            cout << threads << "," << OPERATIONS[op] << "," << ITEMS[op] << "," << seconds[op] << ","
+                 << (seconds[op] > 0 ? baseSeconds[op] / seconds[op] : 0) << endl;
+        }
+    }
+}
+
+// ========== BATCH COMMANDS ========== //
+// [Mazen Mohamed] Non-interactive mode for the nightly admissions export.
+// One command per line, fields separated by '|', blank lines and lines
+// starting with '#' ignored:
+//   REGISTER|name|age|contact          DOCTOR|name|department
+//   ADMIT|patientId|roomType           DISCHARGE|patientId
+//   BEDS|roomType|capacity             POLICY|FAIL_FAST or WAITLIST
+//   RECORD|patientId|text              BOOK|doctorId|patientId
+//   SCHEDULE|doctorId|patientId|dateTime
+//   ASSIGN|patientId|department|from|to
+//   SEE|doctorId
+//   STATUS|appointmentId|status        EMERGENCY|patientId
+//   PRIORITY|patientId|priority        TREAT
+//   TEST|patientId|testName            LAB
+//   LANES|count                        REMOVE|patientId
+//   EXPORT|patientId[|MOVE]            IMPORT|hexRecord
+//   METRICS[|prometheusFile]
+// Enum fields take the enumerator name (CARDIOLOGY, ICU, CRITICAL, COMPLETED)
+// or its number. Each command answers "ok <line> [id]" or "error <line>: why";
+// EXPORT answers with the patient record in hex instead of an ID.
+
+// [Mazen Mohamed] Output sink for batch mode. endl only asks for a flush,
+// which is ignored here; the buffer reaches the file when it is full or drained.
+class BufferedOutput : public streambuf
+{
+private:
+    static const size_t CAPACITY = 1 << 16;
+    FILE *target;
+    // Runs before any buffered bytes go out; once it fails, nothing more does
+    function<bool()> beforeWrite;
+    bool withheld;
+    char buffer[CAPACITY];
+
+protected:
+    int overflow(int c) override;
+    int sync() override;
+
+public:
+    explicit BufferedOutput(FILE *target, function<bool()> beforeWrite = nullptr);
+    ~BufferedOutput();
+
+    bool drain();
+};
+
+// [Mazen Mohamed] Create a sink writing to target. Answers that acknowledge
+// mutations pass a beforeWrite that makes them durable, e.g. a log sync.
+BufferedOutput::BufferedOutput(FILE *target, function<bool()> beforeWrite)
+    : target(target), beforeWrite(move(beforeWrite)), withheld(false)
+{
+    setp(buffer, buffer + CAPACITY);
+}
+
+// [Mazen Mohamed] Write out whatever is still buffered
+BufferedOutput::~BufferedOutput()
+{
+    drain();
+}
+
+// [Mazen Mohamed] Buffer is full: write it out and keep the pending character
+int BufferedOutput::overflow(int c)
+{
+    drain();
+    if (c != EOF)
+    {
+        *pptr() = (char)c;
+        pbump(1);
+    }
+    return c == EOF ? 0 : c;
+}
+
+// [Mazen Mohamed] Ignore per-line flush requests
+int BufferedOutput::sync()
+{
+    return 0;
+}
+
+// [Mazen Mohamed] Hand the buffered bytes to the file; false (and the bytes
+// dropped) once beforeWrite has failed
+bool BufferedOutput::drain()
+{
+    size_t used = (size_t)(pptr() - pbase());
+    if (used > 0 && !withheld && beforeWrite && !beforeWrite())
+    {
+        withheld = true;
+    }
+    if (used > 0 && !withheld)
+    {
+        fwrite(pbase(), 1, used, target);
+    }
+    fflush(target);
+    setp(buffer, buffer + CAPACITY);
+    return !withheld;
+}
+
+// [Mazen Mohamed] One command line split into fields. The fields point into
+// the input buffer, so parsing a line allocates nothing.
+struct BatchCommand
+{
+    static const int MAX_FIELDS = 8;
+    string_view fields[MAX_FIELDS];
+    int fieldCount;
+
+    bool parse(string_view line);
+    bool integer(int index, int &value) const;
+};
+
+// [Mazen Mohamed] Split a line on '|' and trim each field; false for blank lines and comments
+bool BatchCommand::parse(string_view line)
+{
+    fieldCount = 0;
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.remove_suffix(1);
+    }
+    size_t first = line.find_first_not_of(" \t");
+    if (first == string_view::npos || line[first] == '#')
+    {
+        return false;
+    }
+    while (fieldCount < MAX_FIELDS)
+    {
+        size_t separator = line.find('|');
+        string_view field = line.substr(0, separator);
+        size_t start = field.find_first_not_of(" \t");
+        size_t end = field.find_last_not_of(" \t");
+        fields[fieldCount++] = start == string_view::npos ? string_view() : field.substr(start, end - start + 1);
+        if (separator == string_view::npos)
+        {
+            break;
+        }
+        line.remove_prefix(separator + 1);
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Read a field as a decimal integer
+bool BatchCommand::integer(int index, int &value) const
+{
+    if (index >= fieldCount || fields[index].empty())
+    {
+        return false;
+    }
+    string_view text = fields[index];
+    bool negative = text[0] == '-';
+    if (negative)
+    {
+        text.remove_prefix(1);
+    }
+    if (text.empty() || text.size() > 9)
+    {
+        return false;
+    }
+    int result = 0;
+    for (char c : text)
+    {
+        if (c < '0' || c > '9')
+        {
+            return false;
+        }
+        result = result * 10 + (c - '0');
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+// [Mazen Mohamed] Append bytes as lowercase hex, so binary records fit on a command line
+void appendHex(string &out, string_view bytes)
+{
+    static const char DIGITS[] = "0123456789abcdef";
+    out.reserve(out.size() + bytes.size() * 2);
+    for (char c : bytes)
+    {
+        out += DIGITS[(uint8_t)c >> 4];
+        out += DIGITS[(uint8_t)c & 15];
+    }
+}
+
+// [Mazen Mohamed] Decode hex written by appendHex; false for malformed text
+bool decodeHex(string_view text, string &out)
+{
+    if (text.size() % 2 != 0)
+    {
+        return false;
+    }
+    out.clear();
+    out.reserve(text.size() / 2);
+    for (size_t i = 0; i < text.size(); i += 2)
+    {
+        int value = 0;
+        for (size_t j = i; j < i + 2; j++)
+        {
+            char c = text[j];
+            int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+            if (digit < 0)
+            {
+                return false;
+            }
+            value = value * 16 + digit;
+        }
+        out += (char)value;
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Read an enum field given by enumerator name or number
+template <typename Enum>
+bool parseEnumField(const BatchCommand &command, int index, Enum &value)
+{
+    return index < command.fieldCount && parseEnum(command.fields[index], value);
+}
+
+// [Mazen Mohamed] Applies batch commands to a hospital and counts the outcome
+class BatchRunner
+{
+private:
+    ExtendedHospital &hospital;
+    ostream &answers;
+    BatchCommand command;
+    // Answer of a command that returns data rather than an ID (EXPORT)
+    string resultText;
+    long long lineNumber;
+    long long succeeded;
+    long long failed;
+    long long bytesRead;
+
+    void runLine(string_view line);
+    bool apply(const char *&error, int &resultId);
+
+public:
+    explicit BatchRunner(ExtendedHospital &hospital, ostream &answers = cout);
+
+    size_t runBuffer(const char *data, size_t size, bool final);
+    bool runFile(const string &path);
+    void runStream(int input, const function<bool()> &answered);
+
+    long long getCommandCount() const;
+    long long getFailedCount() const;
+    long long getBytesRead() const;
+};
+
+// [Mazen Mohamed] Create a runner over hospital that writes its answers to answers
+BatchRunner::BatchRunner(ExtendedHospital &hospital, ostream &answers)
+    : hospital(hospital), answers(answers), lineNumber(0), succeeded(0), failed(0), bytesRead(0)
+{
+}
+
+// [Mazen Mohamed] Run every complete line in data; returns the bytes consumed.
+// With final set, a last line without a newline is run as well.
+size_t BatchRunner::runBuffer(const char *data, size_t size, bool final)
+{
+    size_t consumed = 0;
+    while (consumed < size)
+    {
+        const char *start = data + consumed;
+        const char *newline = (const char *)memchr(start, '\n', size - consumed);
+        if (newline == nullptr && !final)
+        {
+            break;
+        }
+        size_t length = newline == nullptr ? size - consumed : (size_t)(newline - start);
+        runLine(string_view(start, length));
+        consumed += length + (newline == nullptr ? 0 : 1);
+    }
+    bytesRead += (long long)consumed;
+    return consumed;
+}
+
+// [Mazen Mohamed] Run a command file straight from its mapping
+bool BatchRunner::runFile(const string &path)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        // An empty file cannot be mapped but is still a valid, empty batch
+        ifstream probe(path);
+        return probe.good();
+    }
+    runBuffer(file.data(), file.size(), true);
+    return true;
+}
+
+// [Mazen Mohamed] Run commands from a file descriptor (a pipe or socket)
+// as they arrive, carrying a partial last line over to the next read.
+// answered runs after each read, e.g. to send its answers; false stops.
+void BatchRunner::runStream(int input, const function<bool()> &answered)
+{
+    vector<char> buffer(1 << 20);
+    size_t filled = 0;
+    while (true)
+    {
+        if (filled == buffer.size())
+        {
+            buffer.resize(buffer.size() * 2);
+        }
+#ifndef _WIN32
+        ssize_t count = read(input, buffer.data() + filled, buffer.size() - filled);
+#else
+        int count = _read(input, buffer.data() + filled, (unsigned)(buffer.size() - filled));
+#endif
+        bool final = count <= 0;
+        filled += final ? 0 : (size_t)count;
+        size_t consumed = runBuffer(buffer.data(), filled, final);
+        memmove(buffer.data(), buffer.data() + consumed, filled - consumed);
+        filled -= consumed;
+        if (!answered() || final)
+        {
+            break;
+        }
+    }
+}
+
+// [Mazen Mohamed] Parse and apply one line and answer it
+void BatchRunner::runLine(string_view line)
+{
+    lineNumber++;
+    if (!command.parse(line))
+    {
+        return;
+    }
+    const char *error = nullptr;
+    int resultId = -1;
+    resultText.clear();
+    if (apply(error, resultId))
+    {
+        succeeded++;
+        answers << "ok " << lineNumber;
+        if (!resultText.empty())
+        {
+            answers << ' ' << resultText;
+        }
+        else if (resultId != -1)
+        {
+            answers << ' ' << resultId;
+        }
+        answers << '\n';
+    }
+    else
+    {
+        failed++;
+        answers << "error " << lineNumber << ": " << error << '\n';
+    }
+}
+
+// [Mazen Mohamed] Dispatch the parsed command to the hospital
+bool BatchRunner::apply(const char *&error, int &resultId)
+{
+    string_view verb = command.fields[0];
+    int first = 0, second = 0;
+    error = "bad arguments";
+
+    if (verb == "REGISTER")
+    {
+        if (command.fieldCount != 4 || !command.integer(2, second))
+        {
+            return false;
+        }
+        resultId = hospital.registerPatient(command.fields[1], second, command.fields[3]);
+        return true;
+    }
+    if (verb == "DOCTOR")
+    {
+        Department department;
+        if (command.fieldCount != 3 || !parseEnumField(command, 2, department))
+        {
+            return false;
+        }
+        resultId = hospital.addDoctor(command.fields[1], department);
+        return true;
+    }
+    if (verb == "ADMIT")
+    {
+        RoomType roomType;
+        if (command.fieldCount != 3 || !command.integer(1, first) ||
+            !parseEnumField(command, 2, roomType))
+        {
+            return false;
+        }
+        error = "not admitted (unknown patient or no free bed)";
+        // A patient queued for a bed counts as accepted
+        return hospital.admitPatient(first, roomType) || hospital.isWaitingForBed(first);
+    }
+    if (verb == "BEDS")
+    {
+        RoomType roomType;
+        if (command.fieldCount != 3 || !parseEnumField(command, 1, roomType) ||
+            !command.integer(2, second))
+        {
+            return false;
+        }
+        error = "beds still occupied";
+        return hospital.setBedCapacity(roomType, second);
+    }
+    if (verb == "POLICY")
+    {
+        AdmissionPolicy policy;
+        if (command.fieldCount != 2 || !parseEnumField(command, 1, policy))
+        {
+            return false;
+        }
+        hospital.setAdmissionPolicy(policy);
+        return true;
+    }
+    if (verb == "DISCHARGE")
+    {
+        if (command.fieldCount != 2 || !command.integer(1, first))
+        {
+            return false;
+        }
+        error = "patient not found or not admitted";
+        return hospital.dischargePatient(first);
+    }
+    if (verb == "RECORD")
+    {
+        if (command.fieldCount != 3 || !command.integer(1, first))
+        {
+            return false;
+        }
+        error = "patient not found";
+        return hospital.addMedicalRecord(first, command.fields[2]);
+    }
+    if (verb == "BOOK")
+    {
+        if (command.fieldCount != 3 || !command.integer(1, first) || !command.integer(2, second))
+        {
+            return false;
+        }
+        error = "booking rejected";
+        return hospital.bookAppointment(first, second);
+    }
+    if (verb == "SCHEDULE")
+    {
+        if (command.fieldCount != 4 || !command.integer(1, first) || !command.integer(2, second))
+        {
+            return false;
+        }
+        resultId = hospital.scheduleAppointment(first, second, command.fields[3]);
+        error = "not scheduled (unknown doctor or patient, bad date/time, slot taken or queue full)";
+        return resultId != -1;
+    }
+    if (verb == "ASSIGN")
+    {
+        Department dept;
+        if (command.fieldCount != 5 || !command.integer(1, first) || !parseEnumField(command, 2, dept))
+        {
+            return false;
+        }
+        resultId = hospital.assignAppointment(first, dept, command.fields[3], command.fields[4]);
+        error = "not assigned (unknown patient, bad date/time or no doctor free in the window)";
+        return resultId != -1;
+    }
+    if (verb == "SEE")
+    {
+        if (command.fieldCount != 2 || !command.integer(1, first))
+        {
+            return false;
+        }
+        resultId = hospital.seePatient(first);
+        error = "doctor not found or no patients waiting";
+        return resultId != -1;
+    }
+    if (verb == "STATUS")
+    {
+        AppointmentStatus status;
+        if (command.fieldCount != 3 || !command.integer(1, first) ||
+            !parseEnumField(command, 2, status))
+        {
+            return false;
+        }
+        error = "appointment not found";
+        return hospital.updateAppointmentStatus(first, status);
+    }
+    if (verb == "EMERGENCY")
+    {
+        if (command.fieldCount != 2 || !command.integer(1, first))
+        {
+            return false;
+        }
+        error = "patient not found or already in the emergency queue";
+        return hospital.addEmergency(first);
+    }
+    if (verb == "PRIORITY")
+    {
+        EmergencyPriority priority;
+        if (command.fieldCount != 3 || !command.integer(1, first) ||
+            !parseEnumField(command, 2, priority))
+        {
+            return false;
+        }
+        hospital.setEmergencyPriority(first, priority);
+        return true;
+    }
+    if (verb == "TREAT")
+    {
+        resultId = hospital.handleEmergency();
+        error = "no emergencies in queue";
+        return resultId != -1;
+    }
+    if (verb == "TEST")
+    {
+        if (command.fieldCount != 3 || !command.integer(1, first) || command.fields[2].empty())
+        {
+            return false;
+        }
+        error = "patient not found";
+        return hospital.requestTest(first, command.fields[2]);
+    }
+    if (verb == "LAB")
+    {
+        if (command.fieldCount != 1)
+        {
+            return false;
+        }
+        // Results are written back in the order the tests were sent, whichever lane ran them
+        hospital.sendTestsToLab();
+        resultId = hospital.collectTestResults(true);
+        return true;
+    }
+    if (verb == "LANES")
+    {
+        if (command.fieldCount != 2 || !command.integer(1, first) || first < 1)
+        {
+            return false;
+        }
+        hospital.setLabLanes(first);
+        return true;
+    }
+    if (verb == "REMOVE")
+    {
+        if (command.fieldCount != 2 || !command.integer(1, first))
+        {
+            return false;
+        }
+        error = "patient not found";
+        return hospital.removePatient(first);
+    }
+    if (verb == "EXPORT")
+    {
+        if (command.fieldCount < 2 || command.fieldCount > 3 || !command.integer(1, first) ||
+            (command.fieldCount == 3 && command.fields[2] != "MOVE"))
+        {
+            return false;
+        }
+        string record;
+        error = "patient not found or cannot be moved";
+        if (!hospital.exportPatient(first, record, command.fieldCount == 3))
+        {
+            return false;
+        }
+        appendHex(resultText, record);
+        return true;
+    }
+    if (verb == "METRICS")
+    {
+        if (command.fieldCount > 2)
+        {
+            return false;
+        }
+        if (command.fieldCount == 1)
+        {
+            hospital.displayMetrics();
+            return true;
+        }
+        error = "cannot write metrics file";
+        return hospital.writeMetricsFile(string(command.fields[1]));
+    }
+    if (verb == "IMPORT")
+    {
+        string record;
+        if (command.fieldCount != 2 || !decodeHex(command.fields[1], record))
+        {
+            return false;
+        }
+        resultId = hospital.importPatient(record);
+        error = "bad patient record";
+        return resultId != -1;
+    }
+    error = "unknown command";
+    return false;
+}
+
+// [Mazen Mohamed] Number of commands run, blank lines and comments excluded
+long long BatchRunner::getCommandCount() const
+{
+    return succeeded + failed;
+}
+
+// [Mazen Mohamed] Number of commands that were rejected
+long long BatchRunner::getFailedCount() const
+{
+    return failed;
+}
+
+// [Mazen Mohamed] Number of input bytes processed
+long long BatchRunner::getBytesRead() const
+{
+    return bytesRead;
+}
+
+// [Mazen Mohamed] Batch mode entry point: restore state, run the file (or
+// stdin for "-"), make the log durable, checkpoint, and report throughput on
+// stderr. With a tap path the changes are also published to that shared feed.
+int runBatch(const string &path, const string &snapshotPath, const string &walPath, const string &tapPath = string())
+{
+    // Bulk operations and the closing checkpoint share the patients out in
+    // chunks of 4096 (the snapshot encoding grain), so a hospital gets one
+    // worker per chunk, up to one per core, and a small one runs serially
+    ExtendedHospital hospital;
+    auto sizeWorkers = [&hospital]()
+    {
+        int chunks = (hospital.getPatientCount() + 4095) / 4096;
+        hospital.setWorkerThreads(min((int)max(1u, thread::hardware_concurrency()), chunks));
+    };
+    if (!hospital.recover(snapshotPath, walPath))
+    {
+        cerr << "Could not restore hospital state from " << snapshotPath << " and " << walPath << "." << endl;
+        return 1;
+    }
+    sizeWorkers();
+    // 2^16 events (2 MB) let a reader fall a good way behind before it loses any
+    if (!tapPath.empty() && !hospital.openChangeFeed(1 << 16, tapPath))
+    {
+        return 1;
+    }
+
+    // Answers acknowledge mutations, so none goes out before the log holds them
+    BufferedOutput output(stdout, [&hospital]()
+                          { return hospital.syncWriteAheadLog(); });
+    streambuf *console = cout.rdbuf(&output);
+    BatchRunner runner(hospital);
+    auto start = chrono::steady_clock::now();
+    bool opened = true;
+    if (path == "-")
+    {
+#ifndef _WIN32
+        runner.runStream(fileno(stdin), [&output]()
+                         { return output.drain(); });
+#else
+        runner.runStream(_fileno(stdin), [&output]()
+                         { return output.drain(); });
+#endif
+    }
+    else
+    {
+        opened = runner.runFile(path);
+    }
+    bool durable = output.drain();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cout.rdbuf(console);
+    if (!durable)
+    {
+        cerr << "Could not write the write-ahead log " << walPath << "; answers withheld." << endl;
+        return 1;
+    }
+
+    if (!opened)
+    {
+        cerr << "Could not open batch file " << path << "." << endl;
+        return 1;
+    }
+    sizeWorkers();
+    if (!hospital.checkpoint(snapshotPath))
+    {
+        cerr << "Could not write snapshot " << snapshotPath << "." << endl;
+        return 1;
+    }
+
+    long long commands = runner.getCommandCount();
+    cerr << "Batch: " << commands << " commands, " << runner.getFailedCount() << " failed, "
+         << (long long)(seconds * 1000.0) << " ms, "
+         << (long long)(seconds > 0 ? commands / seconds : 0) << " commands/s, "
+         << (seconds > 0 ? runner.getBytesRead() / seconds / 1048576.0 : 0) << " MB/s" << endl;
+    return runner.getFailedCount() == 0 ? 0 : 2;
+}
+
+// [Mazen Mohamed] Report mode entry point: restore state without touching the
+// data files and write one listing (patients, doctors or appointments) to
+// stdout as text, csv or json
+int runReport(const string &listing, const string &formatName, const string &snapshotPath, const string &walPath)
+{
+    static constexpr string_view FORMAT_NAMES[] = {"text", "csv", "json"};
+    const string_view *found = find(begin(FORMAT_NAMES), end(FORMAT_NAMES), formatName);
+    if (found == end(FORMAT_NAMES) || (listing != "patients" && listing != "doctors" && listing != "appointments"))
+    {
+        cerr << "Usage: --report patients|doctors|appointments [text|csv|json]" << endl;
+        return 1;
+    }
+    ReportFormat format = (ReportFormat)(found - begin(FORMAT_NAMES));
+
+    // Recovery notes would end up in the middle of the report
+    NullBuffer sink;
+    streambuf *console = cout.rdbuf(&sink);
+    ExtendedHospital hospital;
+    bool restored = hospital.recoverReadOnly(snapshotPath, walPath);
+    cout.rdbuf(console);
+    if (!restored)
+    {
+        cerr << "Could not restore hospital state from " << snapshotPath << " and " << walPath << "." << endl;
+        return 1;
+    }
+    if (listing == "patients")
+    {
+        hospital.displayAllPatients(format);
+    }
+    else if (listing == "doctors")
+    {
+        hospital.displayAllDoctors(format);
+    }
+    else
+    {
+        hospital.displayAllAppointments(format);
+    }
+    return 0;
+}
+
+// [Mazen Mohamed] Change tap reader: print the events of the feed shared
+// through tapPath, starting with the oldest it holds, until its writer closes it
+int runChangeFollower(const string &tapPath)
+{
+    ChangeFeed feed;
+    if (!feed.attach(tapPath))
+    {
+        cerr << "Could not open change feed tap " << tapPath << "." << endl;
+        return 1;
+    }
+    ChangeSubscriber subscriber(feed, true);
+    ChangeEvent event;
+    string text;
+    while (true)
+    {
+        // Checked first, so the events published before the close are still read
+        bool closed = feed.isClosed();
+        while (subscriber.poll(event))
+        {
+            appendChangeText(text, event);
+            if (text.size() >= (1 << 16))
+            {
+                fwrite(text.data(), 1, text.size(), stdout);
+                text.clear();
+            }
+        }
+        fwrite(text.data(), 1, text.size(), stdout);
+        fflush(stdout);
+        text.clear();
+        if (closed)
+        {
+            break;
+        }
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    if (subscriber.getMissed() > 0)
+    {
+        cerr << "Missed " << subscriber.getMissed() << " changes that were overwritten before they were read." << endl;
+    }
+    return 0;
+}
+
+// ========== HOSPITAL FEDERATION ========== //
+// [Mazen Mohamed] Several hospitals ("shards") behind one router, each owning
+// part of the patients. Shards speak the batch command protocol, so a shard
+// can be an ExtendedHospital in this process (LocalShard) or a shard server
+// process behind a Unix socket (RemoteShard), and the router works the same
+// over both. The router hands out federation-wide IDs and keeps a directory
+// from them to the shard and the ID the patient, doctor or appointment has there.
+
+// [Mazen Mohamed] Answer to one shard command; text holds the EXPORT record or the error
+struct ShardAnswer
+{
+    bool ok;
+    int id;
+    string text;
+};
+
+// [Mazen Mohamed] Read an answer line written by BatchRunner
+bool parseShardAnswer(string_view line, ShardAnswer &answer)
+{
+    answer.ok = line.compare(0, 3, "ok ") == 0;
+    answer.id = -1;
+    answer.text.clear();
+    if (!answer.ok)
+    {
+        size_t colon = line.find(": ");
+        answer.text = colon == string_view::npos ? string(line) : string(line.substr(colon + 2));
+        return line.compare(0, 6, "error ") == 0;
+    }
+    // "ok <line>" followed by an optional ID or text result
+    size_t space = line.find(' ', 3);
+    if (space == string_view::npos)
+    {
+        return true;
+    }
+    string_view result = line.substr(space + 1);
+    BatchCommand field;
+    if (!field.parse(result) || !field.integer(0, answer.id))
+    {
+        answer.text = string(result);
+    }
+    return true;
+}
+
+// [Mazen Mohamed] A hospital the federation routes commands to
+// Commands are pipelined: send() queues a batch command line and receive()
+// returns the answers in the order the commands were sent.
+class HospitalShard
+{
+public:
+    virtual ~HospitalShard() = default;
+
+    virtual void send(const string &command) = 0;
+    // False when the shard cannot be reached
+    virtual bool receive(ShardAnswer &answer) = 0;
+
+    ShardAnswer call(const string &command);
+};
+
+// [Mazen Mohamed] Send one command and wait for its answer
+ShardAnswer HospitalShard::call(const string &command)
+{
+    send(command);
+    ShardAnswer answer;
+    if (!receive(answer))
+    {
+        answer = {false, -1, "shard unreachable"};
+    }
+    return answer;
+}
+
+// [Mazen Mohamed] Shard held in this process; commands run as they are sent
+class LocalShard : public HospitalShard
+{
+private:
+    ExtendedHospital hospital;
+    stringstream answers;
+    BatchRunner runner;
+
+public:
+    LocalShard();
+
+    void send(const string &command) override;
+    bool receive(ShardAnswer &answer) override;
+    ExtendedHospital &getHospital();
+};
+
+// [Mazen Mohamed] Create an empty in-process shard
+LocalShard::LocalShard() : runner(hospital, answers)
+{
+}
+
+// [Mazen Mohamed] Run the command now and keep its answer for receive()
+void LocalShard::send(const string &command)
+{
+    runner.runBuffer(command.data(), command.size(), true);
+}
+
+// [Mazen Mohamed] Next kept answer; the buffer is emptied once all are read
+bool LocalShard::receive(ShardAnswer &answer)
+{
+    string line;
+    if (!getline(answers, line))
+    {
+        return false;
+    }
+    if (answers.peek() == EOF)
+    {
+        answers.str("");
+        answers.clear();
+    }
+    return parseShardAnswer(line, answer);
+}
+
+// [Mazen Mohamed] The hospital behind this shard
+ExtendedHospital &LocalShard::getHospital()
+{
+    return hospital;
+}
+
+#ifndef _WIN32
+// [Mazen Mohamed] Shard served by another process over a Unix socket
+// Commands are buffered and written in large pieces. While writing, answers
+// already sent back are read as well, so a long pipeline cannot fill both
+// socket buffers and stall the two processes on each other.
+class RemoteShard : public HospitalShard
+{
+private:
+    int socketFd;
+    string outgoing;
+    string incoming;
+    size_t incomingPos;
+
+    bool pump(bool wantAnswer);
+
+public:
+    RemoteShard(const string &socketPath, int connectTimeoutMs = 5000);
+    ~RemoteShard();
+    RemoteShard(const RemoteShard &) = delete;
+    RemoteShard &operator=(const RemoteShard &) = delete;
+
+    bool isConnected() const;
+    void send(const string &command) override;
+    bool receive(ShardAnswer &answer) override;
+};
+
+// [Mazen Mohamed] Connect to the shard server at socketPath, retrying while it starts up
+RemoteShard::RemoteShard(const string &socketPath, int connectTimeoutMs) : socketFd(-1), incomingPos(0)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        cout << "Socket path " << socketPath << " is too long." << endl;
+        return;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(connectTimeoutMs);
+    while (true)
+    {
+        socketFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (socketFd != -1 && connect(socketFd, (sockaddr *)&address, sizeof(address)) == 0)
+        {
+            return;
+        }
+        if (socketFd != -1)
+        {
+            close(socketFd);
+            socketFd = -1;
+        }
+        if (chrono::steady_clock::now() >= deadline)
+        {
+            cout << "Could not connect to shard at " << socketPath << "." << endl;
+            return;
+        }
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+}
+
+// [Mazen Mohamed] Write out queued commands and hang up; the server then exits
+RemoteShard::~RemoteShard()
+{
+    if (socketFd != -1)
+    {
+        pump(false);
+        close(socketFd);
+    }
+}
+
+// [Mazen Mohamed] True once connected, until the server goes away
+bool RemoteShard::isConnected() const
+{
+    return socketFd != -1;
+}
+
+// [Mazen Mohamed] Queue a command; large queues are written out right away
+void RemoteShard::send(const string &command)
+{
+    outgoing += command;
+    outgoing += '\n';
+    if (outgoing.size() >= (1 << 16))
+    {
+        pump(false);
+    }
+}
+
+// [Mazen Mohamed] Write queued commands and read answers until the queue is
+// written and, with wantAnswer set, a complete answer line has arrived
+bool RemoteShard::pump(bool wantAnswer)
+{
+#ifdef MSG_NOSIGNAL
+    const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    const int SEND_FLAGS = 0;
+#endif
+    size_t written = 0;
+    while (socketFd != -1)
+    {
+        bool haveAnswer = incoming.find('\n', incomingPos) != string::npos;
+        if (written == outgoing.size() && (!wantAnswer || haveAnswer))
+        {
+            break;
+        }
+        pollfd events = {socketFd, (short)(POLLIN | (written < outgoing.size() ? POLLOUT : 0)), 0};
+        if (poll(&events, 1, -1) < 0)
+        {
+            continue;
+        }
+        if (events.revents & POLLIN)
+        {
+            char buffer[1 << 16];
+            ssize_t count = read(socketFd, buffer, sizeof(buffer));
+            if (count <= 0)
+            {
+                close(socketFd);
+                socketFd = -1;
+                break;
+            }
+            if (incomingPos * 2 >= incoming.size())
+            {
+                incoming.erase(0, incomingPos);
+                incomingPos = 0;
+            }
+            incoming.append(buffer, (size_t)count);
+        }
+        else if (events.revents & POLLOUT)
+        {
+            ssize_t count = ::send(socketFd, outgoing.data() + written, outgoing.size() - written, SEND_FLAGS);
+            if (count < 0)
+            {
+                close(socketFd);
+                socketFd = -1;
+                break;
+            }
+            written += (size_t)count;
+        }
+        else if (events.revents & (POLLERR | POLLHUP))
+        {
+            close(socketFd);
+            socketFd = -1;
+        }
+    }
+    outgoing.erase(0, written);
+    return socketFd != -1;
+}
+
+// [Mazen Mohamed] Next answer, in the order the commands were sent
+bool RemoteShard::receive(ShardAnswer &answer)
+{
+    size_t newline = incoming.find('\n', incomingPos);
+    if (newline == string::npos)
+    {
+        pump(true);
+        newline = incoming.find('\n', incomingPos);
+        if (newline == string::npos)
+        {
+            return false;
+        }
+    }
+    string_view line(incoming.data() + incomingPos, newline - incomingPos);
+    incomingPos = newline + 1;
+    return parseShardAnswer(line, answer);
+}
+
+// [Mazen Mohamed] Shard server entry point: serve one router connection on
+// socketPath with a hospital restored from dataPrefix.snapshot/.wal (in
+// memory only when dataPrefix is empty), then checkpoint and exit when the
+// router hangs up. Console messages are dropped; answers carry the outcome.
+int runShardServer(const string &socketPath, const string &dataPrefix)
+{
+    signal(SIGPIPE, SIG_IGN);
+    NullBuffer sink;
+    streambuf *console = cout.rdbuf(&sink);
+    ExtendedHospital hospital;
+    if (!dataPrefix.empty() && !hospital.recover(dataPrefix + ".snapshot", dataPrefix + ".wal"))
+    {
+        cout.rdbuf(console);
+        cerr << "Could not restore shard state from " << dataPrefix << "." << endl;
+        return 1;
+    }
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == -1 || socketPath.size() >= sizeof(address.sun_path))
+    {
+        cout.rdbuf(console);
+        cerr << "Could not create shard socket " << socketPath << "." << endl;
+        return 1;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+    unlink(socketPath.c_str());
+    if (bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 1) != 0)
+    {
+        cout.rdbuf(console);
+        cerr << "Could not listen on shard socket " << socketPath << "." << endl;
+        close(listener);
+        return 1;
+    }
+    int connection = accept(listener, nullptr, nullptr);
+    close(listener);
+    unlink(socketPath.c_str());
+    if (connection == -1)
+    {
+        cout.rdbuf(console);
+        return 1;
+    }
+
+    // Answers to everything in one read go back in one write, after the log
+    // holds their mutations. The router takes silence for a failure, which is
+    // what these answers are once their log records are not durable.
+    FILE *stream = fdopen(connection, "w");
+    {
+        BufferedOutput output(stream, [&hospital]()
+                              { return hospital.syncWriteAheadLog(); });
+        ostream answers(&output);
+        BatchRunner runner(hospital, answers);
+        runner.runStream(connection, [&output]()
+                         { return output.drain(); });
+    }
+    fclose(stream);
+    if (!dataPrefix.empty())
+    {
+        hospital.checkpoint(dataPrefix + ".snapshot");
+    }
+    cout.rdbuf(console);
+    return 0;
+}
+#endif
+
+// [Mazen Mohamed] How the federation picks the home shard of a new patient:
+// a hash of the patient ID spreads them evenly, by campus puts them on the
+// shard of the campus they registered at
+enum ShardPolicy
+{
+    SHARD_BY_PATIENT_HASH,
+    SHARD_BY_CAMPUS
+};
+
+// [Mazen Mohamed] New patient for HospitalFederation::registerPatients
+struct PatientRegistration
+{
+    string name;
+    int age;
+    string contact;
+    int campus;
+};
+
+// [Mazen Mohamed] Router over a set of hospital shards
+// Every patient has a home shard holding the record. A doctor on another
+// shard sees the patient through a visitor copy registered on the doctor's
+// shard at the first booking, and the booking is noted in the home record,
+// so callers book across shards as if there were one hospital. A visitor
+// copy is a read-only chart as of that first booking: later changes go to
+// the home record only, which stays the one to trust. Rebalancing moves
+// idle patients, records included, to the emptier shards.
+//
+// The directory of which shard holds which ID lives in the router. With
+// openDirectory() it is kept in a snapshot and a log of its own, like a
+// hospital's state. An entry is logged once the shard has answered, so a
+// crash in between can leave a record the directory does not know about,
+// but never a directory entry for a record that was not there.
+class HospitalFederation
+{
+private:
+    // Where a federation-wide ID lives; shard is -1 once removed
+    struct ShardLocation
+    {
+        int shard;
+        int localId;
+    };
+
+    vector<unique_ptr<HospitalShard>> shards;
+    ShardPolicy policy;
+
+    // Indexed by federation ID; IDs start at 1, so slot 0 is never used
+    vector<ShardLocation> patients;
+    vector<ShardLocation> doctors;
+    vector<ShardLocation> appointments;
+    // Home patients per shard
+    vector<int> patientCounts;
+    // (patient ID, shard) -> ID of the patient's visitor copy on that shard
+    map<pair<int, int>, int> visitors;
+
+    // Files of the directory, empty while it is only kept in memory
+    string directoryPrefix;
+    unique_ptr<WriteAheadLog> directoryLog;
+    uint32_t directoryEpoch;
+
+    static const char DIRECTORY_MAGIC[8];
+
+    void applyEntry(WalRecordType type, int id, int shard, int localId);
+    void setEntry(WalRecordType type, int id, int shard, int localId);
+    string encodeDirectory(uint32_t epoch) const;
+    bool loadDirectory(const string &path);
+    bool replayDirectoryLog(const string &path, bool &appendable);
+    int homeShardFor(int patientId, int campus) const;
+    const ShardLocation *findPatient(int patientId) const;
+    const ShardLocation *findDoctor(int doctorId) const;
+    int localPatientOn(int shard, int patientId);
+    bool check(int shard, const ShardAnswer &answer) const;
+    static string field(string_view text);
+
+public:
+    explicit HospitalFederation(ShardPolicy policy = SHARD_BY_PATIENT_HASH);
+
+    int addShard(unique_ptr<HospitalShard> shard);
+    bool openDirectory(const string &prefix, int syncWindowMs = 10);
+    bool checkpointDirectory();
+    bool syncDirectory();
+    int getShardCount() const;
+    int getPatientCount(int shard) const;
+    bool locatePatient(int patientId, int &shard, int &localId) const;
+
+    int registerPatient(string_view name, int age, string_view contact, int campus = -1);
+    vector<int> registerPatients(const vector<PatientRegistration> &registrations);
+    int addDoctor(string_view name, Department dept, int campus = -1);
+    bool removePatient(int patientId);
+    bool admitPatient(int patientId, RoomType type);
+    bool dischargePatient(int patientId);
+    bool addMedicalRecord(int patientId, string_view record);
+    int addMedicalRecords(const vector<int> &patientIds, string_view record);
+    bool requestTest(int patientId, string_view testName);
+    bool bookAppointment(int doctorId, int patientId);
+    int scheduleAppointment(int doctorId, int patientId, string_view dateTime);
+    bool updateAppointmentStatus(int appointmentId, AppointmentStatus status);
+
+    bool movePatient(int patientId, int shard);
+    int rebalance();
+    void displayShards() const;
+};
+
+const char HospitalFederation::DIRECTORY_MAGIC[8] = {'H', 'M', 'S', 'F', 'D', 'I', 'R', '\1'};
+
+// [Mazen Mohamed] Create a federation without shards
+HospitalFederation::HospitalFederation(ShardPolicy policy) : policy(policy), directoryEpoch(0)
+{
+    patients.push_back({-1, -1});
+    doctors.push_back({-1, -1});
+    appointments.push_back({-1, -1});
+}
+
+// [Mazen Mohamed] Add a shard; returns its index, which is also its campus number.
+// Existing patients stay where they are until the next rebalance.
+int HospitalFederation::addShard(unique_ptr<HospitalShard> shard)
+{
+    shards.push_back(move(shard));
+    patientCounts.push_back(0);
+    return (int)shards.size() - 1;
+}
+
+// [Mazen Mohamed] Number of shards
+int HospitalFederation::getShardCount() const
+{
+    return (int)shards.size();
+}
+
+// [Mazen Mohamed] Number of patients whose home is shard
+int HospitalFederation::getPatientCount(int shard) const
+{
+    return shard >= 0 && shard < (int)patientCounts.size() ? patientCounts[shard] : 0;
+}
+
+// [Mazen Mohamed] Home shard of a new patient, -1 for an unknown campus
+int HospitalFederation::homeShardFor(int patientId, int campus) const
+{
+    if (shards.empty())
+    {
+        return -1;
+    }
+    if (policy == SHARD_BY_CAMPUS)
+    {
+        return campus >= 0 && campus < (int)shards.size() ? campus : -1;
+    }
+    // Mix the bits so consecutive IDs do not fill the shards round-robin in step
+    uint64_t hash = (uint64_t)patientId * 0x9E3779B97F4A7C15ULL;
+    return (int)((hash >> 32) % shards.size());
+}
+
+// [Mazen Mohamed] Directory entry of a patient, nullptr if unknown or removed
+const HospitalFederation::ShardLocation *HospitalFederation::findPatient(int patientId) const
+{
+    if (patientId <= 0 || patientId >= (int)patients.size() || patients[patientId].shard == -1)
+    {
+        cout << "Patient with ID " << patientId << " not found." << endl;
+        return nullptr;
+    }
+    return &patients[patientId];
+}
+
+// [Mazen Mohamed] Directory entry of a doctor, nullptr if unknown
+const HospitalFederation::ShardLocation *HospitalFederation::findDoctor(int doctorId) const
+{
+    if (doctorId <= 0 || doctorId >= (int)doctors.size() || doctors[doctorId].shard == -1)
+    {
+        cout << "Doctor with ID " << doctorId << " not found." << endl;
+        return nullptr;
+    }
+    return &doctors[doctorId];
+}
+
+// [Mazen Mohamed] Home shard and ID there of a patient
+bool HospitalFederation::locatePatient(int patientId, int &shard, int &localId) const
+{
+    if (patientId <= 0 || patientId >= (int)patients.size() || patients[patientId].shard == -1)
+    {
+        return false;
+    }
+    shard = patients[patientId].shard;
+    localId = patients[patientId].localId;
+    return true;
+}
+
+// [Mazen Mohamed] Report a rejected command; true if the answer is ok
+bool HospitalFederation::check(int shard, const ShardAnswer &answer) const
+{
+    if (!answer.ok)
+    {
+        cout << "Shard " << shard << " rejected the command: " << answer.text << endl;
+    }
+    return answer.ok;
+}
+
+// [Mazen Mohamed] A text field safe to put in a command line
+string HospitalFederation::field(string_view text)
+{
+    string safe(text);
+    replace_if(safe.begin(), safe.end(), [](char c)
+               { return c == '|' || c == '\n' || c == '\r'; }, ' ');
+    return safe;
+}
+
+// [Mazen Mohamed] ID of the patient on shard: the record itself on the home
+// shard, elsewhere a visitor copy, registered on first use. -1 on failure.
+int HospitalFederation::localPatientOn(int shard, int patientId)
+{
+    const ShardLocation &home = patients[patientId];
+    if (home.shard == shard)
+    {
+        return home.localId;
+    }
+    auto visitor = visitors.find({patientId, shard});
+    if (visitor != visitors.end())
+    {
+        return visitor->second;
+    }
+    ShardAnswer exported = shards[home.shard]->call("EXPORT|" + to_string(home.localId));
+    if (!check(home.shard, exported))
+    {
+        return -1;
+    }
+    ShardAnswer imported = shards[shard]->call("IMPORT|" + exported.text);
+    if (!check(shard, imported))
+    {
+        return -1;
+    }
+    setEntry(WAL_DIRECTORY_VISITOR, patientId, shard, imported.id);
+    return imported.id;
+}
+
+// [Mazen Mohamed] Register a patient on their home shard; campus is only
+// used with SHARD_BY_CAMPUS. Returns the federation-wide ID or -1.
+int HospitalFederation::registerPatient(string_view name, int age, string_view contact, int campus)
+{
+    vector<int> ids = registerPatients({{string(name), age, string(contact), campus}});
+    return ids[0];
+}
+
+// [Mazen Mohamed] Register many patients at once
+// The registrations for every shard are sent before any answer is read, so
+// the shards work through their share at the same time.
+vector<int> HospitalFederation::registerPatients(const vector<PatientRegistration> &registrations)
+{
+    vector<int> ids(registrations.size(), -1);
+    vector<int> homes(registrations.size(), -1);
+    int nextId = (int)patients.size();
+    for (size_t i = 0; i < registrations.size(); i++)
+    {
+        const PatientRegistration &registration = registrations[i];
+        homes[i] = homeShardFor(nextId, registration.campus);
+        if (homes[i] == -1)
+        {
+            cout << "No shard for campus " << registration.campus << "." << endl;
+            continue;
+        }
+        ids[i] = nextId++;
+        shards[homes[i]]->send("REGISTER|" + field(registration.name) + "|" + to_string(registration.age) + "|" +
+                               field(registration.contact));
+    }
+    patients.resize(nextId, {-1, -1});
+    for (size_t i = 0; i < registrations.size(); i++)
+    {
+        if (ids[i] == -1)
+        {
+            continue;
+        }
+        ShardAnswer answer;
+        if (!shards[homes[i]]->receive(answer))
+        {
+            answer = {false, -1, "shard unreachable"};
+        }
+        if (!check(homes[i], answer))
+        {
+            ids[i] = -1;
+            continue;
+        }
+        setEntry(WAL_DIRECTORY_PATIENT, ids[i], homes[i], answer.id);
+        patientCounts[homes[i]]++;
+    }
+    return ids;
+}
+
+// [Mazen Mohamed] Add a doctor on the shard of their campus (by ID hash when
+// campus is -1); returns the federation-wide ID or -1
+int HospitalFederation::addDoctor(string_view name, Department dept, int campus)
+{
+    int doctorId = (int)doctors.size();
+    int shard = campus == -1 && !shards.empty() ? doctorId % (int)shards.size() : campus;
+    if (shard < 0 || shard >= (int)shards.size())
+    {
+        cout << "No shard for campus " << campus << "." << endl;
+        return -1;
+    }
+    ShardAnswer answer = shards[shard]->call("DOCTOR|" + field(name) + "|" + to_string((int)dept));
+    if (!check(shard, answer))
+    {
+        return -1;
+    }
+    setEntry(WAL_DIRECTORY_DOCTOR, doctorId, shard, answer.id);
+    return doctorId;
+}
+
+// [Mazen Mohamed] Remove a patient along with their visitor copies
+bool HospitalFederation::removePatient(int patientId)
+{
+    const ShardLocation *home = findPatient(patientId);
+    if (home == nullptr)
+    {
+        return false;
+    }
+    int shard = home->shard;
+    if (!check(shard, shards[shard]->call("REMOVE|" + to_string(home->localId))))
+    {
+        return false;
+    }
+    auto visitor = visitors.lower_bound({patientId, 0});
+    while (visitor != visitors.end() && visitor->first.first == patientId)
+    {
+        int visited = visitor->first.second;
+        check(visited, shards[visited]->call("REMOVE|" + to_string(visitor->second)));
+        ++visitor;
+        setEntry(WAL_DIRECTORY_VISITOR, patientId, visited, -1);
+    }
+    patientCounts[shard]--;
+    setEntry(WAL_DIRECTORY_PATIENT, patientId, -1, -1);
+    return true;
+}
+
+// [Mazen Mohamed] Admit a patient on their home shard
+bool HospitalFederation::admitPatient(int patientId, RoomType type)
+{
+    const ShardLocation *home = findPatient(patientId);
+    return home != nullptr &&
+           check(home->shard, shards[home->shard]->call("ADMIT|" + to_string(home->localId) + "|" + to_string((int)type)));
+}
+
+// [Mazen Mohamed] Discharge a patient on their home shard
+bool HospitalFederation::dischargePatient(int patientId)
+{
+    const ShardLocation *home = findPatient(patientId);
+    return home != nullptr &&
+           check(home->shard, shards[home->shard]->call("DISCHARGE|" + to_string(home->localId)));
+}
+
+// [Mazen Mohamed] Add a note to a patient's home record
+bool HospitalFederation::addMedicalRecord(int patientId, string_view record)
+{
+    const ShardLocation *home = findPatient(patientId);
+    return home != nullptr &&
+           check(home->shard, shards[home->shard]->call("RECORD|" + to_string(home->localId) + "|" + field(record)));
+}
+
+// [Mazen Mohamed] Add the same note to many patients, pipelined like
+// registerPatients; returns how many records were added
+int HospitalFederation::addMedicalRecords(const vector<int> &patientIds, string_view record)
+{
+    string text = field(record);
+    vector<int> sentTo;
+    sentTo.reserve(patientIds.size());
+    for (int patientId : patientIds)
+    {
+        const ShardLocation *home = findPatient(patientId);
+        if (home != nullptr)
+        {
+            shards[home->shard]->send("RECORD|" + to_string(home->localId) + "|" + text);
+            sentTo.push_back(home->shard);
+        }
+    }
+    int added = 0;
+    for (int shard : sentTo)
+    {
+        ShardAnswer answer;
+        if (shards[shard]->receive(answer) && check(shard, answer))
+        {
+            added++;
+        }
+    }
+    return added;
+}
+
+// [Mazen Mohamed] Request a test on the patient's home shard
+bool HospitalFederation::requestTest(int patientId, string_view testName)
+{
+    const ShardLocation *home = findPatient(patientId);
+    return home != nullptr &&
+           check(home->shard, shards[home->shard]->call("TEST|" + to_string(home->localId) + "|" + field(testName)));
+}
+
+// [Mazen Mohamed] Book a doctor for a patient, wherever each of them lives
+bool HospitalFederation::bookAppointment(int doctorId, int patientId)
+{
+    const ShardLocation *doctor = findDoctor(doctorId);
+    const ShardLocation *home = findPatient(patientId);
+    if (doctor == nullptr || home == nullptr)
+    {
+        return false;
+    }
+    int localPatient = localPatientOn(doctor->shard, patientId);
+    if (localPatient == -1 ||
+        !check(doctor->shard, shards[doctor->shard]->call("BOOK|" + to_string(doctor->localId) + "|" + to_string(localPatient))))
+    {
+        return false;
+    }
+    if (home->shard != doctor->shard)
+    {
+        addMedicalRecord(patientId, "Appointment booked with doctor " + to_string(doctorId) + " on campus " +
+                                        to_string(doctor->shard));
+    }
+    return true;
+}
+
+// [Mazen Mohamed] Schedule an appointment on the doctor's shard; returns the
+// federation-wide appointment ID or -1
+int HospitalFederation::scheduleAppointment(int doctorId, int patientId, string_view dateTime)
+{
+    const ShardLocation *doctor = findDoctor(doctorId);
+    const ShardLocation *home = findPatient(patientId);
+    if (doctor == nullptr || home == nullptr)
+    {
+        return -1;
+    }
+    int shard = doctor->shard;
+    int localPatient = localPatientOn(shard, patientId);
+    if (localPatient == -1)
+    {
+        return -1;
+    }
+    ShardAnswer answer = shards[shard]->call("SCHEDULE|" + to_string(doctor->localId) + "|" + to_string(localPatient) +
+                                             "|" + field(dateTime));
+    if (!check(shard, answer))
+    {
+        return -1;
+    }
+    int appointmentId = (int)appointments.size();
+    setEntry(WAL_DIRECTORY_APPOINTMENT, appointmentId, shard, answer.id);
+    if (home->shard != shard)
+    {
+        addMedicalRecord(patientId, "Appointment " + to_string(appointmentId) + " scheduled with doctor " +
+                                        to_string(doctorId) + " on campus " + to_string(shard) + " at " + field(dateTime));
+    }
+    return appointmentId;
+}
+
+// [Mazen Mohamed] Update an appointment on the shard that holds it
+bool HospitalFederation::updateAppointmentStatus(int appointmentId, AppointmentStatus status)
+{
+    if (appointmentId <= 0 || appointmentId >= (int)appointments.size())
+    {
+        cout << "Appointment with ID " << appointmentId << " not found." << endl;
+        return false;
+    }
+    const ShardLocation &appointment = appointments[appointmentId];
+    return check(appointment.shard, shards[appointment.shard]->call("STATUS|" + to_string(appointment.localId) + "|" +
+                                                                    to_string((int)status)));
+}
+
+// [Mazen Mohamed] Move a patient's record to another shard, e.g. a transfer
+// between campuses. Only idle patients move (see ExtendedHospital::exportPatient);
+// the federation-wide ID stays the same.
+bool HospitalFederation::movePatient(int patientId, int shard)
+{
+    const ShardLocation *home = findPatient(patientId);
+    if (home == nullptr || shard < 0 || shard >= (int)shards.size())
+    {
+        return false;
+    }
+    int source = home->shard;
+    if (source == shard)
+    {
+        return true;
+    }
+    // A visitor copy on the target would become a second record there
+    if (visitors.count({patientId, shard}) != 0)
+    {
+        return false;
+    }
+    ShardAnswer exported = shards[source]->call("EXPORT|" + to_string(home->localId) + "|MOVE");
+    if (!exported.ok)
+    {
+        return false;
+    }
+    ShardAnswer imported = shards[shard]->call("IMPORT|" + exported.text);
+    if (!check(shard, imported))
+    {
+        return false;
+    }
+    // The copy exists and the directory points at it, durably, before the
+    // original goes, so a failure never loses the record; if the original
+    // stays, the directory points back and the copy goes again instead
+    int sourceId = home->localId;
+    setEntry(WAL_DIRECTORY_PATIENT, patientId, shard, imported.id);
+    if (!syncDirectory() || !check(source, shards[source]->call("REMOVE|" + to_string(sourceId))))
+    {
+        setEntry(WAL_DIRECTORY_PATIENT, patientId, source, sourceId);
+        check(shard, shards[shard]->call("REMOVE|" + to_string(imported.id)));
+        return false;
+    }
+    patientCounts[source]--;
+    patientCounts[shard]++;
+    return true;
+}
+
+// [Mazen Mohamed] Even out the patients per shard, e.g. after adding shards
+// Patients move from the fullest to the emptiest shard, newest first, until
+// the counts differ by at most one or nobody on the fullest shard can move.
+// Campus placement is deliberate, so a campus federation is left alone.
+// Returns the number of patients moved.
+int HospitalFederation::rebalance()
+{
+    if (policy == SHARD_BY_CAMPUS || shards.size() < 2)
+    {
+        return 0;
+    }
+    vector<vector<int>> residents(shards.size());
+    for (int patientId = 1; patientId < (int)patients.size(); patientId++)
+    {
+        if (patients[patientId].shard != -1)
+        {
+            residents[patients[patientId].shard].push_back(patientId);
+        }
+    }
+
+    int moved = 0;
+    vector<bool> exhausted(shards.size(), false);
+    while (true)
+    {
+        int fullest = -1, emptiest = 0;
+        for (int shard = 0; shard < (int)shards.size(); shard++)
+        {
+            if (!exhausted[shard] && (fullest == -1 || patientCounts[shard] > patientCounts[fullest]))
+            {
+                fullest = shard;
+            }
+            if (patientCounts[shard] < patientCounts[emptiest])
+            {
+                emptiest = shard;
+            }
+        }
+        if (fullest == -1 || patientCounts[fullest] - patientCounts[emptiest] <= 1)
+        {
+            break;
+        }
+        vector<int> &candidates = residents[fullest];
+        bool movedOne = false;
+        while (!candidates.empty() && !movedOne)
+        {
+            int patientId = candidates.back();
+            candidates.pop_back();
+            movedOne = movePatient(patientId, emptiest);
+        }
+        if (movedOne)
+        {
+            moved++;
+        }
+        else
+        {
+            exhausted[fullest] = true;
+        }
+    }
+    return moved;
+}
+
+// [Mazen Mohamed] Display the number of home patients per shard
+void HospitalFederation::displayShards() const
+{
+    cout << "\n=== FEDERATION SHARDS ===" << endl;
+    cout << "Policy: " << (policy == SHARD_BY_CAMPUS ? "by campus" : "by patient ID hash") << endl;
+    for (size_t shard = 0; shard < shards.size(); shard++)
+    {
+        cout << "Shard " << shard << ": " << patientCounts[shard] << " patients" << endl;
+    }
+    cout << "Visitor copies: " << visitors.size() << endl;
+}
+
+// [Mazen Mohamed] Change one directory entry; localId -1 removes a visitor copy
+void HospitalFederation::applyEntry(WalRecordType type, int id, int shard, int localId)
+{
+    if (type == WAL_DIRECTORY_VISITOR)
+    {
+        if (localId == -1)
+        {
+            visitors.erase({id, shard});
+        }
+        else
+        {
+            visitors[{id, shard}] = localId;
+        }
+        return;
+    }
+    vector<ShardLocation> &entries = type == WAL_DIRECTORY_PATIENT ? patients
+                                     : type == WAL_DIRECTORY_DOCTOR ? doctors
+                                                                    : appointments;
+    if (id >= (int)entries.size())
+    {
+        entries.resize(id + 1, {-1, -1});
+    }
+    entries[id] = {shard, localId};
+}
+
+// [Mazen Mohamed] Change one directory entry and log the change
+void HospitalFederation::setEntry(WalRecordType type, int id, int shard, int localId)
+{
+    applyEntry(type, id, shard, localId);
+    if (directoryLog)
+    {
+        string payload;
+        putI32(payload, id);
+        putI32(payload, shard);
+        putI32(payload, localId);
+        directoryLog->append(type, payload);
+    }
+}
+
+// [Mazen Mohamed] Directory snapshot: magic[8] epoch:u32, then the patient,
+// doctor and appointment entries as <u32 count>(<i32 shard><i32 localId>)*,
+// the visitors as <u32 count>(<i32 patient><i32 shard><i32 localId>)* and
+// a checksum:u32 trailer like a hospital snapshot's
+string HospitalFederation::encodeDirectory(uint32_t epoch) const
+{
+    string out(DIRECTORY_MAGIC, sizeof(DIRECTORY_MAGIC));
+    putU32(out, epoch);
+    for (const vector<ShardLocation> *entries : {&patients, &doctors, &appointments})
+    {
+        putU32(out, (uint32_t)entries->size());
+        for (const ShardLocation &entry : *entries)
+        {
+            putI32(out, entry.shard);
+            putI32(out, entry.localId);
+        }
+    }
+    putU32(out, (uint32_t)visitors.size());
+    for (const auto &visitor : visitors)
+    {
+        putI32(out, visitor.first.first);
+        putI32(out, visitor.first.second);
+        putI32(out, visitor.second);
+    }
+    putChecksumTrailer(out);
+    return out;
+}
+
+// [Mazen Mohamed] Replace the directory with the snapshot at path
+bool HospitalFederation::loadDirectory(const string &path)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        cout << "Failed to read directory snapshot " << path << "." << endl;
+        return false;
+    }
+    BinaryReader in{file.data(), file.data() + file.size(), true};
+    const char *magic = in.skip(sizeof(DIRECTORY_MAGIC));
+    uint32_t epoch = in.u32();
+    if (!in.ok || memcmp(magic, DIRECTORY_MAGIC, sizeof(DIRECTORY_MAGIC)) != 0)
+    {
+        cout << "File " << path << " is not a directory snapshot." << endl;
+        return false;
+    }
+    if (!readChecksumTrailer(in, file.data(), file.size()))
+    {
+        cout << "Directory snapshot " << path << " is corrupt." << endl;
+        return false;
+    }
+    vector<ShardLocation> loaded[3];
+    for (vector<ShardLocation> &entries : loaded)
+    {
+        uint32_t count = in.u32();
+        if (!in.has((size_t)count * 2 * sizeof(int32_t)))
+        {
+            break;
+        }
+        entries.resize(count);
+        for (ShardLocation &entry : entries)
+        {
+            entry.shard = in.i32();
+            entry.localId = in.i32();
         }
     }
-    cout << "Doctor with ID " << doctorId << " not found." << endl;
+    map<pair<int, int>, int> loadedVisitors;
+    uint32_t visitorCount = in.u32();
+    for (uint32_t i = 0; i < visitorCount && in.ok; i++)
+    {
+        int patientId = in.i32();
+        int shard = in.i32();
+        loadedVisitors[{patientId, shard}] = in.i32();
+    }
+    if (!in.ok || loaded[0].empty() || loaded[1].empty() || loaded[2].empty())
+    {
+        cout << "Directory snapshot " << path << " is truncated." << endl;
+        return false;
+    }
+    patients = move(loaded[0]);
+    doctors = move(loaded[1]);
+    appointments = move(loaded[2]);
+    visitors = move(loadedVisitors);
+    directoryEpoch = epoch;
+    return true;
 }
 
-// [Mazen Mohamed] Display patient information
-void Hospital::displayPatientInfo(int patientId)
+// [Mazen Mohamed] Apply the directory log at path on top of the snapshot
+// Works like ExtendedHospital::replayWriteAheadLog: a log older than the
+// snapshot is skipped, a torn tail is cut off and a file that is no log is
+// moved aside. Returns false only when the log could not be cut.
+bool HospitalFederation::replayDirectoryLog(const string &path, bool &appendable)
 {
-    for (auto &patient : patients)
+    appendable = false;
+    size_t validBytes = 0;
+    size_t fileBytes = 0;
     {
-        if (patient.getId() == patientId)
+        MappedFile file;
+        if (!file.open(path))
+        {
+            return true;
+        }
+        fileBytes = file.size();
+
+        BinaryReader in{file.data(), file.data() + file.size(), true};
+        const char *magic = in.skip(sizeof(WriteAheadLog::MAGIC));
+        uint32_t epoch = in.u32();
+        if (!in.ok || memcmp(magic, WriteAheadLog::MAGIC, sizeof(WriteAheadLog::MAGIC)) != 0)
+        {
+            cout << "File " << path << " is not a directory log; starting a new one." << endl;
+            rename(path.c_str(), (path + ".corrupt").c_str());
+            return true;
+        }
+        if (epoch < directoryEpoch)
+        {
+            return true;
+        }
+
+        validBytes = in.cursor - file.data();
+        while (in.cursor < in.end)
         {
-            cout << "Patient ID: " << patient.getId() << endl;
-            cout << "Name: " << patient.getName() << endl;
-            cout << "Age: " << patient.getId() << endl;
-            cout << "Contact: " << patient.getName() << endl;
-            cout << "Admission Status: " << (patient.getAdmissionStatus() ? "Admitted" : "Not Admitted") << endl;
-            if (patient.getAdmissionStatus())
+            uint32_t length = in.u32();
+            uint8_t type = in.u8();
+            const char *payload = in.skip(length);
+            uint32_t sum = in.u32();
+            if (!in.ok || sum != WriteAheadLog::checksum(type, payload, length))
             {
-                cout << "Room Type: " << patient.getRoomType() << endl;
+                break;
             }
-            patient.displayHistory();
-            return;
+            validBytes = in.cursor - file.data();
+
+            // The payload starts with the time of the change, which the directory does not keep
+            BinaryReader record{payload, payload + length, true};
+            record.u64();
+            int id = record.i32();
+            int shard = record.i32();
+            int localId = record.i32();
+            if (!record.ok || id <= 0 || type < WAL_DIRECTORY_PATIENT || type > WAL_DIRECTORY_VISITOR)
+            {
+                cout << "Skipping unknown directory log record type " << (int)type << "." << endl;
+                continue;
+            }
+            applyEntry((WalRecordType)type, id, shard, localId);
         }
+        directoryEpoch = epoch;
+        appendable = true;
     }
-    cout << "Patient with ID " << patientId << " not found." << endl;
-}
-
-// [Mazen Mohamed] Display doctor information
-void Hospital::displayDoctorInfo(int doctorId)
-{
-    for (auto &doctor : doctors)
+    if (validBytes < fileBytes)
     {
-        if (doctor.getId() == doctorId)
+        cout << "Discarded " << (fileBytes - validBytes) << " bytes of incomplete directory log." << endl;
+        if (!truncateFileDurably(path, validBytes))
         {
-            cout << "Doctor ID: " << doctor.getId() << endl;
-            cout << "Name: " << doctor.getName() << endl;
-            cout << "Department: " << doctor.getDepartment() << endl;
-            return;
+            return false;
         }
     }
-    cout << "Doctor with ID " << doctorId << " not found." << endl;
+    return true;
 }
 
-// [Mazen Mohamed] Display all patients
-void Hospital::displayAllPatients()
+// [Mazen Mohamed] Keep the directory in prefix.snapshot and prefix.wal
+// Whatever those files hold replaces the directory in memory, and every
+// later change is logged. Add the shards the directory was saved with first,
+// in the same order. Returns false if the files cannot be used.
+bool HospitalFederation::openDirectory(const string &prefix, int syncWindowMs)
 {
-    cout << "===== ALL PATIENTS =====" << endl;
-    for (auto &patient : patients)
+    directoryLog.reset();
+    directoryEpoch = 0;
+    string snapshotPath = prefix + ".snapshot";
+    string walPath = prefix + ".wal";
+    if (ifstream(snapshotPath).good() && !loadDirectory(snapshotPath))
     {
-        cout << "ID: " << patient.getId() << " | Name: " << patient.getName() << " | Status: " << (patient.getAdmissionStatus() ? "Admitted" : "Not Admitted") << endl;
+        return false;
     }
-    cout << "========================" << endl;
-}
-
-// [Mazen Mohamed] Display all doctors
-void Hospital::displayAllDoctors()
-{
-    cout << "===== ALL DOCTORS =====" << endl;
-    for (auto &doctor : doctors)
+    bool appendable = false;
+    if (!replayDirectoryLog(walPath, appendable))
     {
-        cout << "ID: " << doctor.getId() << " | Name: " << doctor.getName() << " | Department: " << doctor.getDepartment() << endl;
+        return false;
     }
-    cout << "=======================" << endl;
-}
-
-// ========== EXTENDED HOSPITAL CLASS (Mazen's Task Extension) ========== //
-// [Mazen Mohamed] Extended Hospital class with additional functionality
-class ExtendedHospital : public Hospital
-{
-private:
-    vector<Appointment> appointments;
-    int appointmentCounter;
-    map<int, EmergencyPriority> emergencyPriorities;
-
-public:
-    ExtendedHospital();
-
-    int scheduleAppointment(int doctorId, int patientId, string dateTime);
-    void updateAppointmentStatus(int appointmentId, AppointmentStatus status);
-    void displayAppointmentInfo(int appointmentId);
-    void setEmergencyPriority(int patientId, EmergencyPriority priority);
-    vector<int> getEmergencyQueueByPriority();
-    void displayAllAppointments();
-};
 
-// [Mazen Mohamed] Extended Hospital constructor implementation
-ExtendedHospital::ExtendedHospital() : Hospital()
-{
-    appointmentCounter = 1;
-}
-
-// [Mazen Mohamed] Schedule a new appointment with date/time
-int ExtendedHospital::scheduleAppointment(int doctorId, int patientId, string dateTime)
-{
-    // Check if doctor exists
-    bool doctorExists = false;
-    for (const auto &doctor : doctors)
+    // Every entry must point at a shard this router has
+    int shardCount = (int)shards.size();
+    auto unknownShard = [shardCount](int shard)
     {
-        if (doctor.getId() == doctorId)
+        return shard < -1 || shard >= shardCount;
+    };
+    for (const vector<ShardLocation> *entries : {&patients, &doctors, &appointments})
+    {
+        for (const ShardLocation &entry : *entries)
         {
-            doctorExists = true;
-            break;
+            if (unknownShard(entry.shard))
+            {
+                cout << "The directory refers to shard " << entry.shard << ", but only " << shardCount
+                     << " shards were added." << endl;
+                return false;
+            }
         }
     }
-
-    if (!doctorExists)
+    for (const auto &visitor : visitors)
     {
-        cout << "Doctor with ID " << doctorId << " not found." << endl;
-        return -1;
+        if (visitor.first.second < 0 || unknownShard(visitor.first.second))
+        {
+            cout << "The directory refers to shard " << visitor.first.second << ", but only " << shardCount
+                 << " shards were added." << endl;
+            return false;
+        }
     }
-
-    // Check if patient exists
-    bool patientExists = false;
-    for (const auto &patient : patients)
+    fill(patientCounts.begin(), patientCounts.end(), 0);
+    for (const ShardLocation &entry : patients)
     {
-        if (patient.getId() == patientId)
+        if (entry.shard != -1)
         {
-            patientExists = true;
-            break;
+            patientCounts[entry.shard]++;
         }
     }
 
-    if (!patientExists)
+    if (!appendable)
     {
-        cout << "Patient with ID " << patientId << " not found." << endl;
-        return -1;
+        // A stale log would hide new records behind its old epoch
+        remove(walPath.c_str());
     }
-
-    // Create and add appointment
-    Appointment newAppointment(appointmentCounter, doctorId, patientId, dateTime);
-    appointments.push_back(newAppointment);
-
-    // Also book appointment in the base class system
-    bookAppointment(doctorId, patientId);
-
-    return appointmentCounter++;
-}
-
-// [Mazen Mohamed] Update appointment status
-void ExtendedHospital::updateAppointmentStatus(int appointmentId, AppointmentStatus status)
-{
-    for (auto &appointment : appointments)
+    directoryLog.reset(new WriteAheadLog());
+    if (!directoryLog->open(walPath, directoryEpoch, syncWindowMs))
     {
-        if (appointment.getAppointmentId() == appointmentId)
-        {
-            appointment.setStatus(status);
-            return;
-        }
+        directoryLog.reset();
+        return false;
     }
-    cout << "Appointment with ID " << appointmentId << " not found." << endl;
+    directoryPrefix = prefix;
+    return true;
 }
 
-// [Mazen Mohamed] Display appointment information
-void ExtendedHospital::displayAppointmentInfo(int appointmentId)
+// [Mazen Mohamed] Write a directory snapshot and empty the log it now covers
+bool HospitalFederation::checkpointDirectory()
 {
-    for (const auto &appointment : appointments)
+    if (!directoryLog)
     {
-        if (appointment.getAppointmentId() == appointmentId)
-        {
-            cout << "Appointment ID: " << appointment.getAppointmentId() << endl;
-            cout << "Doctor ID: " << appointment.getDoctorId() << endl;
-            cout << "Patient ID: " << appointment.getPatientId() << endl;
-            cout << "Date/Time: " << appointment.getDateTime() << endl;
-            cout << "Status: " << appointment.getStatus() << endl;
-            return;
-        }
+        return false;
+    }
+    string snapshotPath = directoryPrefix + ".snapshot";
+    string data = encodeDirectory(directoryEpoch + 1);
+    if (!replaceFileDurably(snapshotPath, data.data(), data.size()))
+    {
+        cout << "Failed to write directory snapshot " << snapshotPath << "." << endl;
+        return false;
     }
-    cout << "Appointment with ID " << appointmentId << " not found." << endl;
+    if (!directoryLog->truncate(directoryEpoch + 1))
+    {
+        return false;
+    }
+    directoryEpoch++;
+    return true;
 }
 
-// [Mazen Mohamed] Set emergency priority for a patient
-void ExtendedHospital::setEmergencyPriority(int patientId, EmergencyPriority priority)
+// [Mazen Mohamed] Wait until every directory change so far is on disk;
+// false if the directory log lost some of them
+bool HospitalFederation::syncDirectory()
 {
-    emergencyPriorities[patientId] = priority;
+    return !directoryLog || directoryLog->sync();
 }
 
-// [Mazen Mohamed] Get emergency queue sorted by priority
-vector<int> ExtendedHospital::getEmergencyQueueByPriority()
+#ifndef _WIN32
+// [Mazen Mohamed] Aggregate throughput of a federation of shard server
+// processes. For 1, 2, 4 ... maxShards shards, that many servers are started,
+// then operations/2 patients are registered and given a record each through
+// the router, pipelined, and the rate is printed as CSV.
+void runFederationBenchmark(int maxShards, int operations)
 {
-    // This would require a more complex implementation in a real system
-    // For simplicity, we'll just return the regular emergency queue for now
-    vector<int> result;
-
-    // Create a copy of the emergency queue
-    queue<int> tempQueue = emergencyQueue;
-
-    while (!tempQueue.empty())
+    signal(SIGPIPE, SIG_IGN);
+    int patientCount = max(operations / 2, 1);
+    SyntheticData data(0xFEDULL);
+    vector<PatientRegistration> registrations;
+    registrations.reserve(patientCount);
+    for (int i = 0; i < patientCount; i++)
     {
-        result.push_back(tempQueue.front());
-        tempQueue.pop();
+        registrations.push_back({data.patientName(), 1 + data.below(90), data.contact(), -1});
     }
 
-    return result;
-}
+    vector<int> shardCounts;
+    for (int shards = 1; shards < maxShards; shards *= 2)
+    {
+        shardCounts.push_back(shards);
+    }
+    shardCounts.push_back(maxShards);
 
-// [Mazen Mohamed] Display all appointments
-void ExtendedHospital::displayAllAppointments()
-{
-    cout << "===== ALL APPOINTMENTS =====" << endl;
-    for (const auto &appointment : appointments)
+    cout << "shards,operations,seconds,operationsPerSecond,speedup" << endl;
+    double baseRate = 0;
+    for (int shardCount : shardCounts)
     {
-        cout << "ID: " << appointment.getAppointmentId() << " | Doctor: " << appointment.getDoctorId()
-            << " | Patient: " << appointment.getPatientId() << " | Time: " << appointment.getDateTime()
-            << " | Status: " << appointment.getStatus() << endl;
+        // Anything still buffered would be written again by each server
+        cout.flush();
+        vector<pid_t> servers;
+        vector<string> paths;
+        for (int i = 0; i < shardCount; i++)
+        {
+            string path = "/tmp/hms-shard-" + to_string(getpid()) + "-" + to_string(i) + ".sock";
+            pid_t server = fork();
+            if (server == 0)
+            {
+                _exit(runShardServer(path, ""));
+            }
+            servers.push_back(server);
+            paths.push_back(path);
+        }
+
+        double seconds = -1;
+        {
+            HospitalFederation federation;
+            bool connected = true;
+            for (const string &path : paths)
+            {
+                unique_ptr<RemoteShard> shard = make_unique<RemoteShard>(path);
+                connected = connected && shard->isConnected();
+                federation.addShard(move(shard));
+            }
+            if (connected)
+            {
+                auto start = chrono::steady_clock::now();
+                vector<int> ids = federation.registerPatients(registrations);
+                federation.addMedicalRecords(ids, "Routine check-up");
+                seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            }
+            else
+            {
+                // Servers nobody connected to would wait for a router forever
+                for (pid_t server : servers)
+                {
+                    kill(server, SIGTERM);
+                }
+            }
+        }
+        for (pid_t server : servers)
+        {
+            waitpid(server, nullptr, 0);
+        }
+        if (seconds < 0)
+        {
+            cerr << "Could not start " << shardCount << " shard servers." << endl;
+            return;
+        }
+
+        long long total = 2LL * patientCount;
+        double rate = seconds > 0 ? total / seconds : 0;
+        if (shardCount == 1)
+        {
+            baseRate = rate;
+        }
+        cout << shardCount << "," << total << "," << seconds << "," << (long long)rate << ","
+             << (baseRate > 0 ? rate / baseRate : 0) << endl;
     }
-    cout << "============================" << endl;
 }
+#endif
 
 // ========== INTERACTIVE MENU SYSTEM ========== //
 // [Kareem & Mazen] Interactive menu system for hospital management
@@ -677,7 +11686,8 @@ void displayPatientMenu()
     cout << "3. Discharge Patient" << endl;
     cout << "4. Request Test for Patient" << endl;
     cout << "5. Perform Test for Patient" << endl;
-    cout << "6. Back to Main Menu" << endl;
+    cout << "6. Set Bed Capacity" << endl;
+    cout << "7. Back to Main Menu" << endl;
     cout << "Enter your choice: ";
 }
 
@@ -686,7 +11696,8 @@ void displayDoctorMenu()
     cout << "\n=== DOCTOR MANAGEMENT ===" << endl;
     cout << "1. Add New Doctor" << endl;
     cout << "2. View Doctor Details" << endl;
-    cout << "3. Back to Main Menu" << endl;
+    cout << "3. See Next Patient" << endl;
+    cout << "4. Back to Main Menu" << endl;
     cout << "Enter your choice: ";
 }
 
@@ -697,7 +11708,9 @@ void displayAppointmentMenu()
     cout << "2. Schedule Appointment (with date/time)" << endl;
     cout << "3. Update Appointment Status" << endl;
     cout << "4. View Appointment Details" << endl;
-    cout << "5. Back to Main Menu" << endl;
+    cout << "5. View Doctor Schedule" << endl;
+    cout << "6. Assign Appointment to Least-Loaded Doctor" << endl;
+    cout << "7. Back to Main Menu" << endl;
     cout << "Enter your choice: ";
 }
 
@@ -719,136 +11732,144 @@ void displayViewMenu()
     cout << "3. View All Doctors" << endl;
     cout << "4. View Doctor Details" << endl;
     cout << "5. View All Appointments" << endl;
-    cout << "6. Back to Main Menu" << endl;
+    cout << "6. View Doctors by Department" << endl;
+    cout << "7. View Admitted Patients by Room Type" << endl;
+    cout << "8. View Appointments by Department and Status" << endl;
+    cout << "9. View Bed Occupancy" << endl;
+    cout << "10. Search Patients by Name" << endl;
+    cout << "11. View Lab Status" << endl;
+    cout << "12. Back to Main Menu" << endl;
     cout << "Enter your choice: ";
 }
 
-// Helper function to get department from user
-Department getDepartmentFromUser()
+// Helper function to pick a department, room type, priority or status from a numbered list
+template <typename Enum>
+Enum getEnumFromUser()
 {
     int choice;
-    cout << "Select Department:" << endl;
-    cout << "1. Cardiology" << endl;
-    cout << "2. Neurology" << endl;
-    cout << "3. Orthopedics" << endl;
-    cout << "4. Pediatrics" << endl;
-    cout << "5. Emergency" << endl;
-    cout << "6. General" << endl;
-    cout << "Enter choice: ";
-    cin >> choice;
-
-    switch (choice)
-    {
-    case 1:
-        return CARDIOLOGY;
-    case 2:
-        return NEUROLOGY;
-    case 3:
-        return ORTHOPEDICS;
-    case 4:
-        return PEDIATRICS;
-    case 5:
-        return EMERGENCY;
-    case 6:
-        return GENERAL;
-    default:
-        return GENERAL;
+    cout << "Select " << EnumTraits<Enum>::title << ":" << endl;
+    for (size_t i = 0; i < EnumTraits<Enum>::count; i++)
+    {
+        cout << i + 1 << ". " << EnumTraits<Enum>::labels[i] << endl;
     }
-}
-
-// Helper function to get room type from user
-RoomType getRoomTypeFromUser()
-{
-    int choice;
-    cout << "Select Room Type:" << endl;
-    cout << "1. General Ward" << endl;
-    cout << "2. ICU" << endl;
-    cout << "3. Private Room" << endl;
-    cout << "4. Semi-Private" << endl;
     cout << "Enter choice: ";
     cin >> choice;
 
-    switch (choice)
+    if (choice < 1 || choice > (int)EnumTraits<Enum>::count)
     {
-    case 1:
-        return GENERAL_WARD;
-    case 2:
-        return ICU;
-    case 3:
-        return PRIVATE_ROOM;
-    case 4:
-        return SEMI_PRIVATE;
-    default:
-        return GENERAL_WARD;
+        return EnumTraits<Enum>::fallback;
     }
+    return (Enum)(choice - 1);
 }
 
-// Helper function to get emergency priority from user
-EmergencyPriority getEmergencyPriorityFromUser()
+// ========== MAIN PROGRAM ========== //
+// [Kareem] Main function implementation with interactive menu
+// "--stress [threads] [operations]" runs the concurrency stress test instead,
+// "--queue-bench [producers] [consumers] [operations]" the appointment queue benchmark,
+// "--pool-bench [threads] [patients]" the worker pool scaling benchmark,
+// "--federation-bench [shards] [operations]" the multi-process federation
+// benchmark, "--shard-server socket [dataPrefix]" serves one federation shard,
+// and "--report listing [format]" writes a listing as text, CSV or JSON.
+int main(int argc, char *argv[])
 {
-    int choice;
-    cout << "Select Emergency Priority:" << endl;
-    cout << "1. Critical" << endl;
-    cout << "2. Urgent" << endl;
-    cout << "3. Stable" << endl;
-    cout << "Enter choice: ";
-    cin >> choice;
-
-    switch (choice)
+    if (argc > 1 && string(argv[1]) == "--stress")
     {
-    case 1:
-        return CRITICAL;
-    case 2:
-        return URGENT;
-    case 3:
-        return STABLE;
-    default:
-        return STABLE;
+        int threads = argc > 2 ? atoi(argv[2]) : (int)max(1u, thread::hardware_concurrency());
+        int operations = argc > 3 ? atoi(argv[3]) : 200000;
+        runConcurrencyStress(max(threads, 1), max(operations, 1));
+        return 0;
     }
-}
-
-// Helper function to get appointment status from user
-AppointmentStatus getAppointmentStatusFromUser()
-{
-    int choice;
-    cout << "Select Appointment Status:" << endl;
-    cout << "1. Scheduled" << endl;
-    cout << "2. In Progress" << endl;
-    cout << "3. Completed" << endl;
-    cout << "4. Cancelled" << endl;
-    cout << "Enter choice: ";
-    cin >> choice;
-
-    switch (choice)
+    if (argc > 1 && string(argv[1]) == "--queue-bench")
     {
-    case 1:
-        return SCHEDULED;
-    case 2:
-        return IN_PROGRESS;
-    case 3:
-        return COMPLETED;
-    case 4:
-        return CANCELLED;
-    default:
-        return SCHEDULED;
+        int producers = argc > 2 ? atoi(argv[2]) : 4;
+        int consumers = argc > 3 ? atoi(argv[3]) : 1;
+        int operations = argc > 4 ? atoi(argv[4]) : 2000000;
+        runQueueBenchmark(max(producers, 1), max(consumers, 1), max(operations, 1));
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--pool-bench")
+    {
+        int threads = argc > 2 ? atoi(argv[2]) : (int)max(1u, thread::hardware_concurrency());
+        int patients = argc > 3 ? atoi(argv[3]) : 1000000;
+        runPoolBenchmark(max(threads, 1), max(patients, 100));
+        return 0;
+    }
+    if (argc > 1 && (string(argv[1]) == "--federation-bench" || string(argv[1]) == "--shard-server"))
+    {
+#ifndef _WIN32
+        if (string(argv[1]) == "--shard-server")
+        {
+            if (argc < 3)
+            {
+                cerr << "Usage: " << argv[0] << " --shard-server socket [dataPrefix]" << endl;
+                return 1;
+            }
+            return runShardServer(argv[2], argc > 3 ? argv[3] : "");
+        }
+        int shards = argc > 2 ? atoi(argv[2]) : 4;
+        int operations = argc > 3 ? atoi(argv[3]) : 400000;
+        runFederationBenchmark(max(shards, 1), max(operations, 2));
+        return 0;
+#else
+        cerr << "Shard servers need Unix sockets, which this build does not support." << endl;
+        return 1;
+#endif
+    }
+    if (argc > 1 && string(argv[1]) == "--bench")
+    {
+        // 10^7 patients needs several GB of memory, so the default stops at 10^6
+        int maxExponent = argc > 2 ? atoi(argv[2]) : 6;
+        runBenchmarks(min(max(maxExponent, 2), 7), argc > 3 ? argv[3] : "", argc > 4 ? argv[4] : "");
+        return 0;
+    }
+    if (argc > 1 && string(argv[1]) == "--batch")
+    {
+        return runBatch(argc > 2 ? argv[2] : "-", "hospital.snapshot", "hospital.wal", argc > 3 ? argv[3] : "");
+    }
+    if (argc > 1 && string(argv[1]) == "--follow-changes")
+    {
+        if (argc < 3)
+        {
+            cerr << "Usage: " << argv[0] << " --follow-changes tap" << endl;
+            return 1;
+        }
+        return runChangeFollower(argv[2]);
+    }
+    if (argc > 1 && string(argv[1]) == "--report")
+    {
+        return runReport(argc > 2 ? argv[2] : "patients", argc > 3 ? argv[3] : "text", "hospital.snapshot", "hospital.wal");
     }
-}
 
-// ========== MAIN PROGRAM ========== //
-// [Kareem] Main function implementation with interactive menu
-int main()
-{
     ExtendedHospital hospital;
     int choice;
+    const string snapshotPath = "hospital.snapshot";
+    const string walPath = "hospital.wal";
 
-    // Sample data for testing
-    hospital.registerPatient("John Doe", 35, "555-1234");
-    hospital.registerPatient("Jane Smith", 28, "555-5678");
-    hospital.addDoctor("Dr. Smith", CARDIOLOGY);
-    hospital.addDoctor("Dr. Brown", NEUROLOGY);
+    if (!hospital.recover(snapshotPath, walPath))
+    {
+        cout << "Could not restore hospital state; changes will not be logged." << endl;
+    }
+    if (hospital.getPatientCount() > 0 || hospital.getDoctorCount() > 0)
+    {
+        cout << "Restored hospital state from " << snapshotPath << " and " << walPath << "." << endl;
+    }
+    else
+    {
+        // Sample data for testing
+        hospital.registerPatient("John Doe", 35, "555-1234");
+        hospital.registerPatient("Jane Smith", 28, "555-5678");
+        hospital.addDoctor("Dr. Smith", CARDIOLOGY);
+        hospital.addDoctor("Dr. Brown", NEUROLOGY);
+        hospital.setBedCapacity(GENERAL_WARD, 40);
+        hospital.setBedCapacity(ICU, 8);
+        hospital.setBedCapacity(PRIVATE_ROOM, 12);
+        hospital.setBedCapacity(SEMI_PRIVATE, 20);
+    }
 
     do
     {
+        // Results the lab finished in the meantime
+        hospital.collectTestResults(false);
         displayMainMenu();
         cin >> choice;
 
@@ -886,35 +11907,71 @@ int main()
                     int patientId;
                     cout << "Enter patient ID: ";
                     cin >> patientId;
-                    RoomType roomType = getRoomTypeFromUser();
-                    hospital.admitPatient(patientId, roomType);
-                    cout << "Patient admitted successfully." << endl;
+                    RoomType roomType = getEnumFromUser<RoomType>();
+                    if (hospital.admitPatient(patientId, roomType))
+                    {
+                        cout << "Patient admitted successfully." << endl;
+                    }
                     break;
                 }
                 case 3:
                 { // Discharge Patient
-                    // This would require adding a dischargePatient method to Hospital class
-                    cout << "Discharge functionality would be implemented here." << endl;
+                    int patientId;
+                    cout << "Enter patient ID: ";
+                    cin >> patientId;
+                    if (hospital.dischargePatient(patientId))
+                    {
+                        cout << "Patient discharged successfully." << endl;
+                    }
                     break;
                 }
                 case 4:
                 { // Request Test
-                    // This would require access to the Patient object
-                    cout << "Test request functionality would be implemented here." << endl;
+                    int patientId;
+                    string testName;
+                    cout << "Enter patient ID: ";
+                    cin >> patientId;
+                    cout << "Enter test name: ";
+                    cin.ignore();
+                    getline(cin, testName);
+                    if (hospital.requestTest(patientId, testName))
+                    {
+                        // The lab starts on it right away
+                        hospital.sendTestsToLab(patientId);
+                        cout << "Test sent to the lab." << endl;
+                    }
                     break;
                 }
                 case 5:
                 { // Perform Test
-                    // This would require access to the Patient object
-                    cout << "Test performance functionality would be implemented here." << endl;
+                    int patientId;
+                    cout << "Enter patient ID: ";
+                    cin >> patientId;
+                    if (hospital.sendTestsToLab(patientId) != -1)
+                    {
+                        int written = hospital.collectTestResults(true);
+                        cout << written << " test result(s) written back to patient history." << endl;
+                    }
+                    break;
+                }
+                case 6:
+                { // Set Bed Capacity
+                    RoomType roomType = getEnumFromUser<RoomType>();
+                    int capacity;
+                    cout << "Enter number of beds (-1 for no limit): ";
+                    cin >> capacity;
+                    if (hospital.setBedCapacity(roomType, capacity))
+                    {
+                        cout << "Bed capacity updated successfully." << endl;
+                    }
                     break;
                 }
-                case 6: // Back to Main Menu
+                case 7: // Back to Main Menu
                     break;
                 default:
                     cout << "Invalid choice. Please try again." << endl;
                 }
-            } while (patientChoice != 6);
+            } while (patientChoice != 7);
             break;
         }
         case 2:
@@ -933,7 +11990,7 @@ int main()
                     cout << "Enter doctor name: ";
                     cin.ignore();
                     getline(cin, name);
-                    Department dept = getDepartmentFromUser();
+                    Department dept = getEnumFromUser<Department>();
 
                     int id = hospital.addDoctor(name, dept);
                     cout << "Doctor added successfully with ID: " << id << endl;
@@ -947,12 +12004,24 @@ int main()
                     hospital.displayDoctorInfo(doctorId);
                     break;
                 }
-                case 3: // Back to Main Menu
+                case 3:
+                { // See Next Patient
+                    int doctorId;
+                    cout << "Enter doctor ID: ";
+                    cin >> doctorId;
+                    int patientId = hospital.seePatient(doctorId);
+                    if (patientId != -1)
+                    {
+                        cout << "Next patient: " << patientId << endl;
+                    }
+                    break;
+                }
+                case 4: // Back to Main Menu
                     break;
                 default:
                     cout << "Invalid choice. Please try again." << endl;
                 }
-            } while (doctorChoice != 3);
+            } while (doctorChoice != 4);
             break;
         }
         case 3:
@@ -972,8 +12041,10 @@ int main()
                     cin >> doctorId;
                     cout << "Enter patient ID: ";
                     cin >> patientId;
-                    hospital.bookAppointment(doctorId, patientId);
-                    cout << "Appointment booked successfully." << endl;
+                    if (hospital.bookAppointment(doctorId, patientId))
+                    {
+                        cout << "Appointment booked successfully." << endl;
+                    }
                     break;
                 }
                 case 2:
@@ -1000,9 +12071,11 @@ int main()
                     int appointmentId;
                     cout << "Enter appointment ID: ";
                     cin >> appointmentId;
-                    AppointmentStatus status = getAppointmentStatusFromUser();
-                    hospital.updateAppointmentStatus(appointmentId, status);
-                    cout << "Appointment status updated successfully." << endl;
+                    AppointmentStatus status = getEnumFromUser<AppointmentStatus>();
+                    if (hospital.updateAppointmentStatus(appointmentId, status))
+                    {
+                        cout << "Appointment status updated successfully." << endl;
+                    }
                     break;
                 }
                 case 4:
@@ -1013,12 +12086,47 @@ int main()
                     hospital.displayAppointmentInfo(appointmentId);
                     break;
                 }
-                case 5: // Back to Main Menu
+                case 5:
+                { // View Doctor Schedule
+                    int doctorId;
+                    string from, to;
+                    cout << "Enter doctor ID: ";
+                    cin >> doctorId;
+                    cout << "Enter start date/time (e.g., 2023-10-15 09:00): ";
+                    cin.ignore();
+                    getline(cin, from);
+                    cout << "Enter end date/time (e.g., 2023-10-15 12:00): ";
+                    getline(cin, to);
+                    hospital.displayDoctorSchedule(doctorId, from, to);
+                    break;
+                }
+                case 6:
+                { // Assign Appointment to Least-Loaded Doctor
+                    int patientId;
+                    string from, to;
+                    cout << "Enter patient ID: ";
+                    cin >> patientId;
+                    Department dept = getEnumFromUser<Department>();
+                    cout << "Enter earliest date/time (e.g., 2023-10-15 09:00): ";
+                    cin.ignore();
+                    getline(cin, from);
+                    cout << "Enter latest end date/time (e.g., 2023-10-15 12:00): ";
+                    getline(cin, to);
+
+                    int aptId = hospital.assignAppointment(patientId, dept, from, to);
+                    if (aptId != -1)
+                    {
+                        cout << "Appointment scheduled successfully with ID: " << aptId << endl;
+                        hospital.displayAppointmentInfo(aptId);
+                    }
+                    break;
+                }
+                case 7: // Back to Main Menu
                     break;
                 default:
                     cout << "Invalid choice. Please try again." << endl;
                 }
-            } while (appointmentChoice != 5);
+            } while (appointmentChoice != 7);
             break;
         }
         case 4:
@@ -1036,8 +12144,10 @@ int main()
                     int patientId;
                     cout << "Enter patient ID: ";
                     cin >> patientId;
-                    hospital.addEmergency(patientId);
-                    cout << "Emergency case added successfully." << endl;
+                    if (hospital.addEmergency(patientId))
+                    {
+                        cout << "Emergency case added successfully." << endl;
+                    }
                     break;
                 }
                 case 2:
@@ -1054,7 +12164,7 @@ int main()
                     int patientId;
                     cout << "Enter patient ID: ";
                     cin >> patientId;
-                    EmergencyPriority priority = getEmergencyPriorityFromUser();
+                    EmergencyPriority priority = getEnumFromUser<EmergencyPriority>();
                     hospital.setEmergencyPriority(patientId, priority);
                     cout << "Emergency priority set successfully." << endl;
                     break;
@@ -1102,15 +12212,48 @@ int main()
                 case 5: // View All Appointments
                     hospital.displayAllAppointments();
                     break;
-                case 6: // Back to Main Menu
+                case 6: // View Doctors by Department
+                    hospital.displayDoctorsInDepartment(getEnumFromUser<Department>());
+                    break;
+                case 7: // View Admitted Patients by Room Type
+                    hospital.displayAdmittedPatients(getEnumFromUser<RoomType>());
+                    break;
+                case 8:
+                { // View Appointments by Department and Status
+                    Department dept = getEnumFromUser<Department>();
+                    AppointmentStatus status = getEnumFromUser<AppointmentStatus>();
+                    hospital.displayAppointments(dept, status);
+                    break;
+                }
+                case 9: // View Bed Occupancy
+                    hospital.displayBedOccupancy();
+                    break;
+                case 10:
+                { // Search Patients by Name
+                    string query;
+                    cout << "Enter name (typos are tolerated): ";
+                    cin.ignore();
+                    getline(cin, query);
+                    hospital.displayPatientSearch(query);
+                    break;
+                }
+                case 11: // View Lab Status
+                    hospital.displayLabStatus();
+                    break;
+                case 12: // Back to Main Menu
                     break;
                 default:
                     cout << "Invalid choice. Please try again." << endl;
                 }
-            } while (viewChoice != 6);
+            } while (viewChoice != 12);
             break;
         }
         case 6: // Exit
+            hospital.collectTestResults(true);
+            if (hospital.checkpoint(snapshotPath))
+            {
+                cout << "Hospital state saved to " << snapshotPath << "." << endl;
+            }
             cout << "Thank you for using Hospital Management System!" << endl;
             break;
         default: